@@ -0,0 +1,292 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+/*
+ * SslFileBenchmark - a static file is downloaded over HTTPS from a local server by several
+ * keep-alive connections. The test runs twice: with the records encrypted by OpenSSL and
+ * with the kernel TLS offload requested. The offload works only if OpenSSL is built with
+ * kTLS and the kernel tls module is loaded, otherwise both runs go through the userspace.
+*/
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <openssl/ssl.h>
+#include <chrono>
+#include <fstream>
+#include <vector>
+#include <sstream>
+#include "common_webcpp.h"
+#include "HttpServer.h"
+#include "Request.h"
+#include "Response.h"
+#include "StringUtil.h"
+#include "ThreadWorker.h"
+#include "example_common.h"
+
+#define DEFAULT_PORT_BENCHMARK 8091
+#define DEFAULT_CLIENT_COUNT 4
+#define DEFAULT_FILE_SIZE 64
+#define DEFAULT_REQUEST_COUNT 10
+#define BENCHMARK_FILE "/tmp/webcpp_ssl_benchmark.bin"
+#define RECEIVE_BUFFER_SIZE 65536
+
+int port = DEFAULT_PORT_BENCHMARK;
+size_t clientCount = DEFAULT_CLIENT_COUNT;
+size_t fileSize = DEFAULT_FILE_SIZE;
+size_t requestCount = DEFAULT_REQUEST_COUNT;
+std::string cert = SSL_CERT;
+std::string key = SSL_KEY;
+
+
+bool CreateFile()
+{
+    std::ofstream file(BENCHMARK_FILE, std::ios::binary | std::ios::trunc);
+    std::vector<char> block(1_Mb);
+    for(size_t i = 0;i < block.size();i ++)
+    {
+        block[i] = static_cast<char>(i * 31 + 7);
+    }
+    for(size_t i = 0;i < fileSize && file.good();i ++)
+    {
+        file.write(block.data(), block.size());
+    }
+    return file.good();
+}
+
+int ConnectClient()
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if(sock == ERROR)
+    {
+        return ERROR;
+    }
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if(connect(sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == ERROR)
+    {
+        close(sock);
+        return ERROR;
+    }
+
+    return sock;
+}
+
+// downloads the file requestCount times through one connection, returns the bytes received
+size_t Download(SSL_CTX *ctx)
+{
+    size_t received = 0;
+    int sock = ConnectClient();
+    if(sock == ERROR)
+    {
+        return 0;
+    }
+
+    SSL *ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, sock);
+    if(SSL_connect(ssl) == 1)
+    {
+        std::string request = "GET /file HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n\r\n";
+        char buffer[RECEIVE_BUFFER_SIZE];
+        std::string header;
+        for(size_t i = 0;i < requestCount;i ++)
+        {
+            if(SSL_write(ssl, request.data(), request.size()) <= 0)
+            {
+                break;
+            }
+
+            // the header is read up to the delimiter, the rest of the
+            // buffer is the beginning of the body
+            size_t body = 0;
+            size_t pos = std::string::npos;
+            while((pos = header.find("\r\n\r\n")) == std::string::npos)
+            {
+                int size = SSL_read(ssl, buffer, sizeof(buffer));
+                if(size <= 0)
+                {
+                    break;
+                }
+                header.append(buffer, size);
+            }
+            if(pos == std::string::npos)
+            {
+                break;
+            }
+            body = header.size() - pos - 4;
+            header.clear();
+
+            size_t expected = fileSize * 1_Mb;
+            while(body < expected)
+            {
+                int size = SSL_read(ssl, buffer, std::min(sizeof(buffer), expected - body));
+                if(size <= 0)
+                {
+                    break;
+                }
+                body += size;
+            }
+            received += body;
+            if(body < expected)
+            {
+                break;
+            }
+        }
+    }
+
+    SSL_free(ssl);
+    close(sock);
+
+    return received;
+}
+
+bool RunTest(bool ktls, double &seconds, size_t &received, size_t &offloaded)
+{
+    WebCpp::HttpServer server;
+    WebCpp::HttpConfig config;
+    config.SetHttpProtocol(WebCpp::Http::Protocol::HTTPS);
+    config.SetHttpServerPort(port);
+    config.SetSslSertificate(cert);
+    config.SetSslKey(key);
+    config.SetSslKtls(ktls);
+    config.SetKeepAliveTimeout(60000);
+
+    if(server.Init(config) == false)
+    {
+        std::cout << "failed to start the server: " << server.GetLastError() << std::endl;
+        return false;
+    }
+    server.OnGet("/file", [](const WebCpp::Request &, WebCpp::Response &response) -> bool
+    {
+        return response.AddFile(BENCHMARK_FILE);
+    });
+    server.Run();
+
+    SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+    std::vector<WebCpp::ThreadWorker> clients(clientCount);
+    std::vector<size_t> results(clientCount, 0);
+
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0;i < clientCount;i ++)
+    {
+        size_t *result = &results[i];
+        clients[i].SetFunction([ctx, result](bool &) -> void*
+        {
+            *result = Download(ctx);
+            return nullptr;
+        });
+        clients[i].Start();
+    }
+    for(auto &client: clients)
+    {
+        client.Wait();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    SSL_CTX_free(ctx);
+    offloaded = server.GetHandshakeStats().ktls;
+    server.Close();
+
+    received = 0;
+    for(size_t result: results)
+    {
+        received += result;
+    }
+    seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    return true;
+}
+
+void PrintResult(const std::string &name, double seconds, size_t received, size_t offloaded)
+{
+    std::stringstream stream;
+    stream << name << ": " << seconds << " sec., "
+           << (static_cast<double>(received) / 1_Mb / seconds) << " Mb/sec., "
+           << offloaded << " of " << clientCount << " connections offloaded"
+           << std::endl;
+    std::cout << stream.str();
+}
+
+int main(int argc, char *argv[])
+{
+    auto cmdline = CommandLine::Parse(argc, argv);
+
+    if(cmdline.Exists("-h"))
+    {
+        std::vector<std::string> adds;
+        adds.push_back("-p: server port, default: " + std::to_string(DEFAULT_PORT_BENCHMARK));
+        adds.push_back("-t: count of client connections, default: " + std::to_string(DEFAULT_CLIENT_COUNT));
+        adds.push_back("-s: file size, Mb, default: " + std::to_string(DEFAULT_FILE_SIZE));
+        adds.push_back("-n: count of downloads per connection, default: " + std::to_string(DEFAULT_REQUEST_COUNT));
+        adds.push_back("-c: certificate file, default: " SSL_CERT);
+        adds.push_back("-k: private key file, default: " SSL_KEY);
+        cmdline.PrintUsage(false, false, adds);
+        exit(0);
+    }
+
+    int v;
+    if(StringUtil::String2int(cmdline.Get("-p"), v))
+    {
+        port = v;
+    }
+    if(StringUtil::String2int(cmdline.Get("-t"), v) && v > 0)
+    {
+        clientCount = v;
+    }
+    if(StringUtil::String2int(cmdline.Get("-s"), v) && v > 0)
+    {
+        fileSize = v;
+    }
+    if(StringUtil::String2int(cmdline.Get("-n"), v) && v > 0)
+    {
+        requestCount = v;
+    }
+    cmdline.Set("-c", cert);
+    cmdline.Set("-k", key);
+
+    if(CreateFile() == false)
+    {
+        std::cout << "failed to create " << BENCHMARK_FILE << std::endl;
+        return 1;
+    }
+
+    std::cout << clientCount << " connections, " << requestCount << " downloads of " << fileSize << " Mb each" << std::endl;
+    double userspace, kernel;
+    size_t userspaceReceived, kernelReceived, userspaceOffloaded, kernelOffloaded;
+    if(RunTest(false, userspace, userspaceReceived, userspaceOffloaded) &&
+            RunTest(true, kernel, kernelReceived, kernelOffloaded))
+    {
+        PrintResult("userspace TLS", userspace, userspaceReceived, userspaceOffloaded);
+        PrintResult("kernel TLS", kernel, kernelReceived, kernelOffloaded);
+        std::cout << "speedup: " << (userspace / kernel) << "x" << std::endl;
+    }
+
+    unlink(BENCHMARK_FILE);
+
+    return 0;
+}
@@ -0,0 +1,239 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+/*
+ * WriteBenchmark - several threads write to their own connections of the same server
+ * at the same time. The test runs twice: with all the writes serialized by one global
+ * mutex, as the server did before, and with the per-connection locking only.
+*/
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <sstream>
+#include "common_webcpp.h"
+#include "CommunicationTcpServer.h"
+#include "StringUtil.h"
+#include "ThreadWorker.h"
+#include "Mutex.h"
+#include "Lock.h"
+#include "example_common.h"
+
+#define DEFAULT_PORT_BENCHMARK 8090
+#define DEFAULT_THREAD_COUNT 4
+#define DEFAULT_MESSAGE_SIZE 512
+#define DEFAULT_MESSAGE_COUNT 20000
+#define RECEIVE_BUFFER_SIZE 65536
+
+int port = DEFAULT_PORT_BENCHMARK;
+size_t threadCount = DEFAULT_THREAD_COUNT;
+size_t messageSize = DEFAULT_MESSAGE_SIZE;
+size_t messageCount = DEFAULT_MESSAGE_COUNT;
+
+WebCpp::Mutex g_globalMutex;
+std::mutex g_connectionsMutex;
+std::vector<int> g_connections;
+
+
+int ConnectClient()
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if(sock == ERROR)
+    {
+        return ERROR;
+    }
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if(connect(sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == ERROR)
+    {
+        close(sock);
+        return ERROR;
+    }
+
+    return sock;
+}
+
+double RunTest(WebCpp::CommunicationTcpServer &server, bool globalLock)
+{
+    std::vector<int> clients;
+    for(size_t i = 0;i < threadCount;i ++)
+    {
+        clients.push_back(ConnectClient());
+    }
+    while(true)
+    {
+        std::lock_guard<std::mutex> lock(g_connectionsMutex);
+        if(g_connections.size() >= threadCount)
+        {
+            break;
+        }
+    }
+
+    std::vector<int> connections;
+    {
+        std::lock_guard<std::mutex> lock(g_connectionsMutex);
+        connections = g_connections;
+        g_connections.clear();
+    }
+
+    std::vector<WebCpp::ThreadWorker> readers(threadCount);
+    std::vector<WebCpp::ThreadWorker> writers(threadCount);
+    size_t expected = messageSize * messageCount;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(size_t i = 0;i < threadCount;i ++)
+    {
+        int sock = clients[i];
+        readers[i].SetFunction([sock, expected](bool &running) -> void*
+        {
+            char buffer[RECEIVE_BUFFER_SIZE];
+            size_t received = 0;
+            while(running && received < expected)
+            {
+                ssize_t size = recv(sock, buffer, sizeof(buffer), 0);
+                if(size <= 0)
+                {
+                    break;
+                }
+                received += size;
+            }
+            return nullptr;
+        });
+        readers[i].Start();
+
+        int connID = connections[i];
+        writers[i].SetFunction([&server, connID, globalLock](bool &) -> void*
+        {
+            ByteArray message(messageSize, 'x');
+            for(size_t j = 0;j < messageCount;j ++)
+            {
+                if(globalLock)
+                {
+                    WebCpp::Lock lock(g_globalMutex);
+                    server.Write(connID, message);
+                }
+                else
+                {
+                    server.Write(connID, message);
+                }
+            }
+            return nullptr;
+        });
+        writers[i].Start();
+    }
+
+    for(size_t i = 0;i < threadCount;i ++)
+    {
+        writers[i].Wait();
+        readers[i].Wait();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    for(size_t i = 0;i < threadCount;i ++)
+    {
+        close(clients[i]);
+    }
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+}
+
+void PrintResult(const std::string &name, double seconds)
+{
+    double megabytes = static_cast<double>(threadCount * messageSize * messageCount) / 1_Mb;
+    std::stringstream stream;
+    stream << name << ": " << seconds << " sec., "
+           << (megabytes / seconds) << " Mb/sec., "
+           << static_cast<size_t>((threadCount * messageCount) / seconds) << " writes/sec."
+           << std::endl;
+    std::cout << stream.str();
+}
+
+int main(int argc, char *argv[])
+{
+    auto cmdline = CommandLine::Parse(argc, argv);
+
+    if(cmdline.Exists("-h"))
+    {
+        std::vector<std::string> adds;
+        adds.push_back("-p: server port, default: " + std::to_string(DEFAULT_PORT_BENCHMARK));
+        adds.push_back("-t: count of writing threads and connections, default: " + std::to_string(DEFAULT_THREAD_COUNT));
+        adds.push_back("-s: message size, bytes, default: " + std::to_string(DEFAULT_MESSAGE_SIZE));
+        adds.push_back("-n: count of messages per thread, default: " + std::to_string(DEFAULT_MESSAGE_COUNT));
+        cmdline.PrintUsage(false, false, adds);
+        exit(0);
+    }
+
+    int v;
+    if(StringUtil::String2int(cmdline.Get("-p"), v))
+    {
+        port = v;
+    }
+    if(StringUtil::String2int(cmdline.Get("-t"), v) && v > 0)
+    {
+        threadCount = v;
+    }
+    if(StringUtil::String2int(cmdline.Get("-s"), v) && v > 0)
+    {
+        messageSize = v;
+    }
+    if(StringUtil::String2int(cmdline.Get("-n"), v) && v > 0)
+    {
+        messageCount = v;
+    }
+
+    WebCpp::CommunicationTcpServer server;
+    server.SetPort(port);
+    server.SetNewConnectionCallback([](int connID, const std::string &)
+    {
+        std::lock_guard<std::mutex> lock(g_connectionsMutex);
+        g_connections.push_back(connID);
+    });
+
+    if(server.Init() == false || server.Connect() == false || server.Run() == false)
+    {
+        std::cout << "failed to start the server: " << server.GetLastError() << std::endl;
+        return 1;
+    }
+
+    std::cout << threadCount << " threads, " << messageCount << " messages of " << messageSize << " bytes each" << std::endl;
+    double global = RunTest(server, true);
+    PrintResult("global lock", global);
+    double perConnection = RunTest(server, false);
+    PrintResult("per-connection lock", perConnection);
+    std::cout << "speedup: " << (global / perConnection) << "x" << std::endl;
+
+    server.Close();
+
+    return 0;
+}
@@ -29,6 +29,8 @@
 #include <vector>
 #include "common_webcpp.h"
 #include "IHttp.h"
+#include "SocketPool.h"
+#include "ListenerHandoff.h"
 
 #define STRINGIFY(x) #x
 #define TOSTRING(x) STRINGIFY(x)
@@ -53,6 +55,7 @@ public:
 
     std::string RootFolder() const;
     std::string ToString() const;
+    SocketPool::SocketOptions GetSocketOptions() const;
 
 protected:
     void SetRootFolder();
@@ -67,15 +70,54 @@ private:
     PROPERTY(std::string, HttpServerAddress, "")
     PROPERTY(int, HttpServerPort, 8080)
     PROPERTY(Http::Protocol, HttpProtocol, Http::Protocol::HTTP)
+    PROPERTY(std::string, HttpUnixSocket, "")
     PROPERTY(int, KeepAliveTimeout, 2000)
+    PROPERTY(int, RequestHeaderTimeout, 10000)
+    PROPERTY(int, RequestBodyTimeout, 60000)
+    PROPERTY(int, HandlerTimeout, 0)
+    PROPERTY(int, WriteTimeout, 60000)
+    PROPERTY(size_t, MaxQueuedRequests, 0)
+    PROPERTY(int, MaxQueueTime, 0)
+    PROPERTY(int, RetryAfter, 1)
+    PROPERTY(size_t, RequestWorkers, 0)
     PROPERTY(std::string, SslSertificate, "cert.pem")
     PROPERTY(std::string, SslKey, "key.pem")
+    PROPERTY(int, SslHandshakeTimeout, DEFAULT_HANDSHAKE_TIMEOUT)
+    PROPERTY(size_t, SslSessionCacheSize, DEFAULT_SSL_SESSION_CACHE_SIZE)
+    PROPERTY(int, SslTicketKeyLifetime, DEFAULT_SSL_TICKET_KEY_LIFETIME)
+    PROPERTY(bool, SslKtls, false)
+    PROPERTY(size_t, SslHandshakeWorkers, 0)
     PROPERTY(bool, TempFile, false)
     PROPERTY(bool, WsProcessDefault, true)
     PROPERTY(int, WsServerPort, 8081)
     PROPERTY(Http::Protocol, WsProtocol, Http::Protocol::WS)
+    PROPERTY(std::string, WsUnixSocket, "")
+    PROPERTY(int, WsPingInterval, 0)
+    PROPERTY(int, UnixSocketPermissions, DEFAULT_UNIX_SOCKET_PERMISSIONS)
     PROPERTY(size_t, MaxBodySize, 2_Mb)
     PROPERTY(size_t, MaxBodyFileSize, 20_Mb)
+    PROPERTY(SocketPool::PollMethod, PollMethod, SocketPool::PollMethod::Epoll)
+    PROPERTY(size_t, ReactorCount, 1)
+    PROPERTY(std::string, ReactorCpus, "")
+    PROPERTY(std::string, WorkerCpus, "")
+    PROPERTY(size_t, MaxConnections, 100000)
+    PROPERTY(int, ListenBacklog, DEFAULT_LISTEN_BACKLOG)
+    PROPERTY(bool, TcpNoDelay, false)
+    PROPERTY(bool, TcpCork, false)
+    PROPERTY(int, TcpDeferAccept, 0)
+    PROPERTY(int, TcpFastOpen, 0)
+    PROPERTY(int, SocketReceiveBuffer, 0)
+    PROPERTY(int, SocketSendBuffer, 0)
+    PROPERTY(bool, TcpKeepAlive, false)
+    PROPERTY(int, TcpKeepAliveIdle, 0)
+    PROPERTY(int, TcpKeepAliveInterval, 0)
+    PROPERTY(int, TcpKeepAliveCount, 0)
+    PROPERTY(size_t, WriteHighWatermark, 1_Mb)
+    PROPERTY(size_t, WriteLowWatermark, 256_Kb)
+    PROPERTY(size_t, MaxPendingInput, 1_Mb)
+    PROPERTY(size_t, ZeroCopyThreshold, 0)
+    PROPERTY(std::string, HandoffSocket, "")
+    PROPERTY(int, HandoffDrainTimeout, DEFAULT_DRAIN_TIMEOUT)
 
 };
 
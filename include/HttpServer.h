@@ -28,11 +28,14 @@
 #include <ICommunicationServer.h>
 #include "common_webcpp.h"
 #include <deque>
+#include <unordered_map>
 #include <vector>
 #include <memory>
+#include <chrono>
 #include "IErrorable.h"
 #include "IRunnable.h"
 #include "ThreadWorker.h"
+#include "ThreadPool.h"
 #include "Mutex.h"
 #include "Signal.h"
 #include "Request.h"
@@ -40,6 +43,7 @@
 #include "RouteHttp.h"
 #include "HttpConfig.h"
 #include "HttpHeader.h"
+#include "TimingWheel.h"
 
 
 namespace WebCpp
@@ -48,6 +52,21 @@ namespace WebCpp
 class HttpServer: public IErrorable, public IRunnable
 {
 public:
+    /* the connections dropped for not meeting a deadline */
+    struct EvictionStats
+    {
+        size_t header = 0;
+        size_t body = 0;
+        size_t handler = 0;
+        size_t write = 0;
+    };
+    /* the requests answered with 503 because the server was overloaded */
+    struct ShedStats
+    {
+        size_t queueLimit = 0;
+        size_t queueTime = 0;
+    };
+
     HttpServer();
     HttpServer(const HttpServer& other) = delete;
     HttpServer& operator=(const HttpServer& other) = delete;
@@ -63,9 +82,17 @@ public:
     HttpServer& OnGet(const std::string &path, const RouteHttp::RouteFunc &f);
     HttpServer& OnPost(const std::string &path, const RouteHttp::RouteFunc &f);
 
+    // with several request workers the handlers and the hooks are called concurrently
+    // for the different connections, a connection has one request processed at a time
     void SetPreRouteFunc(const RouteHttp::RouteFunc &callback);
     void SetPostRouteFunc(const RouteHttp::RouteFunc &callback);
 
+    void SetCongestionCallback(const std::function<void(int, bool)> &callback);
+    bool IsCongested(int connID) const;
+    SocketPool::HandshakeStats GetHandshakeStats() const;
+    EvictionStats GetEvictionStats() const;
+    ShedStats GetShedStats() const;
+
     Http::Protocol GetProtocol() const;
 
     bool SendResponse(Response &response);
@@ -76,6 +103,8 @@ protected:
     void OnConnected(int connID, const std::string& remote);
     void OnDataReady(int connID, ByteArray &data);
     void OnClosed(int connID);
+    void OnCongestion(int connID, bool congested);
+    void OnReadClosed(int connID);
 
     bool StartRequestThread();
     bool StopRequestThread();
@@ -84,15 +113,33 @@ protected:
     void SendSignal();
     void WaitForSignal();
     void PutToQueue(int connID, const std::string &remote);
-    void AppendData(int connID, const ByteArray &data);
-    bool IsQueueEmpty();
+    void AppendData(int connID, ByteArray &data);
     bool CheckDataFullness();
-    std::unique_ptr<Request> GetNextRequest();
+    std::unique_ptr<Request> GetNextRequest(bool &pipelined, std::vector<int> &shed);
     void RemoveFromQueue(int connID);
+    void DispatchRequest(std::unique_ptr<Request> request, bool pipelined);
+    void HandleRequest(Request &request, bool pipelined);
     void ProcessRequest(Request &request);
-    void ProcessKeepAlive(int connID);    
+    void FinishRequest(int connID);
+    void ShedRequests(const std::vector<int> &connections, bool queueTime);
+    bool IsQueueTimeOver(int connID);
+    void CloseAfterSend(int connID);
+    void ProcessKeepAlive(int connID);
+    void ProcessDeadline(int connID, int type);
+    void WatchOutput(int connID);
+    void OnTimer(int connID, int type);
 
 private:
+    enum TimerType
+    {
+        NoTimer = -1,
+        KeepAlive = 0,
+        HeaderDeadline,
+        BodyDeadline,
+        HandlerDeadline,
+        WriteDeadline,
+    };
+
     struct RequestData
     {
         RequestData(int connID, const std::string &remote):
@@ -108,23 +155,66 @@ private:
         ByteArray data;
         std::unique_ptr<Request> request;
         bool readyForDispatch;
+        bool readPaused = false;
+        bool corked = false;
+        // the deadline the request being received is under
+        int deadline = TimerType::NoTimer;
+        // a request of the connection is being processed
+        bool handling = false;
+        // the bytes sent when the write deadline was set last time
+        uint64_t writeProgress = 0;
+        // the connection is in the list of those to be parsed
+        bool incoming = false;
+        // the connection has a request being received, waiting or processed
+        bool queued = false;
+        // the client has shut down its side of the connection
+        bool readClosed = false;
+        // the client has sent something that isn't a request
+        bool rejected = false;
+        // the time the last data of the connection came
+        std::chrono::steady_clock::time_point received;
+        // the time the request waiting to be dispatched was complete
+        std::chrono::steady_clock::time_point completed;
+        // the same for the request being handled, it may still wait for a worker
+        std::chrono::steady_clock::time_point handledCompleted;
         std::string remote;
     };
 
+    RequestData* GetRequestData(int connID);
+    void SetIncoming(RequestData &requestData);
+    void UpdateReadPause(RequestData &requestData);
+    void SetDeadline(RequestData &requestData, int type, int timeout);
+    void SetCorked(int connID, bool corked);
+
     std::shared_ptr<ICommunicationServer> m_server = nullptr;
     Http::Protocol m_protocol = Http::Protocol::Undefined;
 
     ThreadWorker m_requestThread;
+    TimingWheel m_timers;
     Mutex m_queueMutex;
     Mutex m_signalMutex;
     Signal m_signalCondition;
-
-    std::deque<RequestData> m_requestQueue;
+    // something has changed since the request thread looked at the queue last time
+    bool m_signaled = false;
+
+    // the state of every connection, the connections that got data since they were
+    // parsed last time and the ones which have a complete request to be processed
+    std::unordered_map<int, RequestData> m_connections;
+    std::deque<int> m_incoming;
+    std::deque<int> m_readyQueue;
     std::vector<RouteHttp> m_routes;
 
     HttpConfig m_config;
     RouteHttp::RouteFunc m_preRoute = nullptr;
     RouteHttp::RouteFunc m_postRoute = nullptr;
+    std::function<void(int, bool)> m_congestionCallback = nullptr;
+    size_t m_queuedCount = 0;
+    ByteArray m_overloadResponse;
+    mutable Mutex m_statsMutex;
+    EvictionStats m_evictionStats;
+    ShedStats m_shedStats;
+    // declared last to be stopped before anything its tasks use is gone
+    ThreadPool m_workers;
 };
 
 }
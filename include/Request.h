@@ -52,6 +52,7 @@ public:
     Request& operator=(Request&& other) = default;
 
     bool Parse(const ByteArray &data);
+    bool IsMalformed() const;
     int GetConnectionID() const;
     void SetConnectionID(int connID);
     const HttpConfig& GetConfig() const;
@@ -89,6 +90,7 @@ private:
     Http::Method m_method = Http::Method::Undefined;
     std::string m_httpVersion = "HTTP/1.1";
     size_t m_requestLineLength = 0;
+    bool m_malformed = false;
     std::map<std::string, std::string> m_args;    
     RequestBody m_requestBody;
     std::string m_remote;
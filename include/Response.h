@@ -91,7 +91,8 @@ protected:
 
     void InitDefault();
     ByteArray BuildStatusLine() const;
-    ByteArray BuildHeaders() const;    
+    ByteArray BuildHeaders() const;
+    bool SendFile(ICommunicationServer *communication);
     bool ParseStatusLine(const ByteArray &data, size_t &pos);
     bool DecodeBody(EncodingType type, const ByteArray &data, size_t pos);
     static EncodingType String2EncodingType(const std::string &str);
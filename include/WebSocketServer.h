@@ -29,6 +29,7 @@
 
 #include <memory>
 #include <deque>
+#include <unordered_map>
 #include "HttpConfig.h"
 #include "RouteHttp.h"
 #include "RouteWebSocket.h"
@@ -41,6 +42,7 @@
 #include "ThreadWorker.h"
 #include "Mutex.h"
 #include "Signal.h"
+#include "TimingWheel.h"
 
 
 namespace WebCpp
@@ -67,6 +69,10 @@ public:
 
     bool SendResponse(const ResponseWebSocket &response);
 
+    void SetCongestionCallback(const std::function<void(int, bool)> &callback);
+    bool IsCongested(int connID) const;
+    SocketPool::HandshakeStats GetHandshakeStats() const;
+
     Http::Protocol GetProtocol() const;
     std::string ToString() const;
 
@@ -78,6 +84,7 @@ protected:
             this->connID= connID;
             readyForDispatch = false;
             handshake = false;
+            incoming = false;
             request.SetConnectionID(connID);
             request.SetConfig(config);
             request.GetHeader().SetRemote(remote);
@@ -89,11 +96,14 @@ protected:
         std::vector<RequestWebSocket> requestList;
         bool handshake;
         bool readyForDispatch;
+        // the connection is in the list of those to be parsed
+        bool incoming;
     };
 
     void OnConnected(int connID, const std::string& remote);
     void OnDataReady(int connID, ByteArray &data);
     void OnClosed(int connID);
+    void OnCongestion(int connID, bool congested);
 
     bool StartRequestThread();
     bool StopRequestThread();
@@ -109,22 +119,37 @@ protected:
     void ProcessRequests();
     void RemoveFromQueue(int connID);
     bool ProcessRequest(Request &request);
+    RequestData* GetRequestData(int connID);
+    void SetIncoming(RequestData &requestData);
     bool CheckWsHeader(RequestData& requestData);
     bool CheckWsFrame(RequestData &requestData);
     bool ProcessWsRequest(Request &request, const RequestWebSocket &wsRequest);
     RouteWebSocket* GetRoute(const std::string &path);
+    void OnTimer(int connID, int type);
 
 private:
+    enum TimerType
+    {
+        Ping = 0,
+        PingTimeout,
+    };
+
     std::shared_ptr<ICommunicationServer> m_server = nullptr;
     Http::Protocol m_protocol = Http::Protocol::Undefined;
     ThreadWorker m_requestThread;
+    TimingWheel m_timers;
     Mutex m_queueMutex;
     Mutex m_signalMutex;
     Mutex m_requestMutex;
     Signal m_signalCondition;
-    std::deque<RequestData> m_requestQueue;
+    // the state of every connection, the connections that got data since they were
+    // parsed last time and the ones which have a request or messages to be processed
+    std::unordered_map<int, RequestData> m_connections;
+    std::deque<int> m_incoming;
+    std::deque<int> m_readyQueue;
     HttpConfig m_config;
     std::vector<RouteWebSocket> m_routes;
+    std::function<void(int, bool)> m_congestionCallback = nullptr;
 };
 
 }
@@ -35,8 +35,6 @@
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 
-#define MAX_CLIENTS 10
-#define READ_BUFFER_SIZE 1024
 
 
 namespace WebCpp
@@ -21,46 +21,37 @@
 * SOFTWARE.
 *
 */
-
-#ifndef WEBCPP_KEEP_ALIVE_TIMER_H
-#define WEBCPP_KEEP_ALIVE_TIMER_H
+#ifndef WEBCPP_COMMUNICATION_UNIX_SERVER_H
+#define WEBCPP_COMMUNICATION_UNIX_SERVER_H
 
 #include <functional>
 #include <vector>
-#include <inttypes.h>
-#include <ThreadWorker.h>
-#include "Mutex.h"
+#include "ICommunicationServer.h"
 
 
 namespace WebCpp
 {
 
-class KeepAliveTimer final
+/* accepts the connections on a Unix domain socket, the path is
+ * set with SetHost(), the port is ignored */
+class CommunicationUnixServer : public ICommunicationServer
 {
 public:
-    ~KeepAliveTimer();
-    static void run();
-    static void stop();
-    static void SetCallback(std::function<void(int)> callback);
-    static void SetTimer(uint32_t delay, int connID);
+    CommunicationUnixServer(const std::string &path = "") noexcept;
+    virtual ~CommunicationUnixServer();
 
-protected:
-    static void *task(bool &);
+    void SetPermissions(int permissions);
+    int GetPermissions() const;
 
-private:
-    struct Timer
-    {
-        int connID;
-        int ticks;
-        int remain;
-    };
+    bool Init() override final;
+    bool Connect(const std::string &address = "", int port = 0) override;
+    bool Close(bool wait = true) override;
 
-    static std::function<void(int)> m_callback;
-    static ThreadWorker m_task;
-    static std::vector<Timer> m_timers;
-    static Mutex m_mutex;
+private:
+    int m_permissions = DEFAULT_UNIX_SOCKET_PERMISSIONS;
+    std::string m_boundPath;
 };
 
 }
 
-#endif // WEBCPP_KEEP_ALIVE_TIMER_H
+#endif // WEBCPP_COMMUNICATION_UNIX_SERVER_H
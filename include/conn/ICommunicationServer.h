@@ -25,16 +25,25 @@
 #ifndef WEBCPP_ICOMMUNICATION_SERVER_H
 #define WEBCPP_ICOMMUNICATION_SERVER_H
 
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <memory>
+#include <vector>
 #include "ICommunication.h"
 #include "common_webcpp.h"
 #include "SocketPool.h"
 #include "ThreadWorker.h"
+#include "ThreadPool.h"
+#include "ListenerHandoff.h"
 #include "Mutex.h"
 
-#define MAX_CLIENTS 10
-#define QUEUE_SIZE 10
-#define READ_BUFFER_SIZE 1024
+#define DEFAULT_REACTOR_COUNT 1
+#define DEFAULT_MAX_CONNECTIONS 100000
+#define DEFAULT_THREAD_NAME "webcpp"
+// connID = slot generation (11 bits) | slot index over all reactors (20 bits)
+#define CONNID_INDEX_BITS 20
+#define CONNID_INDEX_MASK ((1 << CONNID_INDEX_BITS) - 1)
 
 
 namespace WebCpp
@@ -51,10 +60,50 @@ public:
     int GetPort() const override;
     void SetHost(const std::string &host) override;
     std::string GetHost() const override;
+    void SetPollMethod(SocketPool::PollMethod method);
+    SocketPool::PollMethod GetPollMethod() const;
+    void SetReactorCount(size_t count);
+    size_t GetReactorCount() const;
+    void SetMaxConnections(size_t count);
+    size_t GetMaxConnections() const;
+    void SetListenBacklog(int backlog);
+    int GetListenBacklog() const;
+    void SetSocketOptions(const SocketPool::SocketOptions &options);
+    const SocketPool::SocketOptions& GetSocketOptions() const;
+    void SetHandshakeTimeout(int timeout);
+    int GetHandshakeTimeout() const;
+    void SetSslSessionCache(size_t size, int ticketKeyLifetime);
+    void SetKtls(bool enable);
+    bool IsKtls() const;
+    void SetHandshakeWorkers(size_t count);
+    size_t GetHandshakeWorkers() const;
+    SocketPool::HandshakeStats GetHandshakeStats() const;
+    void SetWriteWatermarks(size_t high, size_t low);
+    void SetZeroCopyThreshold(size_t threshold);
+    size_t GetZeroCopyThreshold() const;
+    void SetHandoff(const std::string &path, int drainTimeout = DEFAULT_DRAIN_TIMEOUT);
+    bool IsDraining() const;
+    void SetThreadName(const std::string &name);
+    void SetReactorCpus(const std::vector<int> &cpus);
+    void SetWorkerCpus(const std::vector<int> &cpus);
+    bool IsCongested(int connID) const;
+    bool GetWriteProgress(int connID, bool &pending, uint64_t &sent) const;
+#ifdef WITH_OPENSSL
+    void SetSslCredentials(const std::string &cert, const std::string &key);
+#endif
 
     virtual bool CloseConnection(int connID);
+    bool CloseAfterSend(int connID, int timeout = CLOSE_AFTER_SEND_TIMEOUT);
     virtual bool Write(int connID, ByteArray &data);
     virtual bool Write(int connID, ByteArray &data, size_t size);
+    virtual bool Write(int connID, const struct iovec *iov, size_t count);
+    virtual bool SendFile(int connID, int file, size_t size);
+    virtual bool WriteZeroCopy(int connID, ByteArray &data);
+    bool IsSendFileSupported(int connID) const;
+    bool Cork(int connID);
+    bool Uncork(int connID);
+    bool PauseReading(int connID);
+    bool ResumeReading(int connID);
     virtual bool Init() override;
     virtual bool Connect(const std::string &host = "", int port = 0) override;
     bool Close(bool wait = true) override;
@@ -64,19 +113,81 @@ public:
     virtual bool SetNewConnectionCallback(const std::function<void(int, const std::string&)> &callback) { m_newConnectionCallback = callback; return true; };
     virtual bool SetDataReadyCallback(const std::function<void(int, ByteArray &data)> &callback) { m_dataReadyCallback = callback; return true; };
     virtual bool SetCloseConnectionCallback(const std::function<void(int)> &callback) { m_closeConnectionCallback = callback; return true; };
+    virtual bool SetCongestionCallback(const std::function<void(int, bool)> &callback) { m_congestionCallback = callback; return true; };
+    virtual bool SetReadClosedCallback(const std::function<void(int)> &callback) { m_readClosedCallback = callback; return true; };
 
 protected:
+    /* each reactor owns its own listening socket (bound with SO_REUSEPORT
+     * if there are several of them), its own connections and its own thread */
+    struct Reactor
+    {
+        Reactor(size_t index, size_t capacity, SocketPool::Domain domain, SocketPool::Type type, SocketPool::Options options):
+            sockets(capacity, SocketPool::Service::Server, domain, type, options)
+        {
+            this->index = index;
+        }
+
+        size_t index;
+        SocketPool sockets;
+        ThreadWorker thread;
+    };
+
     virtual void CloseConnections();
-    SocketPool m_sockets;
-    Mutex m_writeMutex;
+    int ToConnID(const Reactor *reactor, size_t index) const;
+    Reactor* FromConnID(int connID, size_t &index) const;
+    static uint32_t GenerationOf(int connID);
+    void SetSharedError(const std::string &error);
+    void* ReadThread(bool &running, Reactor *reactor);
+    void OnCongestion(Reactor *reactor, size_t index, bool congested);
+    bool InheritListeners(std::vector<int> &sockets);
+    std::vector<int> GetListenSockets() const;
+    void OnHandedOff();
+
+    std::vector<std::unique_ptr<Reactor>> m_reactors;
+    Mutex m_errorMutex;
 
-    void* ReadThread(bool &running);
-    ThreadWorker m_readThread;
-    char m_readBuffer[READ_BUFFER_SIZE];
+    SocketPool::Domain m_domain;
+    SocketPool::Type m_type;
+    SocketPool::Options m_options;
+    SocketPool::PollMethod m_pollMethod = SocketPool::PollMethod::Epoll;
+    size_t m_reactorCount = DEFAULT_REACTOR_COUNT;
+    size_t m_maxConnections = DEFAULT_MAX_CONNECTIONS;
+    int m_listenBacklog = DEFAULT_LISTEN_BACKLOG;
+    SocketPool::SocketOptions m_socketOptions;
+    int m_handshakeTimeout = DEFAULT_HANDSHAKE_TIMEOUT;
+    size_t m_sslSessionCacheSize = DEFAULT_SSL_SESSION_CACHE_SIZE;
+    int m_sslTicketKeyLifetime = DEFAULT_SSL_TICKET_KEY_LIFETIME;
+    bool m_ktls = false;
+    size_t m_handshakeWorkers = 0;
+    size_t m_highWatermark = DEFAULT_WRITE_HIGH_WATERMARK;
+    size_t m_lowWatermark = DEFAULT_WRITE_LOW_WATERMARK;
+    size_t m_zeroCopyThreshold = 0;
+    // the listening sockets are taken from the server that runs now and
+    // passed to the one that comes next, this one serves what it has then
+    std::string m_handoffPath;
+    int m_drainTimeout = DEFAULT_DRAIN_TIMEOUT;
+    ListenerHandoff m_handoff;
+    std::atomic<bool> m_draining{false};
+    std::chrono::steady_clock::time_point m_drainDeadline;
+    // a reactor thread is pinned to one CPU of the list, the handshake
+    // workers may run on any CPU of theirs
+    std::string m_threadName = DEFAULT_THREAD_NAME;
+    std::vector<int> m_reactorCpus;
+    std::vector<int> m_workerCpus;
+    std::string m_host = DEFAULT_HOST;
+    int m_port = DEFAULT_PORT;
+#ifdef WITH_OPENSSL
+    std::string m_cert;
+    std::string m_key;
+    // shared by the reactors, declared after them to be stopped first
+    std::unique_ptr<ThreadPool> m_handshakePool;
+#endif
 
     std::function<void(int, const std::string&)> m_newConnectionCallback = nullptr;
     std::function<void(int, ByteArray &data)> m_dataReadyCallback = nullptr;
     std::function<void(int)> m_closeConnectionCallback = nullptr;
+    std::function<void(int, bool)> m_congestionCallback = nullptr;
+    std::function<void(int)> m_readClosedCallback = nullptr;
 };
 
 }
@@ -27,6 +27,7 @@
 
 #include <string>
 #include <fstream>
+#include "Mutex.h"
 
 #define LOG(S,T) LogWriter::Instance().Write(S,T)
 
@@ -55,6 +56,7 @@ protected:
 private:
     bool m_opened = false;
     std::ofstream m_streams[3];
+    WebCpp::Mutex m_mutex;
 };
 
 #endif // WEBCPP_LOGWRITER_H
@@ -0,0 +1,103 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef WEBCPP_TIMING_WHEEL_H
+#define WEBCPP_TIMING_WHEEL_H
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <inttypes.h>
+#include "ThreadWorker.h"
+#include "Mutex.h"
+
+#define TIMING_WHEEL_TICK 50 // msec.
+#define TIMING_WHEEL_LEVELS 4
+#define TIMING_WHEEL_SLOT_BITS 6
+#define TIMING_WHEEL_SLOTS (1 << TIMING_WHEEL_SLOT_BITS)
+
+
+namespace WebCpp
+{
+
+/* a hierarchical timing wheel. A timer is put to the slot of the level which
+ * covers its delay and moves one level down each time the upper wheel turns,
+ * so arming, re-arming and cancelling a timer don't depend on the count of
+ * the timers. A timer is identified by the connection and the timer type.
+ * An expired timer is removed before its callback is called, so if it is set
+ * again meanwhile IsTimerSet() tells the callback that it is stale */
+class TimingWheel final
+{
+public:
+    explicit TimingWheel(uint32_t tick = TIMING_WHEEL_TICK);
+    ~TimingWheel();
+    TimingWheel(const TimingWheel& other) = delete;
+    TimingWheel& operator=(const TimingWheel& other) = delete;
+    TimingWheel(TimingWheel&& other) = delete;
+    TimingWheel& operator=(TimingWheel&& other) = delete;
+
+    void SetName(const std::string &name);
+    void SetAffinity(const std::vector<int> &cpus);
+    bool Start();
+    void Stop();
+    void SetCallback(const std::function<void(int, int)> &callback);
+    void SetTimer(int id, int type, uint32_t delay);
+    bool CancelTimer(int id, int type);
+    bool IsTimerSet(int id, int type) const;
+    size_t GetCount() const;
+
+protected:
+    void* Task(bool &running);
+
+private:
+    struct Timer
+    {
+        uint64_t key;
+        uint64_t expires;
+        size_t level;
+        size_t slot;
+        Timer *prev;
+        Timer *next;
+    };
+
+    static uint64_t MakeKey(int id, int type);
+    void Insert(Timer *timer);
+    void Unlink(Timer *timer);
+    void Advance(std::vector<uint64_t> &expired);
+
+    std::function<void(int, int)> m_callback = nullptr;
+    ThreadWorker m_task;
+    mutable Mutex m_mutex;
+    std::unordered_map<uint64_t, Timer> m_timers;
+    Timer *m_wheel[TIMING_WHEEL_LEVELS][TIMING_WHEEL_SLOTS] = {};
+    uint32_t m_tick;
+    uint64_t m_ticks = 0;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+}
+
+#endif // WEBCPP_TIMING_WHEEL_H
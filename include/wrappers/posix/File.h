@@ -22,6 +22,7 @@ public:
     ~File();
     bool Open(const std::string &file, Mode mode);
     bool Close();
+    int Detach();
     size_t Read(char *buffer, size_t size);
     size_t Write(const char *buffer, size_t size);
     bool IsOpened() const;
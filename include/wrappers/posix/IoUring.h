@@ -0,0 +1,126 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef WEBCPP_IO_URING_H
+#define WEBCPP_IO_URING_H
+
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include <vector>
+#include "IErrorable.h"
+#include "Mutex.h"
+
+#define IO_URING_QUEUE_SIZE 256
+#define IO_URING_IGNORE_DATA 0xFFFFFFFFFFFFFFFFULL
+#define IO_URING_BUFFER_COUNT 256 // must be a power of two
+#define IO_URING_BUFFER_SIZE 8192
+#define IO_URING_BUFFER_GROUP 0
+
+
+namespace WebCpp
+{
+
+/* a minimal io_uring ring built on the raw system calls. It keeps the
+ * multishot polls the reactor needs and, where the kernel has them, the
+ * multishot accept, the multishot recv into a ring of provided buffers and
+ * the linked sends. The submissions are guarded so a socket can be written
+ * or removed from any thread, the completions and the provided buffers
+ * are handled by the polling thread only */
+class IoUring: public IErrorable
+{
+public:
+    struct Completion
+    {
+        uint64_t data;
+        int32_t result;
+        uint32_t flags;
+    };
+
+    IoUring() = default;
+    ~IoUring();
+    IoUring(const IoUring& other) = delete;
+    IoUring& operator=(const IoUring& other) = delete;
+
+    bool Init(unsigned entries = IO_URING_QUEUE_SIZE);
+    void Close();
+    bool IsInitialized() const;
+    bool PollAdd(int fd, uint32_t events, uint64_t data, bool multishot = true);
+    bool PollRemove(uint64_t data);
+    bool AcceptAdd(int fd, uint64_t data);
+    bool RecvAdd(int fd, uint64_t data);
+    size_t SendAdd(int fd, const struct iovec *iov, size_t count, int flags, uint64_t data);
+    bool Cancel(uint64_t data);
+    bool CancelFd(int fd);
+    bool Submit();
+    int Wait(int timeout, std::vector<Completion> &completions);
+    bool InitBuffers(unsigned count = IO_URING_BUFFER_COUNT, unsigned size = IO_URING_BUFFER_SIZE);
+    bool HasBuffers() const;
+    const uint8_t* GetBuffer(uint16_t id) const;
+    void ReturnBuffer(uint16_t id);
+
+    static bool IsSupported();
+    static bool IsCompletionSupported();
+
+protected:
+    struct io_uring_sqe* GetSqe();
+    void Commit();
+    bool SubmitPending();
+    void AddBuffer(uint16_t id);
+    static bool Probe();
+    static bool ProbeCompletion();
+
+private:
+    int m_fd = (-1);
+    void *m_sqRing = nullptr;
+    void *m_cqRing = nullptr;
+    struct io_uring_sqe *m_sqes = nullptr;
+    size_t m_sqRingSize = 0;
+    size_t m_cqRingSize = 0;
+    size_t m_sqesSize = 0;
+    unsigned *m_sqHead = nullptr;
+    unsigned *m_sqTail = nullptr;
+    unsigned *m_sqMask = nullptr;
+    unsigned *m_sqArray = nullptr;
+    unsigned m_sqEntries = 0;
+    unsigned *m_cqHead = nullptr;
+    unsigned *m_cqTail = nullptr;
+    unsigned *m_cqMask = nullptr;
+    struct io_uring_cqe *m_cqes = nullptr;
+    unsigned m_tail = 0;
+    unsigned m_pending = 0;
+    Mutex m_submitMutex;
+    // the provided buffers the kernel receives the data into
+    struct io_uring_buf_ring *m_bufferRing = nullptr;
+    size_t m_bufferRingSize = 0;
+    uint8_t *m_buffers = nullptr;
+    unsigned m_bufferCount = 0;
+    unsigned m_bufferSize = 0;
+    uint16_t m_bufferTail = 0;
+};
+
+}
+
+#endif // WEBCPP_IO_URING_H
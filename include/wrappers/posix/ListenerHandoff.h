@@ -0,0 +1,74 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+#ifndef WEBCPP_LISTENER_HANDOFF_H
+#define WEBCPP_LISTENER_HANDOFF_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "IErrorable.h"
+#include "ThreadWorker.h"
+
+#define MAX_HANDOFF_SOCKETS 64
+#define HANDOFF_TIMEOUT 5000
+#define DEFAULT_DRAIN_TIMEOUT 30000
+
+
+namespace WebCpp
+{
+
+/* passes the listening sockets of a running server to the one that replaces it.
+ * The running server waits on a Unix socket, the new one connects and gets the
+ * descriptors with SCM_RIGHTS, so the sockets keep accepting all the time and
+ * the clients queued in them are served by the new process */
+class ListenerHandoff: public IErrorable
+{
+public:
+    using SocketsFunc = std::function<std::vector<int>()>;
+    using HandedOffFunc = std::function<void()>;
+
+    ListenerHandoff() = default;
+    ~ListenerHandoff();
+    ListenerHandoff(const ListenerHandoff& other) = delete;
+    ListenerHandoff& operator=(const ListenerHandoff& other) = delete;
+
+    bool Receive(const std::string &path, std::vector<int> &sockets);
+    bool Serve(const std::string &path, const SocketsFunc &sockets, const HandedOffFunc &handedOff);
+    void Close();
+
+protected:
+    void *ServeThread(bool &running);
+    bool HandOff(int fd);
+
+private:
+    std::string m_path;
+    int m_fd = (-1);
+    ThreadWorker m_thread;
+    SocketsFunc m_sockets = nullptr;
+    HandedOffFunc m_handedOff = nullptr;
+};
+
+}
+
+#endif // WEBCPP_LISTENER_HANDOFF_H
@@ -26,12 +26,20 @@
 #define WEBCPP_PLATFORM_H
 
 #include <inttypes.h>
+#include <string>
+#include <vector>
 
 namespace WebCpp
 {
 
 void Sleep(uint32_t delay);
 void SleepMs(uint32_t delay);
+// a CPU list like "0-3,8,10-11", as taskset and /sys use it
+bool ParseCpuList(const std::string &list, std::vector<int> &cpus);
+// the NUMA node of the CPU, (-1) if it is unknown
+int GetCpuNode(int cpu);
+// the memory the calling thread faults in is taken from the node while it has room
+bool SetPreferredNode(int node);
 
 }
 
@@ -37,6 +37,7 @@ class Signal
 public:
     Signal();
     void Fire();
+    void FireAll();
     void Wait(Mutex &mutex);
 
 private:
@@ -26,19 +26,53 @@
 #define WEBCPP_SOCKET_POOL_H
 
 #include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <stddef.h>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <chrono>
+#include <memory>
+#include <atomic>
 #ifdef WITH_OPENSSL
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #endif
 #include "IErrorable.h"
 #include "Mutex.h"
+#include "IoUring.h"
+#include "SslContext.h"
+#include "ThreadPool.h"
+#include "common_webcpp.h"
 
 #define POLL_TIMEOUT 500
 #define DEFAULT_HOST "*"
 #define DEFAULT_PORT 80
 #define DEFAULT_SSL_PORT 430
 #define DEFAULT_CONNECT_TIMEOUT 1000
+#define DEFAULT_LISTEN_BACKLOG SOMAXCONN
+#define DEFAULT_HANDSHAKE_TIMEOUT 10000
+#define DEFAULT_UNIX_SOCKET_PERMISSIONS 0660
+#define CONNECTION_CHUNK_SIZE 256
+#define EPOLL_MAX_EVENTS 1024
+#define OUTBOUND_BLOCK_SIZE 16_Kb
+#define DEFAULT_WRITE_HIGH_WATERMARK 1_Mb
+#define DEFAULT_WRITE_LOW_WATERMARK 256_Kb
+#define FLUSH_IOV_COUNT 64
+#define MIN_READ_BUFFER_SIZE 1_Kb
+#define DEFAULT_READ_BUFFER_SIZE 4_Kb
+#define ZEROCOPY_LINGER_TIMEOUT 30000
+#define MAX_READ_BUFFER_SIZE 256_Kb
+#define GENERATION_MASK 0x7FF
+#define ANY_GENERATION 0xFFFFFFFF
+#define WAKEUP_EVENT_DATA 0xFFFFFFFFFFFFFFFEULL
+#define READ_HOLD_PAUSED 0x1
+#define READ_HOLD_CONGESTED 0x2
+#define READ_HOLD_CLOSING 0x4
+#define READ_HOLD_CLOSED 0x8
+#define CLOSE_AFTER_SEND_TIMEOUT 10000
 
 
 namespace WebCpp
@@ -71,9 +105,52 @@ public:
         None = 0,
         ReuseAddr = 1,
         Ssl = 2,
+        ReusePort = 4,
+    };
+    enum class PollMethod
+    {
+        Poll = 0,
+        Epoll,
+        IoUring,
+    };
+    enum class AcceptStatus
+    {
+        Accepted = 0,
+        // this client is gone or has no room, the next ones are still queued
+        Dropped,
+        // no more clients are waiting
+        Empty,
+        Failed,
+    };
+    /* TCP tuning of the server sockets, zero means the system default.
+     * The listener gets the buffers, deferred accept and fast open,
+     * every accepted socket gets no-delay and the keepalive probes */
+    struct SocketOptions
+    {
+        bool noDelay = false;
+        bool cork = false;
+        int deferAccept = 0;
+        int fastOpen = 0;
+        int receiveBuffer = 0;
+        int sendBuffer = 0;
+        bool keepAlive = false;
+        int keepAliveIdle = 0;
+        int keepAliveInterval = 0;
+        int keepAliveCount = 0;
+    };
+    /* TLS handshake counters, the times are in microseconds */
+    struct HandshakeStats
+    {
+        size_t full = 0;
+        size_t resumed = 0;
+        size_t failed = 0;
+        size_t timedOut = 0;
+        size_t ktls = 0;
+        uint64_t totalTime = 0;
+        uint64_t maxTime = 0;
     };
 
-    SocketPool(size_t count, Service service, Domain domain, Type type, Options options = Options::None);
+    SocketPool(size_t capacity, Service service, Domain domain, Type type, Options options = Options::None);
     ~SocketPool();
     SocketPool(const SocketPool& other) = delete;
     SocketPool& operator=(const SocketPool& other) = delete;
@@ -81,46 +158,211 @@ public:
     SocketPool& operator=(SocketPool&& other) = delete;
 
     int Create(bool main = false);
-    bool CloseSocket(size_t index);
+    bool CloseSocket(size_t index, uint32_t generation = ANY_GENERATION);
     bool CloseSockets();
     bool Bind(const std::string &host, int port);
     bool Listen();
-    size_t Accept();
+    size_t Accept(AcceptStatus &status);
+    int GetListenSocket() const;
+    bool SetListenSocket(int fd);
     bool Connect(const std::string &host, int port = 0);
-    size_t Write(const uint8_t *buffer, size_t size, size_t index = 0);
+    size_t Write(const uint8_t *buffer, size_t size, size_t index = 0, uint32_t generation = ANY_GENERATION);
+    size_t Write(const struct iovec *iov, size_t count, size_t index = 0, uint32_t generation = ANY_GENERATION);
+    bool Flush(size_t index = 0);
+    size_t SendFile(int file, off_t offset, size_t size, size_t index = 0, uint32_t generation = ANY_GENERATION);
+    bool IsSendFileSupported(size_t index, uint32_t generation = ANY_GENERATION) const;
+    size_t WriteZeroCopy(ByteArray &data, size_t index, uint32_t generation = ANY_GENERATION);
+    void SetZeroCopyThreshold(size_t threshold);
+    size_t GetZeroCopyThreshold() const;
+    bool Cork(size_t index, uint32_t generation = ANY_GENERATION);
+    bool Uncork(size_t index, uint32_t generation = ANY_GENERATION);
+    bool PauseReading(size_t index, uint32_t generation = ANY_GENERATION);
+    bool ResumeReading(size_t index, uint32_t generation = ANY_GENERATION);
+    bool IsReadingPaused(size_t index) const;
     size_t Read(void *buffer, size_t size, size_t index = 0);
+    size_t Read(ByteArray &data, size_t index, bool &closed);
 
     void SetPollRead();
     void SetPollWrite();
     bool Poll();
+    void Interrupt();
+    const std::vector<size_t>& GetReadyList() const;
     bool HasData(size_t index) const;
+    bool IsWritable(size_t index) const;
     bool IsPollError(size_t index) const;
+    bool IsActive(size_t index) const;
+    uint32_t GetGeneration(size_t index) const;
+    void SetPollMethod(PollMethod method);
+    PollMethod GetPollMethod() const;
+    void SetWriteWatermarks(size_t high, size_t low);
+    bool IsCongested(size_t index) const;
+    bool GetWriteProgress(size_t index, uint32_t generation, bool &pending, uint64_t &sent) const;
+    void SetCongestionCallback(const std::function<void(size_t, bool)> &callback);
 
     void SetPort(int port);
     int GetPort() const;
     void SetHost(const std::string &host);
     std::string GetHost() const;
     size_t GetCount() const;
+    size_t GetCapacity() const;
     int GetConnectTimeout() const;
     void SetConnectTimeout(int timeout);
+    int GetListenBacklog() const;
+    void SetListenBacklog(int backlog);
+    const SocketOptions& GetSocketOptions() const;
+    void SetSocketOptions(const SocketOptions &options);
+    int GetHandshakeTimeout() const;
+    void SetHandshakeTimeout(int timeout);
+    HandshakeStats GetHandshakeStats() const;
+    const std::vector<size_t>& GetExpiredHandshakes();
+    bool CloseAfterSend(size_t index, uint32_t generation = ANY_GENERATION, int timeout = CLOSE_AFTER_SEND_TIMEOUT);
+    const std::vector<size_t>& GetDrainedSockets();
     std::string GetRemoteAddress(size_t index) const;
+    std::string GetSharedError();
     std::string ToString() const;
 #ifdef WITH_OPENSSL
     void SetSslCredentials(const std::string &cert, const std::string &key);
+    void SetSslContext(const std::shared_ptr<SslContext> &context);
+    std::shared_ptr<SslContext> GetSslContext() const;
+    void SetHandshakePool(ThreadPool *pool);
 #endif
     static int Domain2Domain(SocketPool::Domain domain);
     static int Type2Type(SocketPool::Type type);
     static std::string Domain2String(SocketPool::Domain domain);
     static std::string Type2String(SocketPool::Type type);
     static std::string Service2String(SocketPool::Service service);
+    static std::string PollMethod2String(SocketPool::PollMethod method);
 
 protected:
-    int FindEmpty();
+    /* an entry of the outbound queue, either a block of data
+     * or a part of a file that is sent by sendfile() */
+    struct Outbound
+    {
+        Outbound(const uint8_t *buffer, size_t size): data(buffer, buffer + size) {}
+        Outbound(int file, off_t offset, size_t size): file(file), fileOffset(offset), fileSize(size) {}
+        Outbound(const std::shared_ptr<ByteArray> &buffer): zeroCopy(buffer) {}
+        bool IsData() const { return (file == (-1) && zeroCopy == nullptr); }
+        ByteArray data;
+        int file = (-1);
+        off_t fileOffset = 0;
+        size_t fileSize = 0;
+        // a buffer sent with MSG_ZEROCOPY, the kernel reads it until the send is completed
+        std::shared_ptr<ByteArray> zeroCopy;
+    };
+
+    /* a zero-copy send call that the kernel hasn't reported as completed yet,
+     * the buffer is kept till then. The calls are numbered by the kernel */
+    struct ZeroCopySend
+    {
+        uint32_t seq;
+        std::shared_ptr<ByteArray> buffer;
+    };
+
+    /* a slot of the connection table. The generation is increased every time
+     * the slot is released so a stale index can be told from a reused one.
+     * The mutex orders the writes to the connection and guards its SSL object,
+     * writes to different connections don't wait for each other */
+    struct Connection
+    {
+        Mutex mutex;
+        size_t index = 0;
+        int fd = (-1);
+        uint32_t generation = 0;
+        short events = 0;
+        short revents = 0;
+#ifdef WITH_OPENSSL
+        SSL *ssl = nullptr;
+        // the server side handshake is driven by the socket events
+        // instead of waiting for the client in the reactor thread
+        bool handshaking = false;
+        bool handshakeWantWrite = false;
+        std::chrono::steady_clock::time_point handshakeStart;
+        // the records are encrypted by the kernel, a file can be sent with sendfile()
+        bool ktlsSend = false;
+        // a handshake pool thread owns the connection, the events
+        // that come meanwhile are reported again when it's done
+        std::atomic<bool> handshakeQueued{false};
+        std::atomic<bool> handshakeAgain{false};
+#endif
+        // the data that the socket didn't accept yet, sent on POLLOUT.
+        // outboundSize counts the bytes kept in memory, not the files
+        std::deque<Outbound> outbound;
+        size_t outboundOffset = 0;
+        size_t outboundSize = 0;
+        // the bytes sent from the queue so far, a client that
+        // doesn't read what it was sent is seen by this
+        uint64_t outboundSent = 0;
+        // changed under the connection mutex, read without it by IsCongested()
+        std::atomic<bool> congested{false};
+        int corked = 0;
+        // nothing more is written, the socket is closed once the queue is sent
+        bool closing = false;
+        // the room the next read starts with, adapted to the amount of data
+        // the connection usually brings in one go
+        size_t readSize = DEFAULT_READ_BUFFER_SIZE;
+        // the reasons the socket isn't read now (READ_HOLD_*), the socket
+        // is read again when they are gone if something came meanwhile
+        std::atomic<int> readHolds{0};
+        std::atomic<bool> readPending{false};
+        // the peer has shut its side down, set and looked at by the reactor only
+        bool readClosed = false;
+        // the socket can send the large blocks with MSG_ZEROCOPY,
+        // it doesn't once the kernel reports that it copies them anyway
+        bool zeroCopy = false;
+        bool zeroCopyCopied = false;
+        uint32_t zeroCopySeq = 0;
+        std::deque<ZeroCopySend> zeroCopyPending;
+        // the socket is read and written by the io_uring requests instead of
+        // being polled. The multishot recv is armed while ringRecvArmed is set,
+        // what it brings is kept in ringInput till the reactor reads it. The
+        // first ringEntries blocks of the queue are sent by ringSends linked
+        // sends, ringSent is what they have taken and not yet left the queue
+        bool ringIo = false;
+        bool ringRecvArmed = false;
+        ByteArray ringInput;
+        size_t ringSends = 0;
+        size_t ringEntries = 0;
+        size_t ringSent = 0;
+        bool ringPollOut = false;
+        int ringError = 0;
+    };
+
+    Connection* GetConnection(size_t index) const;
+    int Allocate();
+    void Release(size_t index);
+    size_t SendSome(Connection *conn, const uint8_t *buffer, size_t size);
+    size_t SendSome(Connection *conn, const struct iovec *iov, size_t count, bool more = false);
+    bool SendQueued(Connection *conn, bool &relieved);
+    size_t SendFilePart(Connection *conn, Outbound &entry);
+    size_t SendZeroCopy(Connection *conn, Outbound &entry);
+    bool ReadZeroCopyCompletions(int fd, std::deque<ZeroCopySend> &pending);
+    void ReapZeroCopy();
+    void Enqueue(Connection *conn, const uint8_t *buffer, size_t size);
+    bool WatchOutput(Connection *conn);
+    void TakeRingSent(Connection *conn);
+    bool SubmitRingSends(Connection *conn, const struct iovec *iov, size_t count, bool more);
+    bool WatchRingOutput(Connection *conn);
+    void SetSharedError(const std::string &error, int errorCode = NO_ERROR);
+    void ClearSharedError();
     void ParseAddress(const std::string &address);
+    bool BindTcp();
+    bool BindUnix();
     bool ConnectTcp(const std::string &host, int port);
     bool ConnectUnix(const std::string &host);
+    bool ApplyListenOptions(int fd);
+    bool ApplyConnectionOptions(int fd);
+    bool SetTcpCork(Connection *conn, bool cork);
+    bool WatchSocket(size_t index);
+    void UnwatchSocket(size_t index);
+    bool InitEpoll();
+    bool EpollAdd(size_t index);
+    bool EpollDelete(size_t index);
+    bool InitIoUring();
+    bool IoUringAdd(size_t index);
+    bool IoUringDelete(size_t index);
+    bool PollIoUring();
     template <typename T>
-    bool IsContains(T v1, T v2)
+    bool IsContains(T v1, T v2) const
     {
         return ((v1 & v2) == v2);
     }
@@ -128,25 +370,115 @@ protected:
 #ifdef WITH_OPENSSL
     bool InitSSL();
     bool AcceptSsl(int fd, int index);
+    bool Handshake(Connection *conn);
+    bool ContinueHandshake(Connection *conn, size_t index);
+    void HandshakeTask(size_t index, uint32_t generation);
 #endif
+    void HoldRead(Connection *conn, int reason);
+    void ReleaseRead(Connection *conn, size_t index, int reason);
+    void CollectDeferred();
+    void ResetWakeup();
 
 private:
-    size_t m_count;
+    size_t m_capacity;
     Service m_service = Service::Undefined;
     Domain m_domain = Domain::Undefined;
     Type m_type = Type::Undefined;
     Options m_options = Options::None;
-    struct pollfd *m_fds = nullptr;
+    std::vector<Connection *> m_chunks;
+    std::vector<size_t> m_free;
+    size_t m_used = 0;
+    size_t m_count = 0;
+    Mutex m_tableMutex;
+    PollMethod m_pollMethod = PollMethod::Poll;
+    int m_epoll = (-1);
+    struct epoll_event *m_events = nullptr;
+    IoUring m_ring;
+    std::vector<IoUring::Completion> m_completions;
+    // the sockets are read, written and accepted by the ring itself
+    bool m_ringIo = false;
+    // the clients taken by the multishot accept, looked at by the reactor only
+    std::deque<int> m_accepted;
+    // the queued blocks of the closed sockets that the kernel is still sending
+    struct RingLinger
+    {
+        size_t index;
+        uint32_t generation;
+        size_t pending;
+        std::deque<Outbound> outbound;
+    };
+    std::vector<RingLinger> m_ringLinger;
+    Mutex m_ringLingerMutex;
+    std::vector<struct pollfd> m_pollFds;
+    std::vector<size_t> m_pollIndexes;
+    std::vector<uint32_t> m_pollGenerations;
+    std::vector<size_t> m_ready;
+    int m_wakeup = (-1);
+    size_t m_highWatermark = DEFAULT_WRITE_HIGH_WATERMARK;
+    size_t m_lowWatermark = DEFAULT_WRITE_LOW_WATERMARK;
+    std::function<void(size_t, bool)> m_congestionCallback = nullptr;
+    size_t m_zeroCopyThreshold = 0;
+    // the closed sockets that still wait for the kernel to release their buffers
+    struct ZeroCopyLinger
+    {
+        int fd;
+        std::deque<ZeroCopySend> pending;
+        std::chrono::steady_clock::time_point deadline;
+    };
+    std::vector<ZeroCopyLinger> m_zeroCopyLinger;
+    Mutex m_zeroCopyLingerMutex;
 #ifdef WITH_OPENSSL
     std::string m_cert;
     std::string m_key;
-    SSL_CTX *m_ctx = nullptr;
-    SSL **m_sslClient = nullptr;
+    std::shared_ptr<SslContext> m_sslContext;
+    // the handshakes in the order they expire
+    struct PendingHandshake
+    {
+        size_t index;
+        uint32_t generation;
+        std::chrono::steady_clock::time_point deadline;
+    };
+    std::deque<PendingHandshake> m_handshakes;
+    // the handshake steps finished by the pool threads, picked up by Poll()
+    enum class HandshakeState
+    {
+        Pending = 0,
+        Done,
+        Failed,
+    };
+    struct HandshakeResult
+    {
+        size_t index;
+        uint32_t generation;
+        HandshakeState state;
+    };
+    ThreadPool *m_handshakePool = nullptr;
+    std::vector<HandshakeResult> m_handshakeResults;
+    Mutex m_handshakeResultsMutex;
 #endif
+    // the sockets to read again since their reading was resumed
+    std::vector<std::pair<size_t, uint32_t>> m_resumed;
+    Mutex m_resumedMutex;
+    std::vector<size_t> m_expired;
+    // the sockets closed by the reactor once their queue is sent or the deadline passes
+    struct PendingClose
+    {
+        size_t index;
+        uint32_t generation;
+        std::chrono::steady_clock::time_point deadline;
+    };
+    std::vector<PendingClose> m_closing;
+    Mutex m_closingMutex;
+    std::vector<size_t> m_drained;
+    int m_handshakeTimeout = DEFAULT_HANDSHAKE_TIMEOUT;
+    HandshakeStats m_handshakeStats;
+    mutable Mutex m_statsMutex;
     std::string m_host = DEFAULT_HOST;
     int m_port = DEFAULT_PORT;
-    Mutex m_writeMutex;
+    Mutex m_errorMutex;
     int m_connectTimeout = DEFAULT_CONNECT_TIMEOUT;
+    int m_listenBacklog = DEFAULT_LISTEN_BACKLOG;
+    SocketOptions m_socketOptions;
 };
 
 inline SocketPool::Options operator |(SocketPool::Options a, SocketPool::Options b)
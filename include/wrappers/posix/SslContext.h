@@ -0,0 +1,114 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef WEBCPP_SSL_CONTEXT_H
+#define WEBCPP_SSL_CONTEXT_H
+
+#define DEFAULT_SSL_SESSION_CACHE_SIZE 20480
+#define DEFAULT_SSL_TICKET_KEY_LIFETIME 3600
+
+#ifdef WITH_OPENSSL
+
+#include <openssl/ssl.h>
+#include <chrono>
+#include <string>
+#include "IErrorable.h"
+#include "Mutex.h"
+
+// the kernel encrypts the records itself when OpenSSL
+// is built with kTLS and the tls module is loaded
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+#define WITH_KTLS
+#endif
+
+#define TICKET_KEY_NAME_SIZE 16
+#define TICKET_KEY_SIZE 32
+
+
+namespace WebCpp
+{
+
+/* an SSL_CTX created once and shared by all the sockets of a server,
+ * so the certificate is loaded only once and the session cache and
+ * the ticket keys are the same whatever reactor the client gets to */
+class SslContext: public IErrorable
+{
+public:
+    enum class Service
+    {
+        Server = 0,
+        Client,
+    };
+
+    SslContext(Service service);
+    ~SslContext();
+    SslContext(const SslContext& other) = delete;
+    SslContext& operator=(const SslContext& other) = delete;
+
+    bool Init(const std::string &cert, const std::string &key);
+    SSL_CTX* Get() const;
+    void SetSessionCacheSize(size_t size);
+    size_t GetSessionCacheSize() const;
+    void SetTicketKeyLifetime(int seconds);
+    int GetTicketKeyLifetime() const;
+    void SetKtls(bool enable);
+    bool IsKtls() const;
+    static std::string GetErrorString();
+
+protected:
+    /* the tickets are encrypted with the current key, the previous one is
+     * kept for the tickets issued before the rotation so they still resume */
+    struct TicketKey
+    {
+        unsigned char name[TICKET_KEY_NAME_SIZE];
+        unsigned char aesKey[TICKET_KEY_SIZE];
+        unsigned char hmacKey[TICKET_KEY_SIZE];
+        std::chrono::steady_clock::time_point created;
+        bool valid = false;
+    };
+
+    bool CreateTicketKey(TicketKey &key);
+    bool GetTicketKey(const unsigned char *name, TicketKey &key, bool &current);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    static int TicketKeyCallback(SSL *ssl, unsigned char *name, unsigned char *iv,
+                                 EVP_CIPHER_CTX *cipher, EVP_MAC_CTX *mac, int enc);
+#endif
+    static int ExIndex();
+
+private:
+    Service m_service;
+    SSL_CTX *m_ctx = nullptr;
+    size_t m_sessionCacheSize = DEFAULT_SSL_SESSION_CACHE_SIZE;
+    int m_ticketKeyLifetime = DEFAULT_SSL_TICKET_KEY_LIFETIME;
+    bool m_ktls = false;
+    TicketKey m_currentKey;
+    TicketKey m_previousKey;
+    Mutex m_keyMutex;
+};
+
+}
+
+#endif
+
+#endif // WEBCPP_SSL_CONTEXT_H
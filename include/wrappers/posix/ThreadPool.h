@@ -0,0 +1,77 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef WEBCPP_THREAD_POOL_H
+#define WEBCPP_THREAD_POOL_H
+
+#include <functional>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <string>
+#include "IErrorable.h"
+#include "ThreadWorker.h"
+#include "Mutex.h"
+#include "Signal.h"
+
+
+namespace WebCpp
+{
+
+/* a fixed count of threads that execute the posted tasks in the order they come */
+class ThreadPool: public IErrorable
+{
+public:
+    using Task = std::function<void()>;
+
+    ThreadPool() = default;
+    ~ThreadPool();
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+
+    void SetName(const std::string &name);
+    void SetAffinity(const std::vector<int> &cpus);
+    bool Start(size_t count);
+    void Stop();
+    bool Post(const Task &task);
+    size_t GetCount() const;
+    size_t GetQueueSize();
+
+protected:
+    void *Worker(bool &running);
+
+private:
+    std::vector<std::unique_ptr<ThreadWorker>> m_threads;
+    std::deque<Task> m_tasks;
+    Mutex m_mutex;
+    Signal m_signal;
+    bool m_running = false;
+    // a thread is named by the pool name and its number
+    std::string m_name;
+    std::vector<int> m_cpus;
+};
+
+}
+
+#endif // WEBCPP_THREAD_POOL_H
@@ -27,6 +27,8 @@
 
 #include <pthread.h>
 #include <functional>
+#include <string>
+#include <vector>
 #include "IErrorable.h"
 
 
@@ -41,10 +43,12 @@ public:
     ThreadWorker();
     void SetFunction(const std::function<ThreadRoutine> &func);
     void SetFinishFunction(const std::function<ThreadFinishRoutine> &func);
+    void SetName(const std::string &name);
+    void SetAffinity(const std::vector<int> &cpus);
     bool Start();
     void Stop();
     void StopNoWait();
-    void Wait() const;
+    void Wait();
     bool IsRunning() const { return m_isRunning; }
 
 protected:
@@ -55,7 +59,13 @@ private:
     pthread_t m_thread;
     std::function<ThreadRoutine> m_func = nullptr;
     std::function<ThreadFinishRoutine> m_funcFinish = nullptr;
+    // applied at start, the name is cut to what the system allows
+    std::string m_name;
+    std::vector<int> m_cpus;
     bool m_isRunning = false;
+    // the thread is started and not joined yet, it is joined
+    // even if it was asked to stop without waiting for it
+    bool m_joinable = false;
 };
 
 }
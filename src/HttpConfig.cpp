@@ -1,3 +1,4 @@
+#include <sstream>
 #include "common_webcpp.h"
 #include "defines_webcpp.h"
 #include "DebugPrint.h"
@@ -34,15 +35,62 @@ std::string HttpConfig::RootFolder() const
 
 std::string HttpConfig::ToString() const
 {
+    std::stringstream permissions;
+    permissions << std::oct << std::showbase << m_UnixSocketPermissions;
+
     return std::string("HttpConfig :") + "\n" +
             "\tname: " + m_ServerName + "\n" +
             "\tHTTP protocol: " + Http::Protocol2String(m_HttpProtocol) + "\n" +
             "\tHTTP port: " + std::to_string(m_HttpServerPort) + "\n" +
+            "\tHTTP Unix socket: " + m_HttpUnixSocket + "\n" +
             "\tWebSocket protocol: " + Http::Protocol2String(m_WsProtocol) + "\n" +
             "\tWebSocket port: " + std::to_string(m_WsServerPort) + "\n" +
+            "\tWebSocket Unix socket: " + m_WsUnixSocket + "\n" +
+            "\tWebSocket ping interval: " + std::to_string(m_WsPingInterval) + "\n" +
+            "\tUnix socket permissions: " + permissions.str() + "\n" +
+            "\ttimeouts: keep-alive " + std::to_string(m_KeepAliveTimeout) + ", header " + std::to_string(m_RequestHeaderTimeout) +
+                ", body " + std::to_string(m_RequestBodyTimeout) + ", handler " + std::to_string(m_HandlerTimeout) +
+                ", write " + std::to_string(m_WriteTimeout) + "\n" +
+            "\tadmission: max queued requests " + std::to_string(m_MaxQueuedRequests) + ", max queue time " +
+                std::to_string(m_MaxQueueTime) + ", retry after " + std::to_string(m_RetryAfter) + "\n" +
+            "\trequest workers: " + std::to_string(m_RequestWorkers) + "\n" +
+            "\tpoll method: " + SocketPool::PollMethod2String(m_PollMethod) + "\n" +
+            "\treactors: " + std::to_string(m_ReactorCount) + "\n" +
+            "\tCPUs: reactors " + m_ReactorCpus + ", workers " + m_WorkerCpus + "\n" +
+            "\tmax connections: " + std::to_string(m_MaxConnections) + "\n" +
+            "\tlisten backlog: " + std::to_string(m_ListenBacklog) + "\n" +
+            "\tSSL handshake timeout: " + std::to_string(m_SslHandshakeTimeout) + "\n" +
+            "\tSSL session cache: " + std::to_string(m_SslSessionCacheSize) + ", ticket key lifetime: " + std::to_string(m_SslTicketKeyLifetime) + "\n" +
+            "\tSSL kernel offload: " + std::to_string(m_SslKtls) + "\n" +
+            "\tSSL handshake workers: " + std::to_string(m_SslHandshakeWorkers) + "\n" +
+            "\tTCP no delay: " + std::to_string(m_TcpNoDelay) + ", cork: " + std::to_string(m_TcpCork) +
+                ", defer accept: " + std::to_string(m_TcpDeferAccept) + ", fast open: " + std::to_string(m_TcpFastOpen) + "\n" +
+            "\tsocket buffers: " + std::to_string(m_SocketReceiveBuffer) + "/" + std::to_string(m_SocketSendBuffer) + "\n" +
+            "\tTCP keepalive: " + std::to_string(m_TcpKeepAlive) + ", " + std::to_string(m_TcpKeepAliveIdle) + "/" +
+                std::to_string(m_TcpKeepAliveInterval) + "/" + std::to_string(m_TcpKeepAliveCount) + "\n" +
+            "\twrite watermarks: " + std::to_string(m_WriteHighWatermark) + "/" + std::to_string(m_WriteLowWatermark) + "\n" +
+            "\tmax pending input: " + std::to_string(m_MaxPendingInput) + "\n" +
+            "\tzero-copy threshold: " + std::to_string(m_ZeroCopyThreshold) + "\n" +
+            "\thandoff socket: " + m_HandoffSocket + ", drain timeout: " + std::to_string(m_HandoffDrainTimeout) + "\n" +
             "\tRoot : " + m_rootFolder + "\n";
 }
 
+SocketPool::SocketOptions HttpConfig::GetSocketOptions() const
+{
+    SocketPool::SocketOptions options;
+    options.noDelay = m_TcpNoDelay;
+    options.cork = m_TcpCork;
+    options.deferAccept = m_TcpDeferAccept;
+    options.fastOpen = m_TcpFastOpen;
+    options.receiveBuffer = m_SocketReceiveBuffer;
+    options.sendBuffer = m_SocketSendBuffer;
+    options.keepAlive = m_TcpKeepAlive;
+    options.keepAliveIdle = m_TcpKeepAliveIdle;
+    options.keepAliveInterval = m_TcpKeepAliveInterval;
+    options.keepAliveCount = m_TcpKeepAliveCount;
+    return options;
+}
+
 void HttpConfig::SetRootFolder()
 {
     std::string root = FileSystem::NormalizePath(GetRoot());
@@ -2,12 +2,13 @@
 #include "common_webcpp.h"
 #include "CommunicationTcpServer.h"
 #include "CommunicationSslServer.h"
+#include "CommunicationUnixServer.h"
 #include "LogWriter.h"
 #include "Lock.h"
 #include "FileSystem.h"
+#include "Platform.h"
 #include "StringUtil.h"
 #include "Request.h"
-#include "KeepAliveTimer.h"
 #include "Data.h"
 #include "HttpServer.h"
 #include "IHttp.h"
@@ -33,13 +34,39 @@ bool WebCpp::HttpServer::Init(const WebCpp::HttpConfig& config)
 
     m_protocol = m_config.GetHttpProtocol();
 
+    // the answer to the requests that the server can't take now is built once, it
+    // has to be cheap since it goes out exactly when the server is short of time
+    std::string overload = std::string("HTTP/1.1 503 ") + Response::ResponseCode2String(503) + CR + LF +
+            HttpHeader::HeaderType2String(HttpHeader::HeaderType::Server) + ": " + m_config.GetServerName() + CR + LF +
+            HttpHeader::HeaderType2String(HttpHeader::HeaderType::RetryAfter) + ": " + std::to_string(m_config.GetRetryAfter()) + CR + LF +
+            HttpHeader::HeaderType2String(HttpHeader::HeaderType::Connection) + ": close" + CR + LF +
+            HttpHeader::HeaderType2String(HttpHeader::HeaderType::ContentLength) + ": 0" + CR + LF + CR + LF;
+    m_overloadResponse = ByteArray(overload.begin(), overload.end());
+
+    // a local proxy may talk to the server over a Unix socket instead of the loopback
+    std::string unixSocket = m_config.GetHttpUnixSocket();
     switch(m_protocol)
     {
         case Http::Protocol::HTTP:
-            m_server = std::make_shared<CommunicationTcpServer>();
+            if(unixSocket.empty())
+            {
+                m_server = std::make_shared<CommunicationTcpServer>();
+            }
+            else
+            {
+                auto server = std::make_shared<CommunicationUnixServer>(FileSystem::NormalizePath(unixSocket, true));
+                server->SetPermissions(m_config.GetUnixSocketPermissions());
+                m_server = server;
+            }
             break;
 #ifdef WITH_OPENSSL
         case Http::Protocol::HTTPS:
+            if(unixSocket.empty() == false)
+            {
+                SetLastError("HTTPS on a Unix socket isn't supported");
+                LOG(GetLastError(), LogWriter::LogType::Error);
+                return false;
+            }
             m_server = std::make_shared<CommunicationSslServer>(
                         FileSystem::NormalizePath(m_config.GetSslSertificate(), true),
                         FileSystem::NormalizePath(m_config.GetSslKey(), true));
@@ -56,8 +83,46 @@ bool WebCpp::HttpServer::Init(const WebCpp::HttpConfig& config)
         return false;
     }
 
-    m_server->SetPort(m_config.GetHttpServerPort());
-    m_server->SetHost(m_config.GetHttpServerAddress());
+    if(unixSocket.empty())
+    {
+        m_server->SetPort(m_config.GetHttpServerPort());
+        m_server->SetHost(m_config.GetHttpServerAddress());
+    }
+    m_server->SetPollMethod(m_config.GetPollMethod());
+    m_server->SetReactorCount(m_config.GetReactorCount());
+    m_server->SetMaxConnections(m_config.GetMaxConnections());
+    m_server->SetListenBacklog(m_config.GetListenBacklog());
+    m_server->SetSocketOptions(m_config.GetSocketOptions());
+    m_server->SetHandshakeTimeout(m_config.GetSslHandshakeTimeout());
+    m_server->SetSslSessionCache(m_config.GetSslSessionCacheSize(), m_config.GetSslTicketKeyLifetime());
+    m_server->SetKtls(m_config.GetSslKtls());
+    m_server->SetHandshakeWorkers(m_config.GetSslHandshakeWorkers());
+    m_server->SetWriteWatermarks(m_config.GetWriteHighWatermark(), m_config.GetWriteLowWatermark());
+    m_server->SetZeroCopyThreshold(m_config.GetZeroCopyThreshold());
+
+    // the reactors are spread over their CPUs one by one, the request thread,
+    // the timers and the handshake workers share the worker CPUs
+    std::vector<int> reactorCpus, workerCpus;
+    if(ParseCpuList(m_config.GetReactorCpus(), reactorCpus) == false ||
+            ParseCpuList(m_config.GetWorkerCpus(), workerCpus) == false)
+    {
+        SetLastError("wrong CPU list");
+        LOG(GetLastError(), LogWriter::LogType::Error);
+        return false;
+    }
+    m_server->SetThreadName("http");
+    m_server->SetReactorCpus(reactorCpus);
+    m_server->SetWorkerCpus(workerCpus);
+    m_requestThread.SetName("http-req");
+    m_requestThread.SetAffinity(workerCpus);
+    m_timers.SetName("http-timer");
+    m_timers.SetAffinity(workerCpus);
+    m_workers.SetName("http-work");
+    m_workers.SetAffinity(workerCpus);
+    if(m_config.GetHandoffSocket().empty() == false)
+    {
+        m_server->SetHandoff(FileSystem::NormalizePath(m_config.GetHandoffSocket(), true), m_config.GetHandoffDrainTimeout());
+    }
 
     if(!m_server->Init())
     {
@@ -76,17 +141,31 @@ bool WebCpp::HttpServer::Init(const WebCpp::HttpConfig& config)
     m_server->SetDataReadyCallback(f2);
     auto f3 = std::bind(&HttpServer::OnClosed, this, std::placeholders::_1);
     m_server->SetCloseConnectionCallback(f3);
+    auto f4 = std::bind(&HttpServer::OnCongestion, this, std::placeholders::_1, std::placeholders::_2);
+    m_server->SetCongestionCallback(f4);
+    auto f5 = std::bind(&HttpServer::OnReadClosed, this, std::placeholders::_1);
+    m_server->SetReadClosedCallback(f5);
+
+    // without the workers the handlers are called by the request thread itself
+    if(m_config.GetRequestWorkers() > 0 && m_workers.Start(m_config.GetRequestWorkers()) == false)
+    {
+        SetLastError("failed to run the request workers: " + m_workers.GetLastError());
+        LOG(GetLastError(), LogWriter::LogType::Error);
+        return false;
+    }
 
     if(StartRequestThread() == false)
     {
         return false;
     }
 
-    if(m_config.GetKeepAliveTimeout() != 0)
+    auto f = std::bind(&HttpServer::OnTimer, this, std::placeholders::_1, std::placeholders::_2);
+    m_timers.SetCallback(f);
+    if(m_timers.Start() == false)
     {
-        auto f = std::bind(&HttpServer::ProcessKeepAlive, this, std::placeholders::_1);
-        KeepAliveTimer::SetCallback(f);
-        KeepAliveTimer::run();
+        SetLastError("failed to run the timers");
+        LOG(GetLastError(), LogWriter::LogType::Error);
+        return false;
     }
 
     return true;
@@ -111,8 +190,9 @@ bool HttpServer::Run()
 bool HttpServer::Close(bool wait)
 {
     m_server->Close(wait);
-    KeepAliveTimer::stop();
+    m_timers.Stop();
     StopRequestThread();
+    m_workers.Stop();
     return true;
 }
 
@@ -150,11 +230,43 @@ void HttpServer::SetPostRouteFunc(const RouteHttp::RouteFunc &callback)
     m_postRoute = callback;
 }
 
+void HttpServer::SetCongestionCallback(const std::function<void(int, bool)> &callback)
+{
+    m_congestionCallback = callback;
+}
+
+bool HttpServer::IsCongested(int connID) const
+{
+    return (m_server != nullptr && m_server->IsCongested(connID));
+}
+
+SocketPool::HandshakeStats HttpServer::GetHandshakeStats() const
+{
+    return (m_server != nullptr ? m_server->GetHandshakeStats() : SocketPool::HandshakeStats());
+}
+
+HttpServer::EvictionStats HttpServer::GetEvictionStats() const
+{
+    Lock lock(m_statsMutex);
+    return m_evictionStats;
+}
+
+HttpServer::ShedStats HttpServer::GetShedStats() const
+{
+    Lock lock(m_statsMutex);
+    return m_shedStats;
+}
+
 bool HttpServer::SendResponse(Response &response)
 {
     if(response.IsShouldSend())
     {
         response.AddHeader(HttpHeader::HeaderType::Date, FileSystem::GetDateTime());
+        if(m_server->IsDraining())
+        {
+            // the server is being replaced, the client reconnects to the new one
+            response.AddHeader(HttpHeader::HeaderType::Connection, "close");
+        }
         if(response.Send(m_server.get()) == false)
         {
             LOG("Error sending response: " + response.GetLastError(), LogWriter::LogType::Error);
@@ -173,17 +285,69 @@ void HttpServer::OnConnected(int connID, const std::string &remote)
 {
     LOG(std::string("client connected: #") + std::to_string(connID) + ", " + remote, LogWriter::LogType::Access);
     PutToQueue(connID, remote);
+    if(m_config.GetKeepAliveTimeout() > 0)
+    {
+        m_timers.SetTimer(connID, TimerType::KeepAlive, m_config.GetKeepAliveTimeout());
+    }
 }
 
 void HttpServer::OnDataReady(int connID, ByteArray &data)
 {
+    // the connection is idle since the last data received
+    if(m_config.GetKeepAliveTimeout() > 0)
+    {
+        m_timers.SetTimer(connID, TimerType::KeepAlive, m_config.GetKeepAliveTimeout());
+    }
     AppendData(connID, data);
     SendSignal();
 }
 
+void HttpServer::OnCongestion(int connID, bool congested)
+{
+    if(m_congestionCallback != nullptr)
+    {
+        m_congestionCallback(connID, congested);
+    }
+    if(congested == false)
+    {
+        // the requests held back by the congestion can be processed now
+        {
+            Lock lock(m_queueMutex);
+            RequestData *requestData = GetRequestData(connID);
+            if(requestData != nullptr)
+            {
+                SetIncoming(*requestData);
+            }
+        }
+        SendSignal();
+    }
+}
+
+void HttpServer::OnReadClosed(int connID)
+{
+    // the client sends nothing more, the requests it has sent are still
+    // answered and the connection is closed when the last response is out
+    {
+        Lock lock(m_queueMutex);
+        RequestData *req = GetRequestData(connID);
+        if(req == nullptr)
+        {
+            return;
+        }
+        req->readClosed = true;
+        SetIncoming(*req);
+    }
+    SendSignal();
+}
+
 void HttpServer::OnClosed(int connID)
 {    
     LOG(std::string("http connection closed: #") + std::to_string(connID), LogWriter::LogType::Access);
+    for(int type = TimerType::KeepAlive;type <= TimerType::WriteDeadline;type ++)
+    {
+        m_timers.CancelTimer(connID, type);
+    }
+    RemoveFromQueue(connID);
 }
 
 bool HttpServer::StartRequestThread()
@@ -204,8 +368,14 @@ bool HttpServer::StopRequestThread()
 {
     if(m_requestThread.IsRunning())
     {
-        m_requestThread.Stop();
-        SendSignal();
+        {
+            // the flag is dropped under the signal mutex, otherwise the thread could
+            // check it right before it starts waiting and never get the signal
+            Lock lock(m_signalMutex);
+            m_requestThread.StopNoWait();
+            m_signalCondition.Fire();
+        }
+        m_requestThread.Wait();
     }
     return true;
 }
@@ -217,10 +387,19 @@ void *HttpServer::RequestThread(bool &running)
         WaitForSignal();
         if(running)
         {
-            if(CheckDataFullness())
+            CheckDataFullness();
+            // a request of a connection that has the previous one still processed
+            // waits for it, so the responses go out in the order of the requests
+            bool pipelined = false;
+            std::unique_ptr<Request> request;
+            std::vector<int> shed;
+            while((request = GetNextRequest(pipelined, shed)) != nullptr)
+            {
+                DispatchRequest(std::move(request), pipelined);
+            }
+            if(shed.empty() == false)
             {
-                auto request = GetNextRequest();
-                ProcessRequest(*request);
+                ShedRequests(shed, true);
             }
         }
     }
@@ -228,108 +407,388 @@ void *HttpServer::RequestThread(bool &running)
     return nullptr;
 }
 
+void HttpServer::DispatchRequest(std::unique_ptr<Request> request, bool pipelined)
+{
+    if(m_workers.GetCount() == 0)
+    {
+        HandleRequest(*request, pipelined);
+        return;
+    }
+
+    std::shared_ptr<Request> shared(std::move(request));
+    if(m_workers.Post([this, shared, pipelined]()
+    {
+        // the request could wait for a free worker longer than its client would
+        int connID = shared->GetConnectionID();
+        if(IsQueueTimeOver(connID))
+        {
+            ShedRequests({ connID }, true);
+            FinishRequest(connID);
+            return;
+        }
+        HandleRequest(*shared, pipelined);
+    }) == false)
+    {
+        // the server is being closed
+        FinishRequest(shared->GetConnectionID());
+    }
+}
+
+void HttpServer::HandleRequest(Request &request, bool pipelined)
+{
+    // while the client has more requests pipelined the responses
+    // are collected and then sent together by the last one
+    int connID = request.GetConnectionID();
+    if(pipelined)
+    {
+        SetCorked(connID, true);
+    }
+    ProcessRequest(request);
+    // a congested connection gets what was collected right away,
+    // its next requests wait until the client reads the responses
+    if(pipelined == false || m_server->IsCongested(connID))
+    {
+        SetCorked(connID, false);
+    }
+    FinishRequest(connID);
+    // the next request of the connection may be waiting for this one
+    SendSignal();
+}
+
 void HttpServer::SendSignal()
 {
     Lock lock(m_signalMutex);
+    m_signaled = true;
     m_signalCondition.Fire();
 }
 
 void HttpServer::WaitForSignal()
 {
     Lock lock(m_signalMutex);
-    if(IsQueueEmpty() && m_requestThread.IsRunning())
+    if(m_signaled == false && m_requestThread.IsRunning())
     {
         m_signalCondition.Wait(m_signalMutex);
     }
+    m_signaled = false;
 }
 
 void HttpServer::PutToQueue(int connID, const std::string &remote)
 {
     Lock lock(m_queueMutex);
-    m_requestQueue.push_back(RequestData(connID, remote));
+    m_connections.emplace(connID, RequestData(connID, remote));
 }
 
-void HttpServer::AppendData(int connID, const ByteArray &data)
+void HttpServer::AppendData(int connID, ByteArray &data)
 {
+    bool shed = false;
     Lock lock(m_queueMutex);
 
-    for(auto &req: m_requestQueue)
+    RequestData *requestData = GetRequestData(connID);
+    // nothing is taken from a client that is answered 400
+    if(requestData != nullptr && requestData->rejected == false)
     {
-        if(req.connID == connID)
+        RequestData &req = *requestData;
+        // a new request is admitted only while the server keeps up with the ones it has
+        if(req.queued == false)
         {
-            req.data.insert(req.data.end(), data.begin(), data.end());
+            size_t limit = m_config.GetMaxQueuedRequests();
+            if(limit > 0 && m_queuedCount >= limit)
+            {
+                shed = true;
+            }
+            else
+            {
+                req.queued = true;
+                m_queuedCount ++;
+            }
+        }
+        if(shed == false)
+        {
+            if(req.data.empty())
+            {
+                req.data = std::move(data);
+            }
+            else
+            {
+                req.data.insert(req.data.end(), data.begin(), data.end());
+            }
+            req.received = std::chrono::steady_clock::now();
             if(req.request == nullptr)
             {
                 req.request.reset(new Request(req.connID, m_config, req.remote));
             }
-            break;
+            // the first bytes of a request start the time it has to send the header
+            if(req.deadline == TimerType::NoTimer)
+            {
+                SetDeadline(req, TimerType::HeaderDeadline, m_config.GetRequestHeaderTimeout());
+            }
+            SetIncoming(req);
+            UpdateReadPause(req);
         }
     }
-}
 
-bool HttpServer::IsQueueEmpty()
-{
-    Lock lock(m_queueMutex);
-    return m_requestQueue.empty();
+    if(shed)
+    {
+        lock.Unlock();
+        ShedRequests({ connID }, false);
+    }
 }
 
 bool HttpServer::CheckDataFullness()
 {
     Lock lock(m_queueMutex);
     bool retval = false;
+    std::vector<int> finished;
+    std::vector<int> rejected;
 
-    for(RequestData& requestData: m_requestQueue)
+    // only the connections that got something since they were parsed last time
+    // are checked, a congested one is checked again when the congestion is over
+    std::deque<int> incoming;
+    incoming.swap(m_incoming);
+    for(int connID: incoming)
     {
-        if(requestData.request != nullptr && requestData.data.size() > 0)
+        RequestData *data = GetRequestData(connID);
+        if(data == nullptr)
+        {
+            continue;
+        }
+        RequestData &requestData = *data;
+        requestData.incoming = false;
+        // looked at once, the congestion could be over in the meantime
+        bool congested = m_server->IsCongested(requestData.connID);
+        // a complete request waits for the previous one of the connection to be processed
+        if(requestData.request != nullptr && requestData.readyForDispatch == false &&
+                requestData.data.size() > 0 && congested == false)
         {
             if(requestData.request->Parse(requestData.data))
             {
                 size_t size = requestData.request->GetRequestSize();
                 if(requestData.data.size() >= size)
                 {
+                    if(requestData.data.size() > size && requestData.request->GetHeader().GetBodySize() > 0)
+                    {
+                        // the body is parsed again without the pipelined data that follows it
+                        requestData.request->Parse(ByteArray(requestData.data.begin(), requestData.data.begin() + size));
+                    }
                     requestData.readyForDispatch = true;
-                    requestData.data.clear();
+                    // the request is parsed only when the request thread is free,
+                    // it was complete when the data it was found in came
+                    requestData.completed = requestData.received;
+                    if(requestData.handling == false)
+                    {
+                        m_readyQueue.push_back(requestData.connID);
+                    }
+                    requestData.data.erase(requestData.data.begin(), requestData.data.begin() + size);
+                    // the next pipelined request is already under way if something is left
+                    SetDeadline(requestData, (requestData.data.empty() ? TimerType::NoTimer : TimerType::HeaderDeadline),
+                                m_config.GetRequestHeaderTimeout());
+                    UpdateReadPause(requestData);
                     retval = true;
-                    break;
+                    continue;
+                }
+                // the header is received, the body has its own deadline
+                if(requestData.deadline == TimerType::HeaderDeadline && requestData.request->GetHeader().IsComplete())
+                {
+                    SetDeadline(requestData, TimerType::BodyDeadline, m_config.GetRequestBodyTimeout());
                 }
+                // the header tells now how much the request takes
+                UpdateReadPause(requestData);
             }
-            else
+            else if(requestData.request->IsMalformed())
             {
+                // nothing that follows makes it a request, the client is answered
+                // 400 once the responses to its previous requests are produced
                 SetLastError("parsing error: " + requestData.request->GetLastError());
+                requestData.rejected = true;
+                requestData.data.clear();
             }
         }
+        if(requestData.rejected && requestData.handling == false)
+        {
+            rejected.push_back(requestData.connID);
+            continue;
+        }
+        // the client has shut down its side and has nothing more to be answered,
+        // the rest of its data is an incomplete request that will never be complete
+        if(requestData.readClosed && requestData.readyForDispatch == false &&
+                requestData.handling == false && congested == false)
+        {
+            finished.push_back(requestData.connID);
+        }
+    }
+
+    if(finished.empty() == false || rejected.empty() == false)
+    {
+        lock.Unlock();
+        for(int connID: finished)
+        {
+            CloseAfterSend(connID);
+            RemoveFromQueue(connID);
+        }
+        for(int connID: rejected)
+        {
+            Response response(connID, m_config);
+            response.SetResponseCode(400);
+            response.AddHeader(HttpHeader::HeaderType::Connection, "close");
+            response.AddHeader(HttpHeader::HeaderType::ContentLength, "0");
+            SendResponse(response);
+            CloseAfterSend(connID);
+            RemoveFromQueue(connID);
+        }
     }
 
     return retval;
 }
 
-std::unique_ptr<Request> HttpServer::GetNextRequest()
+std::unique_ptr<Request> HttpServer::GetNextRequest(bool &pipelined, std::vector<int> &shed)
 {
     Lock lock(m_queueMutex);
+    auto now = std::chrono::steady_clock::now();
+    auto budget = std::chrono::milliseconds(m_config.GetMaxQueueTime());
 
-    for (auto it = m_requestQueue.begin(); it != m_requestQueue.end(); ++it)
+    while(m_readyQueue.empty() == false)
     {
-        if(it->readyForDispatch == true)
+        int connID = m_readyQueue.front();
+        m_readyQueue.pop_front();
+        // the connection could be closed since it was put here
+        RequestData *requestData = GetRequestData(connID);
+        if(requestData == nullptr || requestData->readyForDispatch == false || requestData->handling)
+        {
+            continue;
+        }
+
+        RequestData &data = *requestData;
+        data.readyForDispatch = false;
+        // the client of a request waiting since it was complete would rather
+        // retry than wait for the response any longer. It is checked here
+        // since the responses to the previous requests are all produced by now
+        if(budget.count() > 0 && now - data.completed > budget)
+        {
+            shed.push_back(data.connID);
+            continue;
+        }
+        data.handling = true;
+        data.handledCompleted = data.completed;
+        if(m_config.GetHandlerTimeout() > 0)
+        {
+            m_timers.SetTimer(data.connID, TimerType::HandlerDeadline, m_config.GetHandlerTimeout());
+        }
+        std::unique_ptr<Request> request(std::move(data.request));
+
+        // the rest of the data is the next pipelined request
+        pipelined = false;
+        if(data.data.empty() == false)
         {
-            RequestData &data = (*it);
-            data.readyForDispatch = false;
-            return std::unique_ptr<Request>(std::move(it->request));
+            data.request.reset(new Request(data.connID, m_config, data.remote));
+            pipelined = (data.request->Parse(data.data) && data.data.size() >= data.request->GetRequestSize());
+            SetIncoming(data);
         }
+        UpdateReadPause(data);
+
+        return request;
     }
 
-    return nullptr; // should never be called
+    return nullptr;
+}
+
+// must be called with the queue mutex locked
+HttpServer::RequestData *HttpServer::GetRequestData(int connID)
+{
+    auto it = m_connections.find(connID);
+    return (it == m_connections.end() ? nullptr : &it->second);
+}
+
+// must be called with the queue mutex locked
+void HttpServer::SetIncoming(RequestData &requestData)
+{
+    if(requestData.incoming == false)
+    {
+        requestData.incoming = true;
+        m_incoming.push_back(requestData.connID);
+    }
+}
+
+// must be called with the queue mutex locked. The connection isn't read while it
+// has sent more than the limit or than the request being received takes, so a client
+// that pipelines a lot of requests or doesn't read the responses can't take the memory
+void HttpServer::UpdateReadPause(RequestData &requestData)
+{
+    size_t limit = m_config.GetMaxPendingInput();
+    if(limit == 0)
+    {
+        return;
+    }
+
+    if(requestData.request != nullptr)
+    {
+        limit = std::max(limit, requestData.request->GetRequestSize());
+    }
+    bool pause = (requestData.data.size() > limit);
+    if(pause != requestData.readPaused)
+    {
+        requestData.readPaused = pause;
+        if(pause)
+        {
+            m_server->PauseReading(requestData.connID);
+        }
+        else
+        {
+            m_server->ResumeReading(requestData.connID);
+        }
+    }
+}
+
+// must be called with the queue mutex locked
+void HttpServer::SetDeadline(RequestData &requestData, int type, int timeout)
+{
+    if(requestData.deadline != TimerType::NoTimer)
+    {
+        m_timers.CancelTimer(requestData.connID, requestData.deadline);
+        requestData.deadline = TimerType::NoTimer;
+    }
+    if(type != TimerType::NoTimer && timeout > 0)
+    {
+        m_timers.SetTimer(requestData.connID, type, timeout);
+        requestData.deadline = type;
+    }
+}
+
+void HttpServer::SetCorked(int connID, bool corked)
+{
+    {
+        Lock lock(m_queueMutex);
+        RequestData *req = GetRequestData(connID);
+        if(req == nullptr || req->corked == corked)
+        {
+            return;
+        }
+        req->corked = corked;
+    }
+
+    // not under the queue mutex, the uncorked data may relieve the
+    // congestion and the congestion callback takes the mutex
+    if(corked)
+    {
+        m_server->Cork(connID);
+    }
+    else
+    {
+        m_server->Uncork(connID);
+    }
 }
 
 void HttpServer::RemoveFromQueue(int connID)
 {
     Lock lock(m_queueMutex);
-    for (auto it = m_requestQueue.begin(); it != m_requestQueue.end(); ++it)
+    auto it = m_connections.find(connID);
+    if(it != m_connections.end())
     {
-        if(it->connID == connID)
+        // the connection may still be in the lists, it is skipped there
+        if(it->second.queued)
         {
-            m_requestQueue.erase(it);
-            break;
+            m_queuedCount --;
         }
+        m_connections.erase(it);
     }
 }
 
@@ -337,11 +796,6 @@ void HttpServer::ProcessRequest(Request &request)
 {
     bool processed = false;
 
-    if(m_config.GetKeepAliveTimeout() > 0)
-    {
-        KeepAliveTimer::SetTimer(m_config.GetKeepAliveTimeout(), request.GetConnectionID());
-    }
-
     Response response(request.GetConnectionID(), m_config);
 
     if(m_preRoute != nullptr)
@@ -384,12 +838,274 @@ void HttpServer::ProcessRequest(Request &request)
     LOG(request.GetUrl().GetPath() + (processed ? ", processed" : ", not processed"), LogWriter::LogType::Access);
 
     SendResponse(response);
+
+    // the client was told to reconnect to the server that replaces this one
+    if(m_server->IsDraining())
+    {
+        CloseAfterSend(request.GetConnectionID());
+        RemoveFromQueue(request.GetConnectionID());
+    }
+}
+
+void HttpServer::FinishRequest(int connID)
+{
+    m_timers.CancelTimer(connID, TimerType::HandlerDeadline);
+    {
+        Lock lock(m_queueMutex);
+        RequestData *req = GetRequestData(connID);
+        if(req == nullptr)
+        {
+            // the connection was evicted or closed while the request was processed
+            return;
+        }
+        req->handling = false;
+        // the next pipelined request was waiting for this one
+        if(req->readyForDispatch)
+        {
+            m_readyQueue.push_back(connID);
+        }
+        // the connection holds no request now unless the next one is pipelined
+        else if(req->queued && req->data.empty())
+        {
+            req->queued = false;
+            m_queuedCount --;
+        }
+        // a half-closed or rejected connection is closed once it has nothing more to answer
+        if((req->readClosed || req->rejected) && req->readyForDispatch == false)
+        {
+            SetIncoming(*req);
+        }
+    }
+
+    // the connection is idle from now on unless the response is still on its way
+    if(m_config.GetKeepAliveTimeout() > 0)
+    {
+        m_timers.SetTimer(connID, TimerType::KeepAlive, m_config.GetKeepAliveTimeout());
+    }
+    WatchOutput(connID);
+}
+
+void HttpServer::ShedRequests(const std::vector<int> &connections, bool queueTime)
+{
+    {
+        Lock lock(m_statsMutex);
+        if(queueTime)
+        {
+            m_shedStats.queueTime += connections.size();
+        }
+        else
+        {
+            m_shedStats.queueLimit += connections.size();
+        }
+    }
+
+    // the connection is closed since the rest of the request is unknown or
+    // is as old as this one, the routing is not run for any of them. The
+    // responses queued before the 503 still reach the client
+    struct iovec iov;
+    iov.iov_base = m_overloadResponse.data();
+    iov.iov_len = m_overloadResponse.size();
+    for(int connID: connections)
+    {
+        LOG(std::string("request shed: #") + std::to_string(connID) + (queueTime ? ", queue time" : ", queue limit"), LogWriter::LogType::Access);
+        m_server->Write(connID, &iov, 1);
+        CloseAfterSend(connID);
+        RemoveFromQueue(connID);
+    }
+}
+
+bool HttpServer::IsQueueTimeOver(int connID)
+{
+    auto budget = std::chrono::milliseconds(m_config.GetMaxQueueTime());
+    if(budget.count() <= 0)
+    {
+        return false;
+    }
+
+    Lock lock(m_queueMutex);
+    RequestData *req = GetRequestData(connID);
+    return (req != nullptr && std::chrono::steady_clock::now() - req->handledCompleted > budget);
+}
+
+// the reactor closes the connection once the client has taken what was
+// written to it, or when it doesn't take it during the write timeout
+void HttpServer::CloseAfterSend(int connID)
+{
+    int timeout = m_config.GetWriteTimeout();
+    m_server->CloseAfterSend(connID, (timeout > 0 ? timeout : CLOSE_AFTER_SEND_TIMEOUT));
 }
 
 void HttpServer::ProcessKeepAlive(int connID)
 {
+    // the connection isn't idle while a request is received or processed, these
+    // have their own deadlines, or while the client is still reading a response
+    bool busy = false;
+    {
+        Lock lock(m_queueMutex);
+        // the client sent something after the timer expired
+        if(m_timers.IsTimerSet(connID, TimerType::KeepAlive))
+        {
+            return;
+        }
+        RequestData *req = GetRequestData(connID);
+        if(req != nullptr)
+        {
+            busy = (req->handling || req->deadline != TimerType::NoTimer);
+        }
+    }
+    bool pending = false;
+    uint64_t sent;
+    if(busy == false && m_server->GetWriteProgress(connID, pending, sent) && pending)
+    {
+        busy = true;
+        WatchOutput(connID);
+    }
+
+    if(busy)
+    {
+        m_timers.SetTimer(connID, TimerType::KeepAlive, m_config.GetKeepAliveTimeout());
+        return;
+    }
 
     m_server->CloseConnection(connID);
     RemoveFromQueue(connID);
 }
 
+void HttpServer::ProcessDeadline(int connID, int type)
+{
+    bool pending = false;
+    uint64_t sent = 0;
+    if(type == TimerType::WriteDeadline && (m_server->GetWriteProgress(connID, pending, sent) == false || pending == false))
+    {
+        // the response is sent out
+        return;
+    }
+
+    bool expired = false;
+    bool respond = false;
+    {
+        Lock lock(m_queueMutex);
+        RequestData *requestData = GetRequestData(connID);
+        // the timer was set again, for the next request or since the client made
+        // progress, after it had expired and before this callback was called
+        if(requestData != nullptr && m_timers.IsTimerSet(connID, type) == false)
+        {
+            RequestData &req = *requestData;
+            switch(type)
+            {
+                case TimerType::HeaderDeadline:
+                case TimerType::BodyDeadline:
+                    if(req.deadline == type)
+                    {
+                        // a complete request can wait for the client to read the previous responses
+                        expired = (m_server->IsCongested(connID) == false);
+                        respond = (req.handling == false);
+                        if(expired == false)
+                        {
+                            m_timers.SetTimer(connID, type, (type == TimerType::HeaderDeadline ?
+                                                                 m_config.GetRequestHeaderTimeout() : m_config.GetRequestBodyTimeout()));
+                        }
+                    }
+                    break;
+                case TimerType::HandlerDeadline:
+                    expired = req.handling;
+                    break;
+                case TimerType::WriteDeadline:
+                    // the client has to take at least something during the timeout
+                    expired = (sent == req.writeProgress);
+                    if(expired == false)
+                    {
+                        req.writeProgress = sent;
+                        m_timers.SetTimer(connID, type, m_config.GetWriteTimeout());
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    if(expired == false)
+    {
+        return;
+    }
+
+    std::string phase;
+    {
+        Lock lock(m_statsMutex);
+        switch(type)
+        {
+            case TimerType::HeaderDeadline:
+                m_evictionStats.header ++;
+                phase = "header";
+                break;
+            case TimerType::BodyDeadline:
+                m_evictionStats.body ++;
+                phase = "body";
+                break;
+            case TimerType::HandlerDeadline:
+                m_evictionStats.handler ++;
+                phase = "handler";
+                break;
+            default:
+                m_evictionStats.write ++;
+                phase = "write";
+                break;
+        }
+    }
+    LOG(std::string("connection evicted: #") + std::to_string(connID) + ", " + phase + " timeout", LogWriter::LogType::Access);
+
+    if(respond)
+    {
+        Response response(connID, m_config);
+        response.SetResponseCode(408);
+        response.AddHeader(HttpHeader::HeaderType::Connection, "close");
+        response.AddHeader(HttpHeader::HeaderType::ContentLength, "0");
+        SendResponse(response);
+        // what is queued before the 408 still reaches the client
+        CloseAfterSend(connID);
+    }
+    else
+    {
+        m_server->CloseConnection(connID);
+    }
+    RemoveFromQueue(connID);
+}
+
+void HttpServer::WatchOutput(int connID)
+{
+    bool pending = false;
+    uint64_t sent = 0;
+    if(m_config.GetWriteTimeout() > 0 && m_timers.IsTimerSet(connID, TimerType::WriteDeadline) == false &&
+            m_server->GetWriteProgress(connID, pending, sent) && pending)
+    {
+        {
+            Lock lock(m_queueMutex);
+            RequestData *req = GetRequestData(connID);
+            if(req != nullptr)
+            {
+                req->writeProgress = sent;
+            }
+        }
+        m_timers.SetTimer(connID, TimerType::WriteDeadline, m_config.GetWriteTimeout());
+    }
+}
+
+void HttpServer::OnTimer(int connID, int type)
+{
+    switch(type)
+    {
+        case TimerType::KeepAlive:
+            ProcessKeepAlive(connID);
+            break;
+        case TimerType::HeaderDeadline:
+        case TimerType::BodyDeadline:
+        case TimerType::HandlerDeadline:
+        case TimerType::WriteDeadline:
+            ProcessDeadline(connID, type);
+            break;
+        default:
+            break;
+    }
+}
+
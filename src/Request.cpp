@@ -24,14 +24,20 @@ Request::Request(const HttpConfig &config):
 bool Request::Parse(const ByteArray &data)
 {
     ClearError();
+    m_malformed = false;
 
     if(m_requestLineLength == 0)
     {
-        if(ParseRequestLine(data, m_requestLineLength) == false)
+        // the line is looked for again when more data comes
+        size_t pos = SIZE_MAX;
+        if(ParseRequestLine(data, pos) == false)
         {
+            // the data isn't just incomplete if the line is all there
+            m_malformed = (pos != SIZE_MAX);
             SetLastError("Request: error parsing request line: " + GetLastError());
             return false;
         }
+        m_requestLineLength = pos;
     }
     if(m_header.IsComplete() == false)
     {
@@ -44,7 +50,8 @@ bool Request::Parse(const ByteArray &data)
 
     if(m_header.GetBodySize() > 0)
     {
-        return ParseBody(data, m_requestLineLength + EOL_LENGTH + m_header.GetHeaderSize() + ENTRY_DELIMITER_LENGTH);
+        m_malformed = (ParseBody(data, m_requestLineLength + EOL_LENGTH + m_header.GetHeaderSize() + ENTRY_DELIMITER_LENGTH) == false);
+        return (m_malformed == false);
     }
 
     return true;
@@ -180,6 +187,11 @@ Http::Protocol Request::GetProtocol() const
     return Http::Protocol::HTTP;
 }
 
+bool Request::IsMalformed() const
+{
+    return m_malformed;
+}
+
 size_t Request::GetRequestLineLength() const
 {
     return m_requestLineLength;
@@ -7,8 +7,6 @@
 #include "Data.h"
 #include "DebugPrint.h"
 
-#define WRITE_BIFFER_SIZE 1024
-
 
 using namespace WebCpp;
 
@@ -144,66 +142,79 @@ void Response::SetShouldSend(bool value)
 
 bool Response::Send(ICommunicationServer *communication)
 {
-    ByteArray header;
+    static const uint8_t delimiter[] = { CR, LF };
+
+    // a file goes with sendfile() to a plain socket or to a TLS one encrypted by the kernel,
+    // the socket is corked so that the header leaves in the same packet as the file beginning
+    bool zeroCopy = (!m_file.empty() && communication->IsSendFileSupported(m_connID));
+    // a large body is passed to the kernel by reference and left to the socket pool till it's sent
+    size_t threshold = m_config.GetZeroCopyThreshold();
+    bool zeroCopyBody = (m_file.empty() && threshold > 0 && m_body.size() >= threshold);
+    if(zeroCopy || zeroCopyBody)
+    {
+        communication->Cork(m_connID);
+    }
 
     const ByteArray &sl = BuildStatusLine();
-    header.insert(header.end(), sl.begin(), sl.end());
-
     const ByteArray &hdr = BuildHeaders();
-    header.insert(header.end(), hdr.begin(), hdr.end());
-    header.push_back(CR);
-    header.push_back(LF);
 
-    if(communication->Write(m_connID, header) == false)
+    // status line, headers and the body go out in one vectored write
+    struct iovec iov[4];
+    iov[0].iov_base = const_cast<uint8_t *>(sl.data());
+    iov[0].iov_len = sl.size();
+    iov[1].iov_base = const_cast<uint8_t *>(hdr.data());
+    iov[1].iov_len = hdr.size();
+    iov[2].iov_base = const_cast<uint8_t *>(delimiter);
+    iov[2].iov_len = sizeof(delimiter);
+    iov[3].iov_base = m_body.data();
+    iov[3].iov_len = ((m_file.empty() && zeroCopyBody == false) ? m_body.size() : 0);
+
+    bool retval = true;
+    if(communication->Write(m_connID, iov, (iov[3].iov_len > 0 ? 4 : 3)) == false)
+    {
+        SetLastError("error sending response: " + communication->GetLastError());
+        retval = false;
+    }
+    else if(!m_file.empty())
+    {
+        retval = SendFile(communication);
+    }
+    else if(zeroCopyBody && communication->WriteZeroCopy(m_connID, m_body) == false)
+    {
+        SetLastError("error sending response: " + communication->GetLastError());
+        retval = false;
+    }
+
+    if(zeroCopy || zeroCopyBody)
     {
-        SetLastError("error sending header: " + communication->GetLastError());
+        communication->Uncork(m_connID);
+    }
+
+    return retval;
+}
+
+bool Response::SendFile(ICommunicationServer *communication)
+{
+    if(FileSystem::IsFileExist(m_file) == false)
+    {
+        SetLastError("file " + m_file + " not exists");
         return false;
     }
 
-    if(!m_file.empty())
+    size_t size = FileSystem::GetFileSize(m_file);
+    File file(m_file, File::Mode::Read);
+    if(file.IsOpened() == false)
     {
-        ByteArray buffer(WRITE_BIFFER_SIZE);
-        if(FileSystem::IsFileExist(m_file))
-        {
-            size_t size = FileSystem::GetFileSize(m_file);
-            File file(m_file, File::Mode::Read);
-            if(file.IsOpened())
-            {
-                size_t pos = 0;
-                while(pos < size)
-                {
-                    ssize_t bytes = file.Read(reinterpret_cast<char *>(buffer.data()), WRITE_BIFFER_SIZE);
-                    if(bytes == ERROR)
-                    {
-                        break;
-                    }
-                    pos += bytes;
-                    if(communication->Write(m_connID, buffer, bytes) == false)
-                    {
-                        SetLastError("error sending file: " + communication->GetLastError());
-                        return false;
-                    }
-                }
-            }
-            else
-            {
-                SetLastError("file " + m_file + " failed to open");
-                return false;
-            }
-        }
-        else
-        {
-            SetLastError("file " + m_file + " not exists");
-            return false;
-        }
+        SetLastError("file " + m_file + " failed to open");
+        return false;
     }
-    else if(m_body.size() > 0)
+
+    // the rest of the file is sent by the reactor when the socket is writable,
+    // a TLS socket without kTLS reads it a record at a time as it drains
+    if(communication->SendFile(m_connID, file.Detach(), size) == false)
     {
-        if(communication->Write(m_connID, m_body) == false)
-        {
-            SetLastError("error sending body: " + communication->GetLastError());
-            return false;
-        }
+        SetLastError("error sending file: " + communication->GetLastError());
+        return false;
     }
 
     return true;
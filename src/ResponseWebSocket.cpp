@@ -108,9 +108,14 @@ bool ResponseWebSocket::Send(ICommunicationServer *communication) const
             response.insert(response.end(), buffer.begin(), buffer.end());
         }
 
-        response.insert(response.end(), m_data.begin(), m_data.end());
-
-        communication->Write(m_connID, response);
+        // the frame header and the payload are sent without copying the payload
+        struct iovec iov[2];
+        iov[0].iov_base = response.data();
+        iov[0].iov_len = response.size();
+        iov[1].iov_base = const_cast<uint8_t *>(m_data.data());
+        iov[1].iov_len = m_data.size();
+
+        communication->Write(m_connID, iov, (m_data.empty() ? 1 : 2));
 
         return true;
     }
@@ -3,8 +3,10 @@
 #include <cstring>
 #include "CommunicationTcpServer.h"
 #include "CommunicationSslServer.h"
+#include "CommunicationUnixServer.h"
 #include "LogWriter.h"
 #include "FileSystem.h"
+#include "Platform.h"
 #include "Lock.h"
 #include "Data.h"
 #include "common_ws.h"
@@ -37,13 +39,29 @@ bool WebSocketServer::Init(WebCpp::HttpConfig config)
     m_config = config;
 
     m_protocol = m_config.GetWsProtocol();
+    std::string unixSocket = m_config.GetWsUnixSocket();
     switch(m_protocol)
     {
         case Http::Protocol::WS:
-            m_server = std::make_shared<CommunicationTcpServer>();
+            if(unixSocket.empty())
+            {
+                m_server = std::make_shared<CommunicationTcpServer>();
+            }
+            else
+            {
+                auto server = std::make_shared<CommunicationUnixServer>(FileSystem::NormalizePath(unixSocket, true));
+                server->SetPermissions(m_config.GetUnixSocketPermissions());
+                m_server = server;
+            }
             break;
 #ifdef WITH_OPENSSL
         case Http::Protocol::WSS:
+            if(unixSocket.empty() == false)
+            {
+                SetLastError("WSS on a Unix socket isn't supported");
+                LOG(GetLastError(), LogWriter::LogType::Error);
+                return false;
+            }
             m_server = std::make_shared<CommunicationSslServer>(m_config.GetSslSertificate(), m_config.GetSslKey());
             break;
 #endif
@@ -58,7 +76,38 @@ bool WebSocketServer::Init(WebCpp::HttpConfig config)
         return false;
     }
 
-    m_server->SetPort(m_config.GetWsServerPort());
+    if(unixSocket.empty())
+    {
+        m_server->SetPort(m_config.GetWsServerPort());
+    }
+    m_server->SetPollMethod(m_config.GetPollMethod());
+    m_server->SetReactorCount(m_config.GetReactorCount());
+    m_server->SetMaxConnections(m_config.GetMaxConnections());
+    m_server->SetListenBacklog(m_config.GetListenBacklog());
+    m_server->SetSocketOptions(m_config.GetSocketOptions());
+    m_server->SetHandshakeTimeout(m_config.GetSslHandshakeTimeout());
+    m_server->SetSslSessionCache(m_config.GetSslSessionCacheSize(), m_config.GetSslTicketKeyLifetime());
+    m_server->SetKtls(m_config.GetSslKtls());
+    m_server->SetHandshakeWorkers(m_config.GetSslHandshakeWorkers());
+    m_server->SetWriteWatermarks(m_config.GetWriteHighWatermark(), m_config.GetWriteLowWatermark());
+
+    // the reactors are spread over their CPUs one by one, the request thread,
+    // the timers and the handshake workers share the worker CPUs
+    std::vector<int> reactorCpus, workerCpus;
+    if(ParseCpuList(m_config.GetReactorCpus(), reactorCpus) == false ||
+            ParseCpuList(m_config.GetWorkerCpus(), workerCpus) == false)
+    {
+        SetLastError("wrong CPU list");
+        LOG(GetLastError(), LogWriter::LogType::Error);
+        return false;
+    }
+    m_server->SetThreadName("ws");
+    m_server->SetReactorCpus(reactorCpus);
+    m_server->SetWorkerCpus(workerCpus);
+    m_requestThread.SetName("ws-req");
+    m_requestThread.SetAffinity(workerCpus);
+    m_timers.SetName("ws-timer");
+    m_timers.SetAffinity(workerCpus);
     if(!m_server->Init())
     {
         SetLastError("WebSocketServer init failed");
@@ -76,12 +125,26 @@ bool WebSocketServer::Init(WebCpp::HttpConfig config)
     m_server->SetDataReadyCallback(f2);
     auto f3 = std::bind(&WebSocketServer::OnClosed, this, std::placeholders::_1);
     m_server->SetCloseConnectionCallback(f3);
+    auto f4 = std::bind(&WebSocketServer::OnCongestion, this, std::placeholders::_1, std::placeholders::_2);
+    m_server->SetCongestionCallback(f4);
 
     if(StartRequestThread() == false)
     {
         return false;
     }
 
+    if(m_config.GetWsPingInterval() > 0)
+    {
+        auto f = std::bind(&WebSocketServer::OnTimer, this, std::placeholders::_1, std::placeholders::_2);
+        m_timers.SetCallback(f);
+        if(m_timers.Start() == false)
+        {
+            SetLastError("failed to run the timers");
+            LOG(GetLastError(), LogWriter::LogType::Error);
+            return false;
+        }
+    }
+
     return true;
 }
 
@@ -104,6 +167,7 @@ bool WebSocketServer::Run()
 bool WebSocketServer::Close(bool wait)
 {
     m_server->Close(wait);
+    m_timers.Stop();
     StopRequestThread();
     return true;
 }
@@ -158,6 +222,21 @@ bool WebSocketServer::SendResponse(const ResponseWebSocket &response)
     return false;
 }
 
+void WebSocketServer::SetCongestionCallback(const std::function<void(int, bool)> &callback)
+{
+    m_congestionCallback = callback;
+}
+
+bool WebSocketServer::IsCongested(int connID) const
+{
+    return (m_server != nullptr && m_server->IsCongested(connID));
+}
+
+SocketPool::HandshakeStats WebSocketServer::GetHandshakeStats() const
+{
+    return (m_server != nullptr ? m_server->GetHandshakeStats() : SocketPool::HandshakeStats());
+}
+
 Http::Protocol WebSocketServer::GetProtocol() const
 {
     return m_protocol;
@@ -176,13 +255,29 @@ void WebSocketServer::OnConnected(int connID, const std::string &remote)
 
 void WebSocketServer::OnDataReady(int connID, ByteArray &data)
 {
+    // any data from the client proves the connection is alive, the next ping is postponed
+    int interval = m_config.GetWsPingInterval();
+    if(interval > 0 && (m_timers.CancelTimer(connID, TimerType::PingTimeout) || m_timers.IsTimerSet(connID, TimerType::Ping)))
+    {
+        m_timers.SetTimer(connID, TimerType::Ping, interval);
+    }
     PutToQueue(connID, data);
     SendSignal();
 }
 
+void WebSocketServer::OnCongestion(int connID, bool congested)
+{
+    if(m_congestionCallback != nullptr)
+    {
+        m_congestionCallback(connID, congested);
+    }
+}
+
 void WebSocketServer::OnClosed(int connID)
 {
     LOG(std::string("websocket connection closed: #") + std::to_string(connID), LogWriter::LogType::Access);
+    m_timers.CancelTimer(connID, TimerType::Ping);
+    m_timers.CancelTimer(connID, TimerType::PingTimeout);
     RemoveFromQueue(connID);
 }
 
@@ -205,8 +300,13 @@ bool WebSocketServer::StopRequestThread()
 {
     if(m_requestThread.IsRunning())
     {
-        m_requestThread.Stop();
-        SendSignal();
+        {
+            // the flag is dropped under the signal mutex, otherwise the thread could
+            // check it right before it starts waiting and never get the signal
+            Lock lock(m_signalMutex);
+            m_requestThread.StopNoWait();
+            m_signalCondition.Fire();
+        }
         m_requestThread.Wait();
     }
     return true;
@@ -235,42 +335,59 @@ void WebSocketServer::SendSignal()
 void WebSocketServer::WaitForSignal()
 {
     Lock lock(m_signalMutex);
-    m_signalCondition.Wait(m_signalMutex);
+    // the data that came while the previous portion was processed is not missed
+    if(IsQueueEmpty() && m_requestThread.IsRunning())
+    {
+        m_signalCondition.Wait(m_signalMutex);
+    }
 }
 
 void WebSocketServer::PutToQueue(int connID, ByteArray &data)
 {
     Lock lock(m_queueMutex);
 
-    for(auto &req: m_requestQueue)
+    RequestData *req = GetRequestData(connID);
+    if(req != nullptr)
     {
-        if(req.connID == connID)
+        if(req->data.empty())
         {
-            req.data.insert(req.data.end(), data.begin(), data.end());
-            break;
+            req->data = std::move(data);
+        }
+        else
+        {
+            req->data.insert(req->data.end(), data.begin(), data.end());
         }
+        SetIncoming(*req);
     }
 }
 
 bool WebSocketServer::IsQueueEmpty()
 {
     Lock lock(m_queueMutex);
-    return m_requestQueue.empty();
+    return (m_incoming.empty() && m_readyQueue.empty());
 }
 
 void WebSocketServer::InitConnection(int connID, const std::string &remote)
 {
     Lock lock(m_queueMutex);
+    m_connections.emplace(connID, RequestData(connID, remote, m_config));
+}
+
+// must be called with the queue mutex locked
+WebSocketServer::RequestData *WebSocketServer::GetRequestData(int connID)
+{
+    auto it = m_connections.find(connID);
+    return (it == m_connections.end() ? nullptr : &it->second);
+}
 
-    for(auto &req: m_requestQueue)
+// must be called with the queue mutex locked
+void WebSocketServer::SetIncoming(RequestData &requestData)
+{
+    if(requestData.incoming == false)
     {
-        if(req.connID == connID)
-        {
-            return;
-        }
+        requestData.incoming = true;
+        m_incoming.push_back(requestData.connID);
     }
-
-    m_requestQueue.push_back(RequestData(connID, remote, m_config));
 }
 
 bool WebSocketServer::CheckData()
@@ -278,8 +395,18 @@ bool WebSocketServer::CheckData()
     bool retval = false;
     Lock lock(m_queueMutex);
 
-    for(RequestData& requestData: m_requestQueue)
+    // only the connections that got something since they were parsed last time
+    std::deque<int> incoming;
+    incoming.swap(m_incoming);
+    for(int connID: incoming)
     {
+        RequestData *data = GetRequestData(connID);
+        if(data == nullptr)
+        {
+            continue;
+        }
+        RequestData &requestData = *data;
+        requestData.incoming = false;
         if(requestData.readyForDispatch == false)
         {
             if(requestData.handshake == false)
@@ -294,6 +421,10 @@ bool WebSocketServer::CheckData()
                     retval |= frameParsed;
                 }
             }
+            if(requestData.readyForDispatch)
+            {
+                m_readyQueue.push_back(connID);
+            }
         }
     }
 
@@ -343,8 +474,16 @@ void WebSocketServer::ProcessRequests()
 {
     Lock lock(m_queueMutex);
 
-    for(auto &entry: m_requestQueue)
+    while(m_readyQueue.empty() == false)
     {
+        RequestData *data = GetRequestData(m_readyQueue.front());
+        m_readyQueue.pop_front();
+        // the connection could be closed since it was put here
+        if(data == nullptr)
+        {
+            continue;
+        }
+        RequestData &entry = *data;
         if(entry.readyForDispatch)
         {
             if(entry.handshake == false)
@@ -353,6 +492,15 @@ void WebSocketServer::ProcessRequests()
                 {
                     entry.handshake = true;
                     entry.readyForDispatch = false;
+                    // the client may have sent the first messages along with the header
+                    if(entry.data.empty() == false)
+                    {
+                        SetIncoming(entry);
+                    }
+                    if(m_config.GetWsPingInterval() > 0)
+                    {
+                        m_timers.SetTimer(entry.connID, TimerType::Ping, m_config.GetWsPingInterval());
+                    }
                 }
             }
             else
@@ -384,15 +532,8 @@ void WebSocketServer::ProcessRequests()
 void WebSocketServer::RemoveFromQueue(int connID)
 {
     Lock lock(m_queueMutex);
-
-    for (auto it = m_requestQueue.begin(); it != m_requestQueue.end(); ++it)
-    {
-        if(it->connID == connID)
-        {
-            m_requestQueue.erase(it);
-            break;
-        }
-    }
+    // the connection may still be in the lists, it is skipped there
+    m_connections.erase(connID);
 }
 
 bool WebSocketServer::ProcessRequest(Request &request)
@@ -508,4 +649,30 @@ RouteWebSocket *WebSocketServer::GetRoute(const std::string &path)
     return nullptr;
 }
 
+void WebSocketServer::OnTimer(int connID, int type)
+{
+    switch(type)
+    {
+        case TimerType::Ping:
+        {
+            // the client that doesn't answer until the next interval is gone.
+            // The timeout is set first, the answer can come before Send() returns
+            m_timers.SetTimer(connID, TimerType::PingTimeout, m_config.GetWsPingInterval());
+            ResponseWebSocket response(connID);
+            response.SetMessageType(MessageType::Ping);
+            if(response.Send(m_server.get()) == false)
+            {
+                m_timers.CancelTimer(connID, TimerType::PingTimeout);
+            }
+            break;
+        }
+        case TimerType::PingTimeout:
+            LOG(std::string("websocket ping timeout: #") + std::to_string(connID), LogWriter::LogType::Access);
+            m_server->CloseConnection(connID);
+            break;
+        default:
+            break;
+    }
+}
+
 #endif
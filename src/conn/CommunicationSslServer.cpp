@@ -25,9 +25,9 @@ CommunicationSslServer::CommunicationSslServer(const std::string &cert, const st
                          SocketPool::Type::Stream,
                          SocketPool::Options::ReuseAddr | SocketPool::Options::Ssl)
 {
-    m_sockets.SetSslCredentials(cert, key);
-    m_sockets.SetPort(DEFAULT_SSL_PORT);
-    m_sockets.SetHost(DEFAULT_SSL_HOST);
+    SetSslCredentials(cert, key);
+    SetPort(DEFAULT_SSL_PORT);
+    SetHost(DEFAULT_SSL_HOST);
 }
 
 bool CommunicationSslServer::Init()
@@ -7,6 +7,7 @@
 #include <cstring>
 #include <stdexcept>
 #include <iostream>
+#include <signal.h>
 #include "common_webcpp.h"
 #include "Lock.h"
 #include "DebugPrint.h"
@@ -25,8 +26,8 @@ CommunicationTcpServer::CommunicationTcpServer() noexcept:
                          SocketPool::Type::Stream,
                          SocketPool::Options::ReuseAddr)
 {
-    m_sockets.SetPort(DEFAULT_HTTP_PORT);
-    m_sockets.SetHost(DEFAULT_HTTP_HOST);
+    SetPort(DEFAULT_HTTP_PORT);
+    SetHost(DEFAULT_HTTP_HOST);
 }
 
 CommunicationTcpServer::~CommunicationTcpServer()
@@ -36,6 +37,10 @@ CommunicationTcpServer::~CommunicationTcpServer()
 
 bool CommunicationTcpServer::Init()
 {
+    // sendfile() has no MSG_NOSIGNAL, a file sent to a client
+    // that has reset the connection would raise SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+
     if(m_initialized == true)
     {
         SetLastError("already initialized");
@@ -0,0 +1,90 @@
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <cstring>
+#include <stdexcept>
+#include "common_webcpp.h"
+#include "DebugPrint.h"
+#include "CommunicationUnixServer.h"
+
+
+using namespace WebCpp;
+
+CommunicationUnixServer::CommunicationUnixServer(const std::string &path) noexcept:
+    ICommunicationServer(SocketPool::Domain::Local,
+                         SocketPool::Type::Stream,
+                         SocketPool::Options::None)
+{
+    SetHost(path);
+}
+
+CommunicationUnixServer::~CommunicationUnixServer()
+{
+    CommunicationUnixServer::Close();
+}
+
+void CommunicationUnixServer::SetPermissions(int permissions)
+{
+    m_permissions = permissions;
+}
+
+int CommunicationUnixServer::GetPermissions() const
+{
+    return m_permissions;
+}
+
+bool CommunicationUnixServer::Init()
+{
+    if(m_initialized == true)
+    {
+        SetLastError("already initialized");
+        return false;
+    }
+
+    m_initialized = ICommunicationServer::Init();
+    return m_initialized;
+}
+
+bool CommunicationUnixServer::Connect(const std::string &address, int port)
+{
+    ClearError();
+
+    if(m_initialized == false)
+    {
+        SetLastError("not initialized");
+        return false;
+    }
+
+    m_connected = ICommunicationServer::Connect(address, port);
+    if(m_connected == true)
+    {
+        m_boundPath = GetHost();
+        // who may connect is decided by the file permissions
+        if(m_permissions > 0 && chmod(m_boundPath.c_str(), static_cast<mode_t>(m_permissions)) == ERROR)
+        {
+            SetLastError(std::string("socket permissions error: ") + strerror(errno));
+            DebugPrint() << "CommunicationUnixServer::Connect error: " << GetLastError() << std::endl;
+            CloseConnections();
+            unlink(m_boundPath.c_str());
+            m_boundPath.clear();
+            m_connected = false;
+        }
+    }
+
+    return m_connected;
+}
+
+bool CommunicationUnixServer::Close(bool wait)
+{
+    bool retval = ICommunicationServer::Close(wait);
+    // the path goes on with the server that took the socket over
+    if(m_boundPath.empty() == false && IsDraining() == false)
+    {
+        // the next server can bind the path at once
+        unlink(m_boundPath.c_str());
+        m_boundPath.clear();
+    }
+
+    return retval;
+}
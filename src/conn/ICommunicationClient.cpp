@@ -95,7 +95,7 @@ bool ICommunicationClient::Connect(const std::string &host, int port)
 bool ICommunicationClient::CloseConnection()
 {
     bool retval = m_sockets.CloseSocket(0);
-    if(m_closeConnectionCallback != nullptr)
+    if(retval == true && m_closeConnectionCallback != nullptr)
     {
         m_closeConnectionCallback();
     }
@@ -236,6 +236,10 @@ void *ICommunicationClient::ReadThread(bool &running)
                 {
                     CloseConnection();
                 }
+                else if(m_sockets.IsWritable(0) && m_sockets.Flush(0) == false)
+                {
+                    CloseConnection();
+                }
                 else
                 {
                     auto readBytes = m_sockets.Read(m_readBuffer, BUFFER_SIZE);
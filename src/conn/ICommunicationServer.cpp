@@ -6,8 +6,10 @@
 #include <fcntl.h>
 #include <cstring>
 #include <stdexcept>
+#include <algorithm>
 #include "DebugPrint.h"
 #include "Lock.h"
+#include "Platform.h"
 #include "ICommunicationServer.h"
 
 
@@ -16,31 +18,201 @@ using namespace WebCpp;
 ICommunicationServer::ICommunicationServer(SocketPool::Domain domain,
                                            SocketPool::Type type,
                                            SocketPool::Options options):
-    m_sockets(MAX_CLIENTS + 1, SocketPool::Service::Server, domain, type, options)
+    m_domain(domain),
+    m_type(type),
+    m_options(options)
 {
 
 }
 
 void ICommunicationServer::SetPort(int port)
 {
-    m_sockets.SetPort(port);
+    m_port = port;
 }
 
 int ICommunicationServer::GetPort() const
 {
-    return m_sockets.GetPort();
+    return m_port;
 }
 
 void ICommunicationServer::SetHost(const std::string &host)
 {
-    m_sockets.SetHost(host);
+    m_host = host;
 }
 
 std::string ICommunicationServer::GetHost() const
 {
-    return m_sockets.GetHost();
+    return m_host;
 }
 
+void ICommunicationServer::SetPollMethod(SocketPool::PollMethod method)
+{
+    m_pollMethod = method;
+}
+
+SocketPool::PollMethod ICommunicationServer::GetPollMethod() const
+{
+    return m_pollMethod;
+}
+
+void ICommunicationServer::SetReactorCount(size_t count)
+{
+    m_reactorCount = (count == 0 ? DEFAULT_REACTOR_COUNT : count);
+}
+
+size_t ICommunicationServer::GetReactorCount() const
+{
+    return m_reactorCount;
+}
+
+void ICommunicationServer::SetMaxConnections(size_t count)
+{
+    m_maxConnections = (count == 0 ? DEFAULT_MAX_CONNECTIONS : count);
+}
+
+size_t ICommunicationServer::GetMaxConnections() const
+{
+    return m_maxConnections;
+}
+
+void ICommunicationServer::SetListenBacklog(int backlog)
+{
+    m_listenBacklog = (backlog <= 0 ? DEFAULT_LISTEN_BACKLOG : backlog);
+}
+
+int ICommunicationServer::GetListenBacklog() const
+{
+    return m_listenBacklog;
+}
+
+void ICommunicationServer::SetSocketOptions(const SocketPool::SocketOptions &options)
+{
+    m_socketOptions = options;
+}
+
+const SocketPool::SocketOptions &ICommunicationServer::GetSocketOptions() const
+{
+    return m_socketOptions;
+}
+
+void ICommunicationServer::SetHandshakeTimeout(int timeout)
+{
+    m_handshakeTimeout = timeout;
+}
+
+int ICommunicationServer::GetHandshakeTimeout() const
+{
+    return m_handshakeTimeout;
+}
+
+void ICommunicationServer::SetSslSessionCache(size_t size, int ticketKeyLifetime)
+{
+    m_sslSessionCacheSize = size;
+    m_sslTicketKeyLifetime = ticketKeyLifetime;
+}
+
+void ICommunicationServer::SetKtls(bool enable)
+{
+    m_ktls = enable;
+}
+
+bool ICommunicationServer::IsKtls() const
+{
+    return m_ktls;
+}
+
+void ICommunicationServer::SetHandshakeWorkers(size_t count)
+{
+    m_handshakeWorkers = count;
+}
+
+size_t ICommunicationServer::GetHandshakeWorkers() const
+{
+    return m_handshakeWorkers;
+}
+
+SocketPool::HandshakeStats ICommunicationServer::GetHandshakeStats() const
+{
+    SocketPool::HandshakeStats stats;
+    for(auto &reactor: m_reactors)
+    {
+        SocketPool::HandshakeStats reactorStats = reactor->sockets.GetHandshakeStats();
+        stats.full += reactorStats.full;
+        stats.resumed += reactorStats.resumed;
+        stats.failed += reactorStats.failed;
+        stats.timedOut += reactorStats.timedOut;
+        stats.ktls += reactorStats.ktls;
+        stats.totalTime += reactorStats.totalTime;
+        stats.maxTime = std::max(stats.maxTime, reactorStats.maxTime);
+    }
+
+    return stats;
+}
+
+void ICommunicationServer::SetWriteWatermarks(size_t high, size_t low)
+{
+    m_highWatermark = high;
+    m_lowWatermark = low;
+}
+
+void ICommunicationServer::SetZeroCopyThreshold(size_t threshold)
+{
+    m_zeroCopyThreshold = threshold;
+}
+
+size_t ICommunicationServer::GetZeroCopyThreshold() const
+{
+    return m_zeroCopyThreshold;
+}
+
+void ICommunicationServer::SetHandoff(const std::string &path, int drainTimeout)
+{
+    m_handoffPath = path;
+    m_drainTimeout = drainTimeout;
+}
+
+bool ICommunicationServer::IsDraining() const
+{
+    return m_draining;
+}
+
+void ICommunicationServer::SetThreadName(const std::string &name)
+{
+    m_threadName = name;
+}
+
+void ICommunicationServer::SetReactorCpus(const std::vector<int> &cpus)
+{
+    m_reactorCpus = cpus;
+}
+
+void ICommunicationServer::SetWorkerCpus(const std::vector<int> &cpus)
+{
+    m_workerCpus = cpus;
+}
+
+bool ICommunicationServer::IsCongested(int connID) const
+{
+    size_t index;
+    Reactor *reactor = FromConnID(connID, index);
+    return (reactor != nullptr && reactor->sockets.IsCongested(index));
+}
+
+bool ICommunicationServer::GetWriteProgress(int connID, bool &pending, uint64_t &sent) const
+{
+    size_t index;
+    Reactor *reactor = FromConnID(connID, index);
+    return (reactor != nullptr && reactor->sockets.GetWriteProgress(index, GenerationOf(connID), pending, sent));
+}
+
+#ifdef WITH_OPENSSL
+void ICommunicationServer::SetSslCredentials(const std::string &cert, const std::string &key)
+{
+    m_cert = cert;
+    m_key = key;
+}
+#endif
+
 bool ICommunicationServer::Init()
 {
     ClearError();
@@ -48,10 +220,70 @@ bool ICommunicationServer::Init()
 
     try
     {
-        if(m_sockets.Create(true) == ERROR)
+        SocketPool::Options options = m_options;
+        if(m_reactorCount > 1 && m_domain == SocketPool::Domain::Inet)
         {
-            SetLastError(std::string("server socket create error: ") + m_sockets.GetLastError());
-            throw std::runtime_error(GetLastError());
+            options = options | SocketPool::Options::ReusePort;
+        }
+
+        // every reactor gets its share of the connections plus the listening
+        // socket, limited by the room the connID has for the slot index
+        size_t capacity = (m_maxConnections + m_reactorCount - 1) / m_reactorCount + 1;
+        capacity = std::min(capacity, static_cast<size_t>(CONNID_INDEX_MASK + 1) / m_reactorCount);
+
+#ifdef WITH_OPENSSL
+        // one context for all the reactors, a client resumes its
+        // session whatever listener the kernel passes it to
+        std::shared_ptr<SslContext> sslContext;
+        if((options & SocketPool::Options::Ssl) == SocketPool::Options::Ssl)
+        {
+            sslContext = std::make_shared<SslContext>(SslContext::Service::Server);
+            sslContext->SetSessionCacheSize(m_sslSessionCacheSize);
+            sslContext->SetTicketKeyLifetime(m_sslTicketKeyLifetime);
+            sslContext->SetKtls(m_ktls);
+        }
+
+        // the pending tasks refer to the old reactors
+        m_handshakePool.reset();
+        if(sslContext != nullptr && m_handshakeWorkers > 0)
+        {
+            m_handshakePool.reset(new ThreadPool());
+            m_handshakePool->SetName(m_threadName + "-tls");
+            m_handshakePool->SetAffinity(m_workerCpus);
+            if(m_handshakePool->Start(m_handshakeWorkers) == false)
+            {
+                SetLastError(std::string("handshake pool start error: ") + m_handshakePool->GetLastError());
+                throw std::runtime_error(GetLastError());
+            }
+        }
+#endif
+
+        m_reactors.clear();
+        for(size_t i = 0;i < m_reactorCount;i ++)
+        {
+            std::unique_ptr<Reactor> reactor(new Reactor(i, capacity, m_domain, m_type, options));
+            SocketPool &sockets = reactor->sockets;
+            sockets.SetPort(m_port);
+            sockets.SetHost(m_host);
+            sockets.SetPollMethod(m_pollMethod);
+            sockets.SetListenBacklog(m_listenBacklog);
+            sockets.SetSocketOptions(m_socketOptions);
+            sockets.SetHandshakeTimeout(m_handshakeTimeout);
+            sockets.SetWriteWatermarks(m_highWatermark, m_lowWatermark);
+            sockets.SetZeroCopyThreshold(m_zeroCopyThreshold);
+            sockets.SetCongestionCallback(std::bind(&ICommunicationServer::OnCongestion, this, reactor.get(), std::placeholders::_1, std::placeholders::_2));
+#ifdef WITH_OPENSSL
+            sockets.SetSslCredentials(m_cert, m_key);
+            sockets.SetSslContext(sslContext);
+            sockets.SetHandshakePool(m_handshakePool.get());
+#endif
+            if(sockets.Create(true) == ERROR)
+            {
+                SetLastError(std::string("server socket create error: ") + sockets.GetLastError());
+                throw std::runtime_error(GetLastError());
+            }
+
+            m_reactors.push_back(std::move(reactor));
         }
 
         retval = true;
@@ -59,7 +291,7 @@ bool ICommunicationServer::Init()
 
     catch(...)
     {
-        CloseConnection(0);
+        CloseConnections();
         DebugPrint() << "CommunicationServer::Init error: " << GetLastError() << std::endl;
         retval = false;
     }
@@ -73,12 +305,22 @@ bool ICommunicationServer::Run()
 
     try
     {
-        auto f = std::bind(&ICommunicationServer::ReadThread, this, std::placeholders::_1);
-        m_readThread.SetFunction(f);
-        m_running = m_readThread.Start();
-        if(m_running == false)
+        m_running = (m_reactors.empty() == false);
+        for(auto &reactor: m_reactors)
         {
-            SetLastError(m_readThread.GetLastError());
+            auto f = std::bind(&ICommunicationServer::ReadThread, this, std::placeholders::_1, reactor.get());
+            reactor->thread.SetFunction(f);
+            reactor->thread.SetName(m_threadName + "-io" + std::to_string(reactor->index));
+            if(m_reactorCpus.empty() == false)
+            {
+                reactor->thread.SetAffinity({ m_reactorCpus[reactor->index % m_reactorCpus.size()] });
+            }
+            if(reactor->thread.Start() == false)
+            {
+                SetLastError(reactor->thread.GetLastError());
+                m_running = false;
+                break;
+            }
         }
     }
     catch(...)
@@ -91,7 +333,10 @@ bool ICommunicationServer::Run()
 
 bool ICommunicationServer::WaitFor()
 {
-    m_readThread.Wait();
+    for(auto &reactor: m_reactors)
+    {
+        reactor->thread.Wait();
+    }
     return true;
 }
 
@@ -101,24 +346,77 @@ bool ICommunicationServer::Connect(const std::string &host, int port)
 
     try
     {
-        if(m_sockets.Bind(host, port) == false)
+        if(port > 0)
         {
-            SetLastError(std::string("socket bind error: ") + m_sockets.GetLastError());
-            throw std::runtime_error(GetLastError());
+            m_port = port;
+        }
+        if(!host.empty())
+        {
+            m_host = host;
         }
 
-        if(m_sockets.Listen() == false)
+        // the server that runs now gives its sockets away if there is one
+        std::vector<int> inherited;
+        if(m_handoffPath.empty() == false && m_handoff.Receive(m_handoffPath, inherited) == false &&
+                m_handoff.GetLastErrorCode() == NO_ERROR)
+        {
+            DebugPrint() << "CommunicationServer::Connect handoff error: " << m_handoff.GetLastError() << std::endl;
+        }
+        if(inherited.empty() == false && InheritListeners(inherited) == false)
         {
-            SetLastError(std::string("socket listen error: ") + m_sockets.GetLastError());
             throw std::runtime_error(GetLastError());
         }
 
+        for(auto &reactor: m_reactors)
+        {
+            SocketPool &sockets = reactor->sockets;
+            if(inherited.empty() == false)
+            {
+                break;
+            }
+            if(m_domain == SocketPool::Domain::Local && reactor->index > 0)
+            {
+                // a path can't be bound twice, the reactors accept from the same socket
+                int fd = dup(m_reactors.front()->sockets.GetListenSocket());
+                if(fd == ERROR || sockets.SetListenSocket(fd) == false)
+                {
+                    SetLastError(std::string("socket share error: ") + (fd == ERROR ? strerror(errno) : sockets.GetLastError()));
+                    if(fd != ERROR)
+                    {
+                        close(fd);
+                    }
+                    throw std::runtime_error(GetLastError());
+                }
+                continue;
+            }
+
+            if(sockets.Bind(m_host, m_port) == false)
+            {
+                SetLastError(std::string("socket bind error: ") + sockets.GetLastError());
+                throw std::runtime_error(GetLastError());
+            }
+
+            if(sockets.Listen() == false)
+            {
+                SetLastError(std::string("socket listen error: ") + sockets.GetLastError());
+                throw std::runtime_error(GetLastError());
+            }
+        }
+
+        if(m_handoffPath.empty() == false &&
+                m_handoff.Serve(m_handoffPath, std::bind(&ICommunicationServer::GetListenSockets, this),
+                                std::bind(&ICommunicationServer::OnHandedOff, this)) == false)
+        {
+            // the server works as usual, it just can't be replaced smoothly
+            DebugPrint() << "CommunicationServer::Connect handoff error: " << m_handoff.GetLastError() << std::endl;
+        }
+
         return true;
     }
 
     catch(...)
     {
-        CloseConnection(0);
+        CloseConnections();
         DebugPrint() << "CommunicationServer::Connect error: " << GetLastError() << std::endl;
         return false;
     }
@@ -126,12 +424,20 @@ bool ICommunicationServer::Connect(const std::string &host, int port)
 
 bool ICommunicationServer::Close(bool wait)
 {
+    m_handoff.Close();
     if(m_running == true)
     {
         m_running = false;
-        if(wait)
+        for(auto &reactor: m_reactors)
         {
-            m_readThread.Wait();
+            if(wait)
+            {
+                reactor->thread.Stop();
+            }
+            else
+            {
+                reactor->thread.StopNoWait();
+            }
         }
 
         CloseConnections();
@@ -141,9 +447,17 @@ bool ICommunicationServer::Close(bool wait)
 }
 
 bool ICommunicationServer::CloseConnection(int connID)
-{   
-    bool retval = m_sockets.CloseSocket(connID);
-    if(m_closeConnectionCallback != nullptr)
+{
+    size_t index;
+    Reactor *reactor = FromConnID(connID, index);
+    if(reactor == nullptr)
+    {
+        return false;
+    }
+
+    // only the one who actually closed the socket reports it
+    bool retval = reactor->sockets.CloseSocket(index, GenerationOf(connID));
+    if(retval == true && m_closeConnectionCallback != nullptr)
     {
         m_closeConnectionCallback(connID);
     }
@@ -152,8 +466,113 @@ bool ICommunicationServer::CloseConnection(int connID)
 }
 
 void ICommunicationServer::CloseConnections()
-{  
-    m_sockets.CloseSockets();
+{
+    for(auto &reactor: m_reactors)
+    {
+        // the kernel lets the io_uring accept go some time after the socket
+        // is closed, the port would stay taken till then. The socket handed
+        // off to the next server is still listening there
+        int fd = reactor->sockets.GetListenSocket();
+        if(fd != (-1) && m_draining == false)
+        {
+            shutdown(fd, SHUT_RDWR);
+        }
+        reactor->sockets.CloseSockets();
+    }
+}
+
+bool ICommunicationServer::CloseAfterSend(int connID, int timeout)
+{
+    size_t index;
+    Reactor *reactor = FromConnID(connID, index);
+    return (reactor != nullptr && reactor->sockets.CloseAfterSend(index, GenerationOf(connID), timeout));
+}
+
+bool ICommunicationServer::InheritListeners(std::vector<int> &sockets)
+{
+    // the reactors take the sockets in the order the old server had them. The extra
+    // ones are closed, the clients queued in them are lost, so it's better to keep the
+    // same count of the reactors
+    bool retval = true;
+    for(size_t i = 0;i < m_reactors.size();i ++)
+    {
+        SocketPool &reactorSockets = m_reactors[i]->sockets;
+        int fd = (i < sockets.size() ? sockets[i] : dup(sockets[i % sockets.size()]));
+        if(retval == true && (fd == ERROR || reactorSockets.SetListenSocket(fd) == false))
+        {
+            SetLastError(std::string("socket inherit error: ") + (fd == ERROR ? strerror(errno) : reactorSockets.GetLastError()));
+            retval = false;
+        }
+        if(retval == false && fd != ERROR)
+        {
+            close(fd);
+        }
+    }
+    for(size_t i = m_reactors.size();i < sockets.size();i ++)
+    {
+        close(sockets[i]);
+    }
+
+    return retval;
+}
+
+std::vector<int> ICommunicationServer::GetListenSockets() const
+{
+    std::vector<int> sockets;
+    for(auto &reactor: m_reactors)
+    {
+        int fd = reactor->sockets.GetListenSocket();
+        if(fd != (-1))
+        {
+            sockets.push_back(fd);
+        }
+    }
+
+    return sockets;
+}
+
+void ICommunicationServer::OnHandedOff()
+{
+    DebugPrint() << "CommunicationServer: the listening sockets are handed off, draining" << std::endl;
+    m_drainDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_drainTimeout);
+    m_draining = true;
+    for(auto &reactor: m_reactors)
+    {
+        reactor->sockets.Interrupt();
+    }
+}
+
+int ICommunicationServer::ToConnID(const Reactor *reactor, size_t index) const
+{
+    // the slot generation is a part of the ID so the ID of a closed
+    // connection doesn't match the connection that reuses its slot
+    int generation = static_cast<int>(reactor->sockets.GetGeneration(index));
+    int slot = static_cast<int>(index * m_reactors.size() + reactor->index);
+    return (generation << CONNID_INDEX_BITS) | slot;
+}
+
+ICommunicationServer::Reactor *ICommunicationServer::FromConnID(int connID, size_t &index) const
+{
+    size_t count = m_reactors.size();
+    if(connID < 0 || count == 0)
+    {
+        return nullptr;
+    }
+
+    size_t slot = static_cast<size_t>(connID & CONNID_INDEX_MASK);
+    Reactor *reactor = m_reactors[slot % count].get();
+    index = slot / count;
+    if(reactor->sockets.GetGeneration(index) != GenerationOf(connID))
+    {
+        return nullptr;
+    }
+
+    return reactor;
+}
+
+uint32_t ICommunicationServer::GenerationOf(int connID)
+{
+    return static_cast<uint32_t>(connID >> CONNID_INDEX_BITS) & GENERATION_MASK;
 }
 
 bool ICommunicationServer::Write(int connID, ByteArray &data)
@@ -163,85 +582,259 @@ bool ICommunicationServer::Write(int connID, ByteArray &data)
 
 bool ICommunicationServer::Write(int connID, ByteArray &data, size_t size)
 {
-    ClearError();
+    struct iovec iov;
+    iov.iov_base = data.data();
+    iov.iov_len = size;
+    return Write(connID, &iov, 1);
+}
 
+bool ICommunicationServer::Write(int connID, const iovec *iov, size_t count)
+{
+    // writes to different connections run in parallel, the order
+    // of the writes to the same connection is kept by its slot lock
     if(m_initialized == false || m_connected == false)
     {
-        SetLastError("not initialized or not connected");
+        SetSharedError("not initialized or not connected");
+        return false;
+    }
+
+    size_t index;
+    Reactor *reactor = FromConnID(connID, index);
+    if(reactor == nullptr)
+    {
+        SetSharedError("wrong connection");
         return false;
     }
 
     bool retval = false;
-    Lock lock(m_writeMutex);
+    size_t size = 0;
+    for(size_t i = 0;i < count;i ++)
+    {
+        size += iov[i].iov_len;
+    }
 
     try
     {
-        auto pos = m_sockets.Write(data.data(), size, connID);
+        auto pos = reactor->sockets.Write(iov, count, index, GenerationOf(connID));
         retval = (pos == size);
         if(retval == false)
         {
-            SetLastError("send " + std::to_string(pos) + " of " + std::to_string(size) + " bytes");
+            SetSharedError("send " + std::to_string(pos) + " of " + std::to_string(size) + " bytes");
         }
     }
     catch(const std::exception &ex)
     {
-        SetLastError(std::string("CommunicationServer::Write() exception: ") + ex.what());
+        SetSharedError(std::string("CommunicationServer::Write() exception: ") + ex.what());
         retval = false;
     }
 
     return retval;
 }
 
-void *ICommunicationServer::ReadThread(bool &running)
+bool ICommunicationServer::SendFile(int connID, int file, size_t size)
 {
-    int retval = (-1);
+    if(m_initialized == false || m_connected == false)
+    {
+        close(file);
+        SetSharedError("not initialized or not connected");
+        return false;
+    }
+
+    size_t index;
+    Reactor *reactor = FromConnID(connID, index);
+    if(reactor == nullptr)
+    {
+        close(file);
+        SetSharedError("wrong connection");
+        return false;
+    }
+
+    // the socket pool owns the file descriptor from now on
+    if(reactor->sockets.SendFile(file, 0, size, index, GenerationOf(connID)) != size)
+    {
+        SetSharedError("sendfile failed: " + reactor->sockets.GetSharedError());
+        return false;
+    }
+
+    return true;
+}
+
+bool ICommunicationServer::WriteZeroCopy(int connID, ByteArray &data)
+{
+    if(m_initialized == false || m_connected == false)
+    {
+        SetSharedError("not initialized or not connected");
+        return false;
+    }
+
+    size_t index;
+    Reactor *reactor = FromConnID(connID, index);
+    if(reactor == nullptr)
+    {
+        SetSharedError("wrong connection");
+        return false;
+    }
+
+    // the socket pool takes the data over if it's sent without copying
+    size_t size = data.size();
+    if(reactor->sockets.WriteZeroCopy(data, index, GenerationOf(connID)) != size)
+    {
+        SetSharedError("zero-copy write failed: " + reactor->sockets.GetSharedError());
+        return false;
+    }
+
+    return true;
+}
+
+bool ICommunicationServer::IsSendFileSupported(int connID) const
+{
+    size_t index;
+    Reactor *reactor = FromConnID(connID, index);
+    return (reactor != nullptr && reactor->sockets.IsSendFileSupported(index, GenerationOf(connID)));
+}
+
+bool ICommunicationServer::Cork(int connID)
+{
+    size_t index;
+    Reactor *reactor = FromConnID(connID, index);
+    return (reactor != nullptr && reactor->sockets.Cork(index, GenerationOf(connID)));
+}
+
+bool ICommunicationServer::Uncork(int connID)
+{
+    size_t index;
+    Reactor *reactor = FromConnID(connID, index);
+    return (reactor != nullptr && reactor->sockets.Uncork(index, GenerationOf(connID)));
+}
+
+bool ICommunicationServer::PauseReading(int connID)
+{
+    size_t index;
+    Reactor *reactor = FromConnID(connID, index);
+    return (reactor != nullptr && reactor->sockets.PauseReading(index, GenerationOf(connID)));
+}
+
+bool ICommunicationServer::ResumeReading(int connID)
+{
+    size_t index;
+    Reactor *reactor = FromConnID(connID, index);
+    return (reactor != nullptr && reactor->sockets.ResumeReading(index, GenerationOf(connID)));
+}
+
+void ICommunicationServer::SetSharedError(const std::string &error)
+{
+    Lock lock(m_errorMutex);
+    SetLastError(error);
+}
+
+void *ICommunicationServer::ReadThread(bool &running, Reactor *reactor)
+{
+    SocketPool &sockets = reactor->sockets;
+
+    // the connection slots and the read buffers are allocated by the reactor
+    // thread when it needs them, keep them on the node of its CPU
+    if(m_reactorCpus.empty() == false)
+    {
+        SetPreferredNode(GetCpuNode(m_reactorCpus[reactor->index % m_reactorCpus.size()]));
+    }
 
     try
     {
-        m_sockets.SetPollRead();
+        sockets.SetPollRead();
         while(running)
         {
-            if(m_sockets.Poll())
+            if(sockets.Poll())
             {
-                for (int i = 0; i < m_sockets.GetCount(); i++)
+                // epoll works in edge-triggered mode, so both accept
+                // and read are repeated until there is nothing left
+                for(size_t i: sockets.GetReadyList())
                 {
-                    if(m_sockets.IsPollError(i))
+                    if(sockets.IsPollError(i))
+                    {
+                        CloseConnection(ToConnID(reactor, i));
+                        continue;
+                    }
+                    if(i != 0 && sockets.IsWritable(i))
                     {
-                        CloseConnection(i);
+                        // the socket can take some more of the queued data
+                        if(sockets.Flush(i) == false)
+                        {
+                            CloseConnection(ToConnID(reactor, i));
+                            continue;
+                        }
                     }
-                    else if(m_sockets.HasData(i))
+                    if(sockets.HasData(i))
                     {
                         if (i == 0) // new client connected
                         {
-                            int id = m_sockets.Accept();
-                            if(id != ERROR)
+                            int id;
+                            SocketPool::AcceptStatus status;
+                            while((id = sockets.Accept(status)) != ERROR || status == SocketPool::AcceptStatus::Dropped)
                             {
-                                if(m_newConnectionCallback != nullptr)
+                                // only this client was dropped, e.g. since the table is full
+                                if(id != ERROR && m_newConnectionCallback != nullptr)
                                 {
-                                    m_newConnectionCallback(id, m_sockets.GetRemoteAddress(id));
+                                    m_newConnectionCallback(ToConnID(reactor, id), sockets.GetRemoteAddress(id));
                                 }
                             }
                         }
                         else // existing socket data received
                         {
-                            auto readBytes = m_sockets.Read(m_readBuffer, READ_BUFFER_SIZE, i);
-                            if(readBytes != ERROR)
+                            // all the data the socket has is read at once
+                            // into the buffer that is passed to the callback
+                            ByteArray data;
+                            bool closed = false;
+                            size_t readBytes = sockets.Read(data, i, closed);
+                            if(data.empty() == false && m_dataReadyCallback != nullptr)
                             {
-                                if(m_dataReadyCallback != nullptr)
-                                {
-                                    ByteArray data;
-                                    data.insert(data.end(), m_readBuffer, m_readBuffer + readBytes);
-                                    m_dataReadyCallback(i, data);
-                                }
+                                m_dataReadyCallback(ToConnID(reactor, i), data);
+                            }
+                            if(readBytes == static_cast<size_t>(ERROR))
+                            {
+                                CloseConnection(ToConnID(reactor, i));
                             }
-                            else
+                            else if(closed)
                             {
-                                CloseConnection(i);
+                                // the peer sends nothing more but may wait for what it has asked for
+                                if(m_readClosedCallback != nullptr)
+                                {
+                                    m_readClosedCallback(ToConnID(reactor, i));
+                                }
+                                else
+                                {
+                                    CloseAfterSend(ToConnID(reactor, i));
+                                }
                             }
                         }
                     }
                 }
             }
+
+            // the TLS clients that didn't complete the handshake in time
+            for(size_t i: sockets.GetExpiredHandshakes())
+            {
+                CloseConnection(ToConnID(reactor, i));
+            }
+
+            // the connections that were to be closed once their responses are sent
+            for(size_t i: sockets.GetDrainedSockets())
+            {
+                CloseConnection(ToConnID(reactor, i));
+            }
+
+            // the listening socket belongs to the next server now,
+            // the connections in progress are served to the end
+            if(m_draining)
+            {
+                if(sockets.GetListenSocket() != (-1))
+                {
+                    sockets.CloseSocket(0);
+                }
+                if(sockets.GetCount() == 0 || std::chrono::steady_clock::now() >= m_drainDeadline)
+                {
+                    break;
+                }
+            }
         }
     }
     catch(...)
@@ -251,3 +844,11 @@ void *ICommunicationServer::ReadThread(bool &running)
 
     return nullptr;
 }
+
+void ICommunicationServer::OnCongestion(Reactor *reactor, size_t index, bool congested)
+{
+    if(m_congestionCallback != nullptr)
+    {
+        m_congestionCallback(ToConnID(reactor, index), congested);
+    }
+}
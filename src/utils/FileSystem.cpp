@@ -180,10 +180,10 @@ std::vector<FileSystem::FileInfo> FileSystem::GetFolder(const std::string &path)
             if(stat(std::string(NormalizePath(path) + diread->d_name).c_str(), &info) == 0)
             {
                 auto mod_time = info.st_mtime;
-                const time_t *t = &mod_time;
-                struct tm * timeinfo = gmtime(t);
+                struct tm timeinfo;
+                gmtime_r(&mod_time, &timeinfo);
                 char buffer[30];
-                strftime(buffer, 30, "%a, %d %b %Y %H:%M:%S GMT", timeinfo);
+                strftime(buffer, 30, "%a, %d %b %Y %H:%M:%S GMT", &timeinfo);
                 mod = buffer;
                 size = info.st_size;
             }
@@ -299,13 +299,13 @@ bool FileSystem::DeleteFolder(const std::string &path)
 std::string FileSystem::GetDateTime()
 {
     time_t tm;
-    struct tm * timeinfo;
+    struct tm timeinfo;
     char buffer[30];
 
+    // the handlers may run in several threads, gmtime() shares its result
     time(&tm);
-    const time_t *t = &tm;
-    timeinfo = gmtime(t);
-    strftime(buffer, 30, "%a, %d %b %Y %H:%M:%S GMT", timeinfo);
+    gmtime_r(&tm, &timeinfo);
+    strftime(buffer, 30, "%a, %d %b %Y %H:%M:%S GMT", &timeinfo);
     return buffer;
 }
 
@@ -315,10 +315,10 @@ std::string FileSystem::GetFileModifiedTime(const std::string &file)
     if(stat(file.c_str(), &result) == 0)
     {
         auto mod_time = result.st_mtime;
-        const time_t *t = &mod_time;
-        struct tm * timeinfo = gmtime(t);
+        struct tm timeinfo;
+        gmtime_r(&mod_time, &timeinfo);
         char buffer[30];
-        strftime(buffer, 30, "%a, %d %b %Y %H:%M:%S GMT", timeinfo);
+        strftime(buffer, 30, "%a, %d %b %Y %H:%M:%S GMT", &timeinfo);
         return buffer;
     }
 
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <cstring>
 #include "DebugPrint.h"
+#include "Lock.h"
 
 #define DEFAULT_FOLDER "/var/log/webcpp"
 
@@ -21,6 +22,7 @@ LogWriter& LogWriter::Instance()
 void LogWriter::Write(const std::string &text, LogWriter::LogType type)
 {
     std::string s = "[" + WebCpp::FileSystem::GetDateTime() + "] " + text;
+    WebCpp::Lock lock(m_mutex);
     auto &stream = m_streams[static_cast<int>(type)];
     if(stream.is_open())
     {
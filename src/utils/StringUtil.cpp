@@ -15,10 +15,15 @@ size_t StringUtil::SearchPosition(const ByteArray &str, const ByteArray&substrin
     const uint8_t* pstr = str.data();
     const uint8_t* psubstring = substring.data();
     size_t substringLen = substring.size();
-    if(end == SIZE_MAX)
+    if(end == SIZE_MAX || end >= str.size())
     {
         end = str.size() - 1;
     }
+    // a piece shorter than the substring, e.g. the beginning of a request line
+    if(start > end || end - start + 1 < substringLen)
+    {
+        return SIZE_MAX;
+    }
 
     for(size_t pos1 = start;pos1 <= end - substringLen + 1; pos1++)
     {
@@ -0,0 +1,225 @@
+#include "Lock.h"
+#include "TimingWheel.h"
+#include "Platform.h"
+
+#define TIMING_WHEEL_MAX_TICKS ((1ULL << (TIMING_WHEEL_SLOT_BITS * TIMING_WHEEL_LEVELS)) - 1)
+
+
+using namespace WebCpp;
+
+TimingWheel::TimingWheel(uint32_t tick):
+    m_tick(tick > 0 ? tick : TIMING_WHEEL_TICK),
+    m_start(std::chrono::steady_clock::now())
+{
+}
+
+TimingWheel::~TimingWheel()
+{
+    Stop();
+}
+
+void TimingWheel::SetName(const std::string &name)
+{
+    m_task.SetName(name);
+}
+
+void TimingWheel::SetAffinity(const std::vector<int> &cpus)
+{
+    m_task.SetAffinity(cpus);
+}
+
+bool TimingWheel::Start()
+{
+    if(m_task.IsRunning())
+    {
+        return true;
+    }
+
+    auto f = std::bind(&TimingWheel::Task, this, std::placeholders::_1);
+    m_task.SetFunction(f);
+    return m_task.Start();
+}
+
+void TimingWheel::Stop()
+{
+    m_task.Stop();
+}
+
+void TimingWheel::SetCallback(const std::function<void (int, int)> &callback)
+{
+    m_callback = callback;
+}
+
+void TimingWheel::SetTimer(int id, int type, uint32_t delay)
+{
+    Lock lock(m_mutex);
+
+    uint64_t key = MakeKey(id, type);
+    auto it = m_timers.find(key);
+    if(it == m_timers.end())
+    {
+        it = m_timers.emplace(key, Timer()).first;
+    }
+    else
+    {
+        Unlink(&it->second);
+    }
+
+    Timer &timer = it->second;
+    timer.key = key;
+    // a timer fires not earlier than requested
+    uint64_t ticks = (delay + m_tick - 1) / m_tick;
+    timer.expires = m_ticks + (ticks > 0 ? ticks : 1);
+    Insert(&timer);
+}
+
+bool TimingWheel::CancelTimer(int id, int type)
+{
+    Lock lock(m_mutex);
+
+    auto it = m_timers.find(MakeKey(id, type));
+    if(it == m_timers.end())
+    {
+        return false;
+    }
+
+    Unlink(&it->second);
+    m_timers.erase(it);
+    return true;
+}
+
+bool TimingWheel::IsTimerSet(int id, int type) const
+{
+    Lock lock(m_mutex);
+    return (m_timers.find(MakeKey(id, type)) != m_timers.end());
+}
+
+size_t TimingWheel::GetCount() const
+{
+    Lock lock(m_mutex);
+    return m_timers.size();
+}
+
+void *TimingWheel::Task(bool &running)
+{
+    std::vector<uint64_t> expired;
+
+    while(running)
+    {
+        {
+            Lock lock(m_mutex);
+            // the wheel is turned by the clock, not by the count of the wakeups,
+            // so a late wakeup doesn't delay the timers
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start).count();
+            uint64_t now = static_cast<uint64_t>(elapsed) / m_tick;
+            while(m_ticks < now)
+            {
+                Advance(expired);
+            }
+        }
+
+        // the callbacks are called unlocked since they usually set or cancel other timers
+        for(uint64_t key: expired)
+        {
+            if(m_callback != nullptr)
+            {
+                m_callback(static_cast<int>(key >> 32), static_cast<int>(key & 0xFFFFFFFF));
+            }
+        }
+        expired.clear();
+
+        WebCpp::SleepMs(m_tick);
+    }
+
+    return nullptr;
+}
+
+uint64_t TimingWheel::MakeKey(int id, int type)
+{
+    return (static_cast<uint64_t>(static_cast<uint32_t>(id)) << 32) | static_cast<uint32_t>(type);
+}
+
+// must be called with the mutex locked
+void TimingWheel::Insert(Timer *timer)
+{
+    uint64_t delta = (timer->expires > m_ticks ? timer->expires - m_ticks : 0);
+    if(delta > TIMING_WHEEL_MAX_TICKS)
+    {
+        delta = TIMING_WHEEL_MAX_TICKS;
+        timer->expires = m_ticks + delta;
+    }
+
+    // the level is the lowest one whose turn covers the delay
+    size_t level = 0;
+    while(level < TIMING_WHEEL_LEVELS - 1 && delta >= (1ULL << (TIMING_WHEEL_SLOT_BITS * (level + 1))))
+    {
+        level ++;
+    }
+
+    timer->level = level;
+    timer->slot = (timer->expires >> (TIMING_WHEEL_SLOT_BITS * level)) & (TIMING_WHEEL_SLOTS - 1);
+    Timer *&head = m_wheel[timer->level][timer->slot];
+    timer->prev = nullptr;
+    timer->next = head;
+    if(head != nullptr)
+    {
+        head->prev = timer;
+    }
+    head = timer;
+}
+
+// must be called with the mutex locked
+void TimingWheel::Unlink(Timer *timer)
+{
+    if(timer->prev != nullptr)
+    {
+        timer->prev->next = timer->next;
+    }
+    else
+    {
+        m_wheel[timer->level][timer->slot] = timer->next;
+    }
+    if(timer->next != nullptr)
+    {
+        timer->next->prev = timer->prev;
+    }
+    timer->prev = nullptr;
+    timer->next = nullptr;
+}
+
+// must be called with the mutex locked
+void TimingWheel::Advance(std::vector<uint64_t> &expired)
+{
+    m_ticks ++;
+
+    // each time a wheel completes a turn the next slot of
+    // the upper one is spread over the lower levels
+    for(size_t level = 1;level < TIMING_WHEEL_LEVELS;level ++)
+    {
+        if((m_ticks & ((1ULL << (TIMING_WHEEL_SLOT_BITS * level)) - 1)) != 0)
+        {
+            break;
+        }
+
+        size_t slot = (m_ticks >> (TIMING_WHEEL_SLOT_BITS * level)) & (TIMING_WHEEL_SLOTS - 1);
+        Timer *timer = m_wheel[level][slot];
+        m_wheel[level][slot] = nullptr;
+        while(timer != nullptr)
+        {
+            Timer *next = timer->next;
+            Insert(timer);
+            timer = next;
+        }
+    }
+
+    size_t slot = m_ticks & (TIMING_WHEEL_SLOTS - 1);
+    Timer *timer = m_wheel[0][slot];
+    m_wheel[0][slot] = nullptr;
+    while(timer != nullptr)
+    {
+        Timer *next = timer->next;
+        expired.push_back(timer->key);
+        m_timers.erase(timer->key);
+        timer = next;
+    }
+}
@@ -48,6 +48,13 @@ bool File::Close()
     return false;
 }
 
+int File::Detach()
+{
+    int fd = m_fd;
+    m_fd = (-1);
+    return fd;
+}
+
 size_t File::Read(char *buffer, size_t size)
 {
     return read(m_fd, buffer, size);
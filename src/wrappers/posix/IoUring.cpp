@@ -0,0 +1,587 @@
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <cstring>
+#include <algorithm>
+#include "IoUring.h"
+#include "Lock.h"
+
+#define PROBE_TIMEOUT 100
+
+
+using namespace WebCpp;
+
+IoUring::~IoUring()
+{
+    Close();
+}
+
+bool IoUring::Init(unsigned entries)
+{
+    ClearError();
+
+    if(m_fd != (-1))
+    {
+        return true;
+    }
+
+    struct io_uring_params params = {};
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if(fd == ERROR)
+    {
+        SetLastError(std::string("io_uring setup error: ") + strerror(errno), errno);
+        return false;
+    }
+    m_fd = fd;
+
+    // the wait timeout is passed to io_uring_enter() as an extended argument
+    if((params.features & IORING_FEAT_EXT_ARG) == 0)
+    {
+        Close();
+        SetLastError("io_uring doesn't support the wait timeout", ENOTSUP);
+        return false;
+    }
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+    m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+    void *sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+    m_sqes = (sqes == MAP_FAILED) ? nullptr : static_cast<struct io_uring_sqe *>(sqes);
+    if(m_sqRing == MAP_FAILED || m_cqRing == MAP_FAILED || m_sqes == nullptr)
+    {
+        int error = errno;
+        Close();
+        SetLastError(std::string("io_uring map error: ") + strerror(error), error);
+        return false;
+    }
+
+    char *sq = static_cast<char *>(m_sqRing);
+    m_sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    m_sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    m_sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    m_sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    m_sqEntries = params.sq_entries;
+    m_tail = *m_sqTail;
+
+    char *cq = static_cast<char *>(m_cqRing);
+    m_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    m_cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    return true;
+}
+
+void IoUring::Close()
+{
+    // the provided buffers are unmapped after the ring is closed
+    // since the kernel could still fill them until then
+    bool buffers = (m_bufferRing != nullptr);
+    if(m_sqes != nullptr)
+    {
+        munmap(m_sqes, m_sqesSize);
+        m_sqes = nullptr;
+    }
+    if(m_cqRing != nullptr && m_cqRing != MAP_FAILED)
+    {
+        munmap(m_cqRing, m_cqRingSize);
+    }
+    m_cqRing = nullptr;
+    if(m_sqRing != nullptr && m_sqRing != MAP_FAILED)
+    {
+        munmap(m_sqRing, m_sqRingSize);
+    }
+    m_sqRing = nullptr;
+    if(m_fd != (-1))
+    {
+        close(m_fd);
+        m_fd = (-1);
+    }
+    m_pending = 0;
+    if(buffers)
+    {
+        munmap(m_bufferRing, m_bufferRingSize);
+        munmap(m_buffers, static_cast<size_t>(m_bufferCount) * m_bufferSize);
+        m_bufferRing = nullptr;
+        m_buffers = nullptr;
+        m_bufferCount = 0;
+    }
+}
+
+bool IoUring::IsInitialized() const
+{
+    return (m_fd != (-1));
+}
+
+bool IoUring::PollAdd(int fd, uint32_t events, uint64_t data, bool multishot)
+{
+    Lock lock(m_submitMutex);
+
+    struct io_uring_sqe *sqe = GetSqe();
+    if(sqe == nullptr)
+    {
+        SetLastError("io_uring submission queue is full", EBUSY);
+        return false;
+    }
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->len = (multishot ? IORING_POLL_ADD_MULTI : 0);
+    sqe->user_data = data;
+    Commit();
+
+    // submitted with the next Wait()
+    return true;
+}
+
+bool IoUring::PollRemove(uint64_t data)
+{
+    {
+        Lock lock(m_submitMutex);
+
+        struct io_uring_sqe *sqe = GetSqe();
+        if(sqe == nullptr)
+        {
+            return false;
+        }
+
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = (-1);
+        sqe->addr = data;
+        sqe->user_data = IO_URING_IGNORE_DATA;
+        Commit();
+    }
+
+    // the poll holds a reference to the socket, so the removal is
+    // submitted right away to let the socket be closed by close()
+    return Submit();
+}
+
+bool IoUring::AcceptAdd(int fd, uint64_t data)
+{
+#ifdef IORING_ACCEPT_MULTISHOT
+    Lock lock(m_submitMutex);
+
+    struct io_uring_sqe *sqe = GetSqe();
+    if(sqe == nullptr)
+    {
+        SetLastError("io_uring submission queue is full", EBUSY);
+        return false;
+    }
+
+    // every client accepted is reported with its descriptor
+    // while the accept stays armed
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = data;
+    Commit();
+
+    return true;
+#else
+    (void)fd;
+    (void)data;
+    SetLastError("io_uring multishot accept isn't supported", ENOTSUP);
+    return false;
+#endif
+}
+
+bool IoUring::RecvAdd(int fd, uint64_t data)
+{
+#ifdef IORING_RECV_MULTISHOT
+    Lock lock(m_submitMutex);
+
+    struct io_uring_sqe *sqe = GetSqe();
+    if(sqe == nullptr)
+    {
+        SetLastError("io_uring submission queue is full", EBUSY);
+        return false;
+    }
+
+    // the kernel picks a provided buffer for every chunk of data it
+    // receives, the buffer id comes with the completion
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = IO_URING_BUFFER_GROUP;
+    sqe->user_data = data;
+    Commit();
+
+    return true;
+#else
+    (void)fd;
+    (void)data;
+    SetLastError("io_uring multishot recv isn't supported", ENOTSUP);
+    return false;
+#endif
+}
+
+size_t IoUring::SendAdd(int fd, const struct iovec *iov, size_t count, int flags, uint64_t data)
+{
+    Lock lock(m_submitMutex);
+
+    // the whole chain is queued under the lock, so the entries of another
+    // thread don't get in between and break it up
+    if(m_fd != (-1) && m_tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) + count > m_sqEntries)
+    {
+        SubmitPending();
+    }
+    unsigned room = (m_fd == (-1) ? 0 : m_sqEntries - (m_tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE)));
+    count = std::min(count, static_cast<size_t>(room));
+    if(count == 0)
+    {
+        SetLastError("io_uring submission queue is full", EBUSY);
+        return 0;
+    }
+
+    // a linked send starts when the previous one is completed, so the blocks go
+    // out in order. MSG_WAITALL makes the kernel finish a short send instead of
+    // going on with the next one, a failed send cancels the rest of the chain
+    for(size_t i = 0;i < count;i ++)
+    {
+        bool link = (i + 1 < count);
+        struct io_uring_sqe *sqe = GetSqe();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(iov[i].iov_base);
+        sqe->len = static_cast<uint32_t>(iov[i].iov_len);
+        sqe->msg_flags = static_cast<uint32_t>(flags | MSG_WAITALL | (link ? MSG_MORE : 0));
+        sqe->flags = (link ? IOSQE_IO_LINK : 0);
+        sqe->user_data = data;
+        Commit();
+    }
+
+    return count;
+}
+
+bool IoUring::Cancel(uint64_t data)
+{
+    {
+        Lock lock(m_submitMutex);
+
+        struct io_uring_sqe *sqe = GetSqe();
+        if(sqe == nullptr)
+        {
+            return false;
+        }
+
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = (-1);
+        sqe->addr = data;
+        sqe->user_data = IO_URING_IGNORE_DATA;
+        Commit();
+    }
+
+    return Submit();
+}
+
+bool IoUring::CancelFd(int fd)
+{
+#ifdef IORING_ASYNC_CANCEL_FD
+    {
+        Lock lock(m_submitMutex);
+
+        struct io_uring_sqe *sqe = GetSqe();
+        if(sqe == nullptr)
+        {
+            return false;
+        }
+
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = fd;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        sqe->user_data = IO_URING_IGNORE_DATA;
+        Commit();
+    }
+
+    // the requests hold a reference to the socket, so the cancel is
+    // submitted right away to let the socket be closed by close()
+    return Submit();
+#else
+    (void)fd;
+    return false;
+#endif
+}
+
+int IoUring::Wait(int timeout, std::vector<Completion> &completions)
+{
+    completions.clear();
+
+    if(Submit() == false)
+    {
+        SetLastError(std::string("io_uring submit error: ") + strerror(errno), errno);
+        return ERROR;
+    }
+
+    unsigned head = *m_cqHead;
+    if(head == __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE))
+    {
+        struct io_uring_getevents_arg arg = {};
+        struct __kernel_timespec ts = {};
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        if(syscall(__NR_io_uring_enter, m_fd, 0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg)) == ERROR &&
+                errno != ETIME && errno != EINTR)
+        {
+            SetLastError(std::string("io_uring wait error: ") + strerror(errno), errno);
+            return ERROR;
+        }
+    }
+
+    unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+    while(head != tail)
+    {
+        const struct io_uring_cqe &cqe = m_cqes[head & *m_cqMask];
+        completions.push_back({ cqe.user_data, cqe.res, cqe.flags });
+        head ++;
+    }
+    __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+
+    return static_cast<int>(completions.size());
+}
+
+bool IoUring::InitBuffers(unsigned count, unsigned size)
+{
+#ifdef IORING_RECV_MULTISHOT
+    if(m_fd == (-1) || m_bufferRing != nullptr || count == 0 || (count & (count - 1)) != 0 || count > 32768)
+    {
+        SetLastError("io_uring buffers can't be set up", EINVAL);
+        return false;
+    }
+
+    m_bufferRingSize = count * sizeof(struct io_uring_buf);
+    void *ring = mmap(nullptr, m_bufferRingSize, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    void *buffers = mmap(nullptr, static_cast<size_t>(count) * size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if(ring == MAP_FAILED || buffers == MAP_FAILED)
+    {
+        int error = errno;
+        if(ring != MAP_FAILED)
+        {
+            munmap(ring, m_bufferRingSize);
+        }
+        if(buffers != MAP_FAILED)
+        {
+            munmap(buffers, static_cast<size_t>(count) * size);
+        }
+        SetLastError(std::string("io_uring buffers map error: ") + strerror(error), error);
+        return false;
+    }
+
+    struct io_uring_buf_reg reg = {};
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+    reg.ring_entries = count;
+    reg.bgid = IO_URING_BUFFER_GROUP;
+    if(syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PBUF_RING, &reg, 1) == ERROR)
+    {
+        int error = errno;
+        munmap(ring, m_bufferRingSize);
+        munmap(buffers, static_cast<size_t>(count) * size);
+        SetLastError(std::string("io_uring buffers register error: ") + strerror(error), error);
+        return false;
+    }
+
+    m_bufferRing = static_cast<struct io_uring_buf_ring *>(ring);
+    m_buffers = static_cast<uint8_t *>(buffers);
+    m_bufferCount = count;
+    m_bufferSize = size;
+    m_bufferTail = 0;
+    for(unsigned i = 0;i < count;i ++)
+    {
+        AddBuffer(static_cast<uint16_t>(i));
+    }
+    __atomic_store_n(&m_bufferRing->tail, m_bufferTail, __ATOMIC_RELEASE);
+
+    return true;
+#else
+    (void)count;
+    (void)size;
+    SetLastError("io_uring provided buffers aren't supported", ENOTSUP);
+    return false;
+#endif
+}
+
+bool IoUring::HasBuffers() const
+{
+    return (m_bufferRing != nullptr);
+}
+
+const uint8_t *IoUring::GetBuffer(uint16_t id) const
+{
+    return (id < m_bufferCount ? m_buffers + static_cast<size_t>(id) * m_bufferSize : nullptr);
+}
+
+void IoUring::ReturnBuffer(uint16_t id)
+{
+    // the buffer can be picked by the kernel again
+    if(id < m_bufferCount)
+    {
+        AddBuffer(id);
+        __atomic_store_n(&m_bufferRing->tail, m_bufferTail, __ATOMIC_RELEASE);
+    }
+}
+
+bool IoUring::IsSupported()
+{
+    static const bool supported = Probe();
+    return supported;
+}
+
+bool IoUring::IsCompletionSupported()
+{
+    static const bool supported = (IsSupported() && ProbeCompletion());
+    return supported;
+}
+
+void IoUring::AddBuffer(uint16_t id)
+{
+    // the entries are taken from the start of the ring, not from its bufs member
+    // which the header puts after an empty struct when compiled as C++
+    struct io_uring_buf &buffer = reinterpret_cast<struct io_uring_buf *>(m_bufferRing)[m_bufferTail & (m_bufferCount - 1)];
+    buffer.addr = reinterpret_cast<uint64_t>(m_buffers + static_cast<size_t>(id) * m_bufferSize);
+    buffer.len = m_bufferSize;
+    buffer.bid = id;
+    m_bufferTail ++;
+}
+
+struct io_uring_sqe *IoUring::GetSqe()
+{
+    if(m_fd == (-1))
+    {
+        return nullptr;
+    }
+
+    if(m_tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries)
+    {
+        // the queue is full, pass the pending entries to the kernel to make room
+        SubmitPending();
+        if(m_tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries)
+        {
+            return nullptr;
+        }
+    }
+
+    struct io_uring_sqe *sqe = &m_sqes[m_tail & *m_sqMask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    return sqe;
+}
+
+void IoUring::Commit()
+{
+    unsigned index = m_tail & *m_sqMask;
+    m_sqArray[index] = index;
+    m_tail ++;
+    __atomic_store_n(m_sqTail, m_tail, __ATOMIC_RELEASE);
+    m_pending ++;
+}
+
+bool IoUring::Submit()
+{
+    Lock lock(m_submitMutex);
+    return SubmitPending();
+}
+
+bool IoUring::SubmitPending()
+{
+    // must be called with the submission mutex locked
+    while(m_pending > 0)
+    {
+        int count = static_cast<int>(syscall(__NR_io_uring_enter, m_fd, m_pending, 0, 0, nullptr, 0));
+        if(count == ERROR)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        if(count == 0)
+        {
+            break;
+        }
+        m_pending -= std::min(m_pending, static_cast<unsigned>(count));
+    }
+
+    return true;
+}
+
+bool IoUring::Probe()
+{
+    // io_uring could be missing, disabled by the system or too
+    // old to have the multishot poll, so one is tried on an eventfd
+    IoUring ring;
+    if(ring.Init(4) == false)
+    {
+        return false;
+    }
+
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(fd == ERROR)
+    {
+        return false;
+    }
+
+    bool supported = false;
+    uint64_t value = 1;
+    std::vector<Completion> completions;
+    if(ring.PollAdd(fd, POLLIN, 1) && write(fd, &value, sizeof(value)) == sizeof(value) &&
+            ring.Wait(PROBE_TIMEOUT, completions) > 0)
+    {
+        for(auto &completion: completions)
+        {
+            if(completion.data == 1 && completion.result > 0 && (completion.flags & IORING_CQE_F_MORE))
+            {
+                supported = true;
+            }
+        }
+    }
+
+    close(fd);
+    return supported;
+}
+
+bool IoUring::ProbeCompletion()
+{
+    // the multishot recv into provided buffers came last of what the completion
+    // based sockets need, so a kernel that has it has the rest too
+    IoUring ring;
+    if(ring.Init(4) == false || ring.InitBuffers(2, 64) == false)
+    {
+        return false;
+    }
+
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) == ERROR)
+    {
+        return false;
+    }
+
+    bool supported = false;
+    std::vector<Completion> completions;
+    if(ring.RecvAdd(fds[0], 1) && ring.Submit() && write(fds[1], "x", 1) == 1 &&
+            ring.Wait(PROBE_TIMEOUT, completions) > 0)
+    {
+        for(auto &completion: completions)
+        {
+            if(completion.data == 1 && completion.result == 1 &&
+                    (completion.flags & IORING_CQE_F_BUFFER) && (completion.flags & IORING_CQE_F_MORE))
+            {
+                supported = true;
+            }
+        }
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+    return supported;
+}
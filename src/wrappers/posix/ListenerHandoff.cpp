@@ -0,0 +1,298 @@
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cstring>
+#include <stdexcept>
+#include "ListenerHandoff.h"
+
+#define HANDOFF_POLL_TIMEOUT 500
+#define HANDOFF_ACK 'A'
+
+
+using namespace WebCpp;
+
+static socklen_t MakeAddress(const std::string &path, struct sockaddr_un &addr)
+{
+    if(path.empty() || path.size() >= sizeof(addr.sun_path))
+    {
+        throw std::runtime_error("wrong handoff socket path: " + path);
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return static_cast<socklen_t>(__builtin_offsetof(struct sockaddr_un, sun_path) + path.length() + 1);
+}
+
+static bool WaitFor(int fd, int timeout)
+{
+    struct pollfd pfd = {};
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    return (poll(&pfd, 1, timeout) > 0);
+}
+
+ListenerHandoff::~ListenerHandoff()
+{
+    Close();
+}
+
+bool ListenerHandoff::Receive(const std::string &path, std::vector<int> &sockets)
+{
+    ClearError();
+    int fd = (-1);
+
+    try
+    {
+        struct sockaddr_un addr;
+        socklen_t len = MakeAddress(path, addr);
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(fd == ERROR)
+        {
+            throw std::runtime_error(std::string("handoff socket create error: ") + strerror(errno));
+        }
+        if(connect(fd, reinterpret_cast<struct sockaddr *>(&addr), len) == ERROR)
+        {
+            // usually there is just no server running
+            SetLastError(std::string("no server to take the sockets from: ") + strerror(errno), errno);
+            close(fd);
+            return false;
+        }
+
+        if(WaitFor(fd, HANDOFF_TIMEOUT) == false)
+        {
+            throw std::runtime_error("handoff timed out");
+        }
+
+        uint32_t count = 0;
+        struct iovec iov;
+        iov.iov_base = &count;
+        iov.iov_len = sizeof(count);
+        char control[CMSG_SPACE(sizeof(int) * MAX_HANDOFF_SOCKETS)];
+        struct msghdr msg = {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if(recvmsg(fd, &msg, MSG_CMSG_CLOEXEC) != sizeof(count))
+        {
+            throw std::runtime_error("handoff receive error");
+        }
+
+        std::vector<int> received;
+        for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);cmsg != nullptr;cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            {
+                size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                const int *fds = reinterpret_cast<const int *>(CMSG_DATA(cmsg));
+                received.insert(received.end(), fds, fds + n);
+            }
+        }
+
+        bool listening = (received.size() == count && (msg.msg_flags & MSG_CTRUNC) == 0);
+        for(int socket: received)
+        {
+            int on = 0;
+            socklen_t size = sizeof(on);
+            listening = listening && (getsockopt(socket, SOL_SOCKET, SO_ACCEPTCONN, &on, &size) != ERROR && on == 1);
+        }
+        if(listening == false || received.empty())
+        {
+            for(int socket: received)
+            {
+                close(socket);
+            }
+            throw std::runtime_error("no listening sockets were handed off");
+        }
+
+        // the old server stops accepting when it gets the reply and
+        // frees the path when it closes the connection
+        char ack = HANDOFF_ACK;
+        if(send(fd, &ack, sizeof(ack), MSG_NOSIGNAL) != sizeof(ack))
+        {
+            for(int socket: received)
+            {
+                close(socket);
+            }
+            throw std::runtime_error(std::string("handoff reply error: ") + strerror(errno));
+        }
+        if(WaitFor(fd, HANDOFF_TIMEOUT))
+        {
+            recv(fd, &ack, sizeof(ack), 0);
+        }
+
+        close(fd);
+        sockets = received;
+        return true;
+    }
+    catch(const std::runtime_error &err)
+    {
+        SetLastError(err.what());
+    }
+    catch(...)
+    {
+        SetLastError("handoff error");
+    }
+
+    if(fd != (-1))
+    {
+        close(fd);
+    }
+    return false;
+}
+
+bool ListenerHandoff::Serve(const std::string &path, const SocketsFunc &sockets, const HandedOffFunc &handedOff)
+{
+    ClearError();
+    Close();
+
+    try
+    {
+        struct sockaddr_un addr;
+        socklen_t len = MakeAddress(path, addr);
+
+        m_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(m_fd == ERROR)
+        {
+            throw std::runtime_error(std::string("handoff socket create error: ") + strerror(errno));
+        }
+
+        // the path left by a server that has crashed is taken over
+        struct stat st;
+        if(stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        {
+            int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            bool alive = (probe != ERROR && connect(probe, reinterpret_cast<struct sockaddr *>(&addr), len) == 0);
+            if(probe != ERROR)
+            {
+                close(probe);
+            }
+            if(alive)
+            {
+                throw std::runtime_error("handoff socket " + path + " is in use");
+            }
+            unlink(path.c_str());
+        }
+
+        // the sockets are given to the processes of the same user only
+        if(bind(m_fd, reinterpret_cast<struct sockaddr *>(&addr), len) == ERROR ||
+                chmod(path.c_str(), S_IRUSR | S_IWUSR) == ERROR ||
+                listen(m_fd, 1) == ERROR)
+        {
+            throw std::runtime_error(std::string("handoff socket error: ") + strerror(errno));
+        }
+
+        m_path = path;
+        m_sockets = sockets;
+        m_handedOff = handedOff;
+        m_thread.SetFunction(std::bind(&ListenerHandoff::ServeThread, this, std::placeholders::_1));
+        if(m_thread.Start() == false)
+        {
+            throw std::runtime_error("handoff thread start error: " + m_thread.GetLastError());
+        }
+
+        return true;
+    }
+    catch(const std::runtime_error &err)
+    {
+        SetLastError(err.what());
+    }
+    catch(...)
+    {
+        SetLastError("handoff error");
+    }
+
+    Close();
+    return false;
+}
+
+void ListenerHandoff::Close()
+{
+    m_thread.Stop();
+    if(m_fd != (-1))
+    {
+        close(m_fd);
+        m_fd = (-1);
+        unlink(m_path.c_str());
+    }
+    m_path.clear();
+}
+
+void *ListenerHandoff::ServeThread(bool &running)
+{
+    while(running)
+    {
+        if(WaitFor(m_fd, HANDOFF_POLL_TIMEOUT) == false)
+        {
+            continue;
+        }
+
+        int fd = accept4(m_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if(fd == ERROR)
+        {
+            continue;
+        }
+
+        if(HandOff(fd))
+        {
+            // the new server may take the path as soon as the connection is closed,
+            // this server is draining by then so its clients are told to reconnect
+            close(m_fd);
+            m_fd = (-1);
+            unlink(m_path.c_str());
+            if(m_handedOff != nullptr)
+            {
+                m_handedOff();
+            }
+            close(fd);
+            break;
+        }
+        close(fd);
+    }
+
+    return nullptr;
+}
+
+bool ListenerHandoff::HandOff(int fd)
+{
+    struct ucred cred = {};
+    socklen_t size = sizeof(cred);
+    if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &size) == ERROR || cred.uid != getuid())
+    {
+        return false;
+    }
+
+    std::vector<int> sockets = (m_sockets == nullptr ? std::vector<int>() : m_sockets());
+    if(sockets.empty() || sockets.size() > MAX_HANDOFF_SOCKETS)
+    {
+        return false;
+    }
+
+    uint32_t count = static_cast<uint32_t>(sockets.size());
+    struct iovec iov;
+    iov.iov_base = &count;
+    iov.iov_len = sizeof(count);
+    char control[CMSG_SPACE(sizeof(int) * MAX_HANDOFF_SOCKETS)] = {};
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * sockets.size());
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * sockets.size());
+    memcpy(CMSG_DATA(cmsg), sockets.data(), sizeof(int) * sockets.size());
+    if(sendmsg(fd, &msg, MSG_NOSIGNAL) != sizeof(count))
+    {
+        return false;
+    }
+
+    // the sockets are not given up until the new server confirms it has them
+    char ack = 0;
+    return (WaitFor(fd, HANDOFF_TIMEOUT) && recv(fd, &ack, sizeof(ack), 0) == sizeof(ack) && ack == HANDOFF_ACK);
+}
@@ -1,5 +1,11 @@
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <cstdlib>
+#include <cstring>
 #include "Platform.h"
 #include "unistd.h"
+#include "StringUtil.h"
 
 
 
@@ -12,3 +18,83 @@ void WebCpp::Sleep(uint32_t delay)
 {
     sleep(delay);
 }
+
+bool WebCpp::ParseCpuList(const std::string &list, std::vector<int> &cpus)
+{
+    cpus.clear();
+    for(auto &token: StringUtil::Split(list, ','))
+    {
+        StringUtil::Trim(token);
+        if(token.empty())
+        {
+            continue;
+        }
+
+        int first, last;
+        size_t pos = token.find('-');
+        if(pos == std::string::npos)
+        {
+            if(StringUtil::String2int(token, first) == false)
+            {
+                return false;
+            }
+            last = first;
+        }
+        else if(StringUtil::String2int(token.substr(0, pos), first) == false ||
+                StringUtil::String2int(token.substr(pos + 1), last) == false)
+        {
+            return false;
+        }
+
+        if(first < 0 || last < first)
+        {
+            return false;
+        }
+        for(int cpu = first;cpu <= last;cpu ++)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+
+    return true;
+}
+
+int WebCpp::GetCpuNode(int cpu)
+{
+    // the CPU folder has a link to the node it belongs to
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR *dir = opendir(path.c_str());
+    if(dir == nullptr)
+    {
+        return (-1);
+    }
+
+    int node = (-1);
+    struct dirent *entry;
+    while((entry = readdir(dir)) != nullptr)
+    {
+        if(strncmp(entry->d_name, "node", 4) == 0 &&
+                StringUtil::String2int(entry->d_name + 4, node))
+        {
+            break;
+        }
+        node = (-1);
+    }
+    closedir(dir);
+
+    return node;
+}
+
+bool WebCpp::SetPreferredNode(int node)
+{
+    if(node < 0)
+    {
+        return false;
+    }
+
+    // no libnuma, the policy is set by the system call directly
+    const size_t bits = sizeof(unsigned long) * 8;
+    std::vector<unsigned long> mask(node / bits + 1, 0);
+    mask[node / bits] |= (1UL << (node % bits));
+    return (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(), mask.size() * bits + 1) == 0);
+}
@@ -13,6 +13,11 @@ void Signal::Fire()
     pthread_cond_signal(&m_signalCondition);
 }
 
+void Signal::FireAll()
+{
+    pthread_cond_broadcast(&m_signalCondition);
+}
+
 void Signal::Wait(Mutex &mutex)
 {
     pthread_cond_wait(& m_signalCondition, mutex.GetMutex());
@@ -1,82 +1,122 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/un.h>
+#include <sys/stat.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <fcntl.h>
 #include <netdb.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <limits.h>
+#include <linux/errqueue.h>
 #include <cstring>
 #include <stdexcept>
+#include <algorithm>
 #include "SocketPool.h"
 #include "StringUtil.h"
 #include "Lock.h"
 
 #define MAIN_SOCKET_INDEX 0
-#define QUEUE_SIZE 10
+// the io_uring requests of a socket are told by the operation kept in the top byte of
+// their data, the generation and the index of the socket are below it as in epoll
+#define RING_OP_POLL 0
+#define RING_OP_ACCEPT 1
+#define RING_OP_RECV 2
+#define RING_OP_SEND 3
+#define RING_OP_POLLOUT 4
+#define RING_OP_SHIFT 56
+#define RING_GENERATION_MASK 0xFFFFFF
+
+// the completions of the zero-copy sends come with the socket error queue
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define WITH_ZEROCOPY
+#endif
 
 
 using namespace WebCpp;
 
-SocketPool::SocketPool(size_t count, Service service, Domain domain, Type type, Options options):
-    m_count(count),
+static uint64_t RingData(int op, uint32_t generation, size_t index)
+{
+    return (static_cast<uint64_t>(op) << RING_OP_SHIFT) | (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(index);
+}
+
+SocketPool::SocketPool(size_t capacity, Service service, Domain domain, Type type, Options options):
+    m_capacity(capacity == 0 ? 1 : capacity),
     m_service(service),
     m_domain(domain),
     m_type(type),
     m_options(options)
 {
-    m_fds = new struct pollfd[count] { };
-    for(auto i = 0;i < count;i ++)
-    {
-        m_fds[i].fd = (-1);
-    }
-#ifdef WITH_OPENSSL
-    if(IsContains(m_options, Options::Ssl))
-    {
-        m_sslClient = new SSL*[count];
-    }
-#endif
+    // the table grows by chunks, the chunk list itself is never
+    // reallocated so a slot address stays valid while it is in use
+    m_chunks.resize((m_capacity + CONNECTION_CHUNK_SIZE - 1) / CONNECTION_CHUNK_SIZE, nullptr);
+    m_chunks[0] = new Connection[CONNECTION_CHUNK_SIZE];
+    m_used = MAIN_SOCKET_INDEX + 1; // the main socket slot is always reserved
+    m_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
 }
 
 SocketPool::~SocketPool()
 {
-    if(m_fds != nullptr)
+    // the ring goes first, the kernel could still use the buffers of its requests
+    m_ring.Close();
+    for(int fd: m_accepted)
     {
-        delete []m_fds;
-        m_fds = nullptr;
+        close(fd);
     }
-#ifdef WITH_OPENSSL
-    if(IsContains(m_options, Options::Ssl))
+    for(auto &linger: m_zeroCopyLinger)
+    {
+        close(linger.fd);
+    }
+    m_zeroCopyLinger.clear();
+    if(m_wakeup != (-1))
+    {
+        close(m_wakeup);
+        m_wakeup = (-1);
+    }
+    if(m_epoll != (-1))
+    {
+        close(m_epoll);
+        m_epoll = (-1);
+    }
+    if(m_events != nullptr)
+    {
+        delete []m_events;
+        m_events = nullptr;
+    }
+    for(auto &chunk: m_chunks)
     {
+        if(chunk != nullptr)
         {
-            if(m_sslClient != nullptr)
-                delete []m_sslClient;
-            m_sslClient = nullptr;
+            delete []chunk;
+            chunk = nullptr;
         }
     }
-#endif
 }
 
 int SocketPool::Create(bool main)
 {
-    ClearError();
+    ClearSharedError();
     int sock = (-1);
 
     try
     {
-        size_t index = main ? MAIN_SOCKET_INDEX : FindEmpty();
-        if(index == (-1))
+        int index = main ? MAIN_SOCKET_INDEX : Allocate();
+        if(index == ERROR)
         {
-            SetLastError("No free room for socket");
+            SetSharedError("No free room for socket");
             return (-1);
         }
+        Connection *conn = GetConnection(index);
 
 #ifdef WITH_OPENSSL
         if(IsContains(m_options, Options::Ssl))
         {
             if(InitSSL() == false)
             {
-                throw std::runtime_error(std::string("SSL init error: ") + GetLastError());
+                throw std::runtime_error(std::string("SSL init error: ") + GetSharedError());
             }
         }
 #endif
@@ -99,16 +139,33 @@ int SocketPool::Create(bool main)
             }
         }
 
+        if(IsContains(m_options, Options::ReusePort))
+        {
+            int opt = 1;
+            if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == ERROR)
+            {
+                throw std::runtime_error(std::string("set socket option error: ") + strerror(errno));
+            }
+        }
+
         fcntl(sock, F_SETFL, O_NONBLOCK);
-        m_fds[index].fd = sock;
-        m_fds[index].events = POLLIN;
+        conn->fd = sock;
+        conn->events = POLLIN;
+
+        if(WatchSocket(index) == false)
+        {
+            std::string error = GetSharedError();
+            Lock lock(m_tableMutex);
+            Release(index);
+            throw std::runtime_error(error);
+        }
 
 #ifdef WITH_OPENSSL
         if(IsContains(m_options, Options::Ssl))
         {
-            auto ssl = SSL_new(m_ctx);
+            auto ssl = SSL_new(m_sslContext->Get());
             SSL_set_fd(ssl, sock);
-            m_sslClient[index] = ssl;
+            conn->ssl = ssl;
             if(index == 0)
             {
                 if(m_service == Service::Client)
@@ -126,11 +183,11 @@ int SocketPool::Create(bool main)
     }
     catch(const std::runtime_error &err)
     {
-        SetLastError(err.what());
+        SetSharedError(err.what());
     }
     catch(...)
     {
-        SetLastError("error creating socket");
+        SetSharedError("error creating socket");
     }
 
     if(sock >= 0)
@@ -140,29 +197,47 @@ int SocketPool::Create(bool main)
     return (-1);
 }
 
-bool SocketPool::CloseSocket(size_t index)
+bool SocketPool::CloseSocket(size_t index, uint32_t generation)
 {
-    if(index < m_count)
+    Lock lock(m_tableMutex);
+
+    Connection *conn = GetConnection(index);
+    if(conn == nullptr)
     {
-        if(m_fds[index].fd != (-1))
-        {
-            close(m_fds[index].fd);
-            m_fds[index].fd = (-1);
-            m_fds[index].events = 0;
+        return false;
+    }
+
+    Lock connLock(conn->mutex);
+    if(conn->fd != (-1) && (generation == ANY_GENERATION || conn->generation == generation))
+    {
+        UnwatchSocket(index);
+        // close_notify has to go out before the descriptor number can be reused
 #ifdef WITH_OPENSSL
-            if(IsContains(m_options, Options::Ssl))
+        if(conn->ssl != nullptr)
+        {
+            if(conn->handshaking == false)
             {
-                SSL *ssl = m_sslClient[index];
-                if(ssl != nullptr)
-                {
-                    SSL_shutdown(ssl);
-                    SSL_free(ssl);
-                }
-                m_sslClient[index] = nullptr;
+                SSL_shutdown(conn->ssl);
             }
+            SSL_free(conn->ssl);
+            conn->ssl = nullptr;
+        }
 #endif
-            return true;
+        if(conn->zeroCopyPending.empty())
+        {
+            close(conn->fd);
+        }
+        else
+        {
+            // the kernel still reads the buffers of the data on its way, so the
+            // socket is only shut down and closed when they are released
+            shutdown(conn->fd, SHUT_WR);
+            Lock lingerLock(m_zeroCopyLingerMutex);
+            m_zeroCopyLinger.push_back({ conn->fd, std::move(conn->zeroCopyPending),
+                                         std::chrono::steady_clock::now() + std::chrono::milliseconds(ZEROCOPY_LINGER_TIMEOUT) });
         }
+        Release(index);
+        return true;
     }
 
     return false;
@@ -170,7 +245,7 @@ bool SocketPool::CloseSocket(size_t index)
 
 bool SocketPool::CloseSockets()
 {
-    for(auto i = 0;i < m_count;i ++)
+    for(size_t i = 0;i < m_used;i ++)
     {
         CloseSocket(i);
     }
@@ -182,23 +257,37 @@ bool SocketPool::Bind(const std::string &host, int port)
 {
     ClearError();
 
-    try
+    if(GetConnection(MAIN_SOCKET_INDEX)->fd == (-1))
     {
-        if(m_fds[MAIN_SOCKET_INDEX].fd == (-1))
-        {
-            SetLastError("create main socket first");
-            return false;
-        }
+        SetLastError("create main socket first");
+        return false;
+    }
 
-        if(!host.empty())
-        {
-            m_host = host;
-        }
-        if(port > 0)
-        {
-            m_port = port;
-        }
+    if(!host.empty())
+    {
+        m_host = host;
+    }
+    if(port > 0)
+    {
+        m_port = port;
+    }
+
+    switch(m_domain)
+    {
+        case Domain::Inet:
+            return BindTcp();
+        case Domain::Local:
+            return BindUnix();
+        default: break;
+    }
 
+    return false;
+}
+
+bool SocketPool::BindTcp()
+{
+    try
+    {
         int d = SocketPool::Domain2Domain(m_domain);
         struct sockaddr_in server_sockaddr;
         server_sockaddr.sin_family = d;
@@ -212,7 +301,60 @@ bool SocketPool::Bind(const std::string &host, int port)
             server_sockaddr.sin_addr.s_addr = inet_addr(m_host.c_str());
         }
 
-        if(bind(m_fds[MAIN_SOCKET_INDEX].fd, (struct sockaddr* ) &server_sockaddr, sizeof(server_sockaddr)) == ERROR)
+        if(bind(GetConnection(MAIN_SOCKET_INDEX)->fd, (struct sockaddr* ) &server_sockaddr, sizeof(server_sockaddr)) == ERROR)
+        {
+            throw std::runtime_error(std::string("socket bind error: ") + strerror(errno));
+        }
+
+        return true;
+    }
+    catch(const std::runtime_error &err)
+    {
+        SetLastError(err.what());
+    }
+    catch(...)
+    {
+        SetLastError("socket bind error");
+    }
+
+    return false;
+}
+
+bool SocketPool::BindUnix()
+{
+    struct sockaddr_un addr;
+
+    try
+    {
+        if(m_host.empty() || m_host.size() >= sizeof(addr.sun_path))
+        {
+            throw std::runtime_error("wrong socket path: " + m_host);
+        }
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, m_host.c_str(), sizeof(addr.sun_path) - 1);
+        socklen_t len = static_cast<socklen_t>(__builtin_offsetof(struct sockaddr_un, sun_path) + m_host.length() + 1);
+
+        // the file left by a server that didn't exit properly is removed,
+        // the one that still accepts connections is not taken over
+        struct stat st;
+        if(stat(m_host.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        {
+            int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            bool alive = (probe != ERROR && connect(probe, reinterpret_cast<struct sockaddr *>(&addr), len) == 0);
+            if(probe != ERROR)
+            {
+                close(probe);
+            }
+            if(alive)
+            {
+                throw std::runtime_error("socket bind error: " + m_host + " is in use");
+            }
+            unlink(m_host.c_str());
+        }
+
+        if(bind(GetConnection(MAIN_SOCKET_INDEX)->fd, reinterpret_cast<struct sockaddr *>(&addr), len) == ERROR)
         {
             throw std::runtime_error(std::string("socket bind error: ") + strerror(errno));
         }
@@ -237,17 +379,28 @@ bool SocketPool::Listen()
 
     try
     {
-        if(m_fds[MAIN_SOCKET_INDEX].fd == (-1))
+        if(GetConnection(MAIN_SOCKET_INDEX)->fd == (-1))
         {
             SetLastError("create main socket first");
             return false;
         }
 
-        if(listen(m_fds[MAIN_SOCKET_INDEX].fd, QUEUE_SIZE) == ERROR)
+        if(ApplyListenOptions(GetConnection(MAIN_SOCKET_INDEX)->fd) == false)
+        {
+            throw std::runtime_error(GetLastError());
+        }
+
+        if(listen(GetConnection(MAIN_SOCKET_INDEX)->fd, m_listenBacklog) == ERROR)
         {
             throw std::runtime_error(std::string("socket listen error: ") + strerror(errno));
         }
 
+        // the multishot accept can be armed only on a listening socket
+        if(GetConnection(MAIN_SOCKET_INDEX)->ringIo && IoUringAdd(MAIN_SOCKET_INDEX) == false)
+        {
+            throw std::runtime_error(GetSharedError());
+        }
+
         return true;
     }
     catch(const std::runtime_error &err)
@@ -262,65 +415,151 @@ bool SocketPool::Listen()
     return false;
 }
 
-size_t SocketPool::Accept()
+size_t SocketPool::Accept(AcceptStatus &status)
 {
-    ClearError();
+    // the writers set the error of the pool meanwhile, so the caller
+    // looks at the status rather than at the error code
+    status = AcceptStatus::Failed;
 
     try
     {
-        if(m_fds[MAIN_SOCKET_INDEX].fd == (-1))
+        int new_socket;
+        if(m_ringIo)
+        {
+            // the clients are already taken by the multishot accept of the ring,
+            // even the ones it took while the listening socket was being closed
+            if(m_accepted.empty())
+            {
+                status = AcceptStatus::Empty;
+                return ERROR;
+            }
+            new_socket = m_accepted.front();
+            m_accepted.pop_front();
+        }
+        else
         {
-            throw std::runtime_error("create main socket first");
+            int fd = GetConnection(MAIN_SOCKET_INDEX)->fd;
+            if(fd == (-1))
+            {
+                SetSharedError("create main socket first", EBADF);
+                return ERROR;
+            }
+            new_socket = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
         }
 
-        int new_socket = accept(m_fds[MAIN_SOCKET_INDEX].fd, NULL, NULL);
         if(new_socket != ERROR)
         {
-            int index = FindEmpty();
+            // the next clients are still queued whatever happens to this one
+            status = AcceptStatus::Dropped;
+            int index = Allocate();
             if(index != ERROR)
             {
-                fcntl(new_socket, F_SETFL, O_NONBLOCK);
-                m_fds[index].fd = new_socket;
-                m_fds[index].events = POLLIN;
+                Connection *conn = GetConnection(index);
+                conn->fd = new_socket;
+                conn->events = POLLIN;
+                conn->ringIo = m_ringIo;
+                if(ApplyConnectionOptions(new_socket) == false || WatchSocket(index) == false)
+                {
+                    std::string error = GetSharedError();
+                    CloseSocket(index);
+                    throw std::runtime_error(error);
+                }
+#ifdef WITH_ZEROCOPY
+                if(m_zeroCopyThreshold > 0 && m_domain == Domain::Inet && IsContains(m_options, Options::Ssl) == false && m_ringIo == false)
+                {
+                    // the large blocks are copied as usual if the kernel can't do that
+                    int on = 1;
+                    conn->zeroCopy = (setsockopt(new_socket, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) != ERROR);
+                }
+#endif
 #ifdef WITH_OPENSSL
                 if(IsContains(m_options, Options::Ssl))
                 {
                     if(AcceptSsl(new_socket, index) == false)
                     {
+                        std::string error = GetSharedError();
                         CloseSocket(index);
-                        throw std::runtime_error(GetLastError());
+                        throw std::runtime_error(error);
                     }
                 }
 #endif
+                status = AcceptStatus::Accepted;
                 return index;
             }
             else
             {
-                throw std::runtime_error("no room for new connction");
+                // the connection table is full, the client is
+                // dropped and the caller may continue accepting
+                close(new_socket);
+                throw std::runtime_error("no room for new connection");
             }
         }
-        else
+        else if(errno == ECONNABORTED || errno == EINTR)
         {
+            // this client is gone but the next ones are still queued
+            status = AcceptStatus::Dropped;
             throw std::runtime_error(std::string("socket accept error: ") + strerror(errno));
         }
+        else if(errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            status = AcceptStatus::Empty;
+            return ERROR;
+        }
+        else
+        {
+            SetSharedError(std::string("socket accept error: ") + strerror(errno), errno);
+            return ERROR;
+        }
     }
     catch(const std::runtime_error &err)
     {
-        SetLastError(err.what());
+        SetSharedError(err.what());
     }
     catch(...)
     {
-        SetLastError("socket listen error");
+        SetSharedError("socket accept error");
     }
 
     return ERROR;
 }
 
+int SocketPool::GetListenSocket() const
+{
+    return GetConnection(MAIN_SOCKET_INDEX)->fd;
+}
+
+bool SocketPool::SetListenSocket(int fd)
+{
+    ClearError();
+
+    // the socket created for this pool is replaced by one that
+    // is already listening, e.g. shared with another pool
+    Connection *conn = GetConnection(MAIN_SOCKET_INDEX);
+    if(conn->fd != (-1))
+    {
+        UnwatchSocket(MAIN_SOCKET_INDEX);
+        close(conn->fd);
+        // the removed io_uring poll still completes, it must not be taken for the new socket
+        conn->generation = (conn->generation + 1) & GENERATION_MASK;
+    }
+
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    conn->fd = fd;
+    conn->events = POLLIN;
+    if(WatchSocket(MAIN_SOCKET_INDEX) == false)
+    {
+        conn->fd = (-1);
+        return false;
+    }
+
+    return true;
+}
+
 bool SocketPool::Connect(const std::string &host, int port)
 {
     ClearError();
 
-    if(m_fds[MAIN_SOCKET_INDEX].fd == (-1))
+    if(GetConnection(MAIN_SOCKET_INDEX)->fd == (-1))
     {
         SetLastError("create main socket first");
         return false;
@@ -361,14 +600,17 @@ bool SocketPool::ConnectTcp(const std::string &host, int port)
         dest_addr.sin_addr = *((struct in_addr *)hostinfo->h_addr);
         memset(&(dest_addr.sin_zero), 0, 8);
 
-        int ret = connect(m_fds[MAIN_SOCKET_INDEX].fd, (struct sockaddr *)&dest_addr, sizeof(struct sockaddr));
+        Connection *conn = GetConnection(MAIN_SOCKET_INDEX);
+        int ret = connect(conn->fd, (struct sockaddr *)&dest_addr, sizeof(struct sockaddr));
 
         if(ret == -1)
         {
             if(errno == EINPROGRESS)
             {
-                m_fds[MAIN_SOCKET_INDEX].events = POLLOUT | POLLERR;
-                ret = poll(&m_fds[MAIN_SOCKET_INDEX], 1, m_connectTimeout);
+                struct pollfd fds = {};
+                fds.fd = conn->fd;
+                fds.events = POLLOUT | POLLERR;
+                ret = poll(&fds, 1, m_connectTimeout);
                 if(ret == 0)
                 {
                     SetLastError(std::string("Socket connecting timeout"));
@@ -381,7 +623,7 @@ bool SocketPool::ConnectTcp(const std::string &host, int port)
                 }
                 else
                 {
-                    if((m_fds[MAIN_SOCKET_INDEX].revents & POLLOUT) == 0)
+                    if((fds.revents & POLLOUT) == 0)
                     {
                         SetLastError(std::string("Socket not available: ") + strerror(errno), errno);
                         throw std::runtime_error(GetLastError());
@@ -399,12 +641,12 @@ bool SocketPool::ConnectTcp(const std::string &host, int port)
 #ifdef WITH_OPENSSL
         if(IsContains(m_options, Options::Ssl))
         {
-            SSL *ssl = m_sslClient[MAIN_SOCKET_INDEX];
+            SSL *ssl = conn->ssl;
             const int status = SSL_connect(ssl);
             if(status <= 0)
             {
                 int errorCode = SSL_get_error(ssl, status);
-                SetLastError(ERR_error_string(errorCode, nullptr));
+                SetLastError(SslContext::GetErrorString());
                 throw std::runtime_error(std::string("SSL connect error: ") + GetLastError());
             }
         }
@@ -441,7 +683,7 @@ bool SocketPool::ConnectUnix(const std::string &host)
         //*addr.sun_path = '\0';
 
         len = static_cast<socklen_t>(__builtin_offsetof(struct sockaddr_un, sun_path) + m_host.length());
-        if(connect(m_fds[MAIN_SOCKET_INDEX].fd, reinterpret_cast<struct sockaddr *>(&addr), len) == (-1))
+        if(connect(GetConnection(MAIN_SOCKET_INDEX)->fd, reinterpret_cast<struct sockaddr *>(&addr), len) == (-1))
         {
             SetLastError(std::string("Socket connecting error: ") + strerror(errno), errno);
             throw std::runtime_error(GetLastError());
@@ -461,399 +703,2569 @@ bool SocketPool::ConnectUnix(const std::string &host)
     return false;
 }
 
-size_t SocketPool::Write(const uint8_t *buffer, size_t size, size_t index)
+size_t SocketPool::Write(const uint8_t *buffer, size_t size, size_t index, uint32_t generation)
 {
-    ClearError();
-    Lock lock(m_writeMutex);
+    struct iovec iov;
+    iov.iov_base = const_cast<uint8_t *>(buffer);
+    iov.iov_len = size;
+    return Write(&iov, 1, index, generation);
+}
 
+size_t SocketPool::Write(const struct iovec *iov, size_t count, size_t index, uint32_t generation)
+{
     size_t total = (-1);
-    try
+    bool congested = false;
+
+    Connection *conn = GetConnection(index);
+    if(conn == nullptr)
     {
-        int fd = m_fds[index].fd;
-        if(fd == (-1))
-        {
-            SetLastError("wrong socket");
-            return (-1);
-        }
+        SetSharedError("wrong socket");
+        return (-1);
+    }
 
-        bool again = false;
+    size_t size = 0;
+    for(size_t i = 0;i < count;i ++)
+    {
+        size += iov[i].iov_len;
+    }
 
-        if(IsContains(m_options, Options::Ssl))
+    {
+        Lock lock(conn->mutex);
+
+        try
         {
-#ifdef WITH_OPENSSL
-            SSL *ssl = m_sslClient[index];
-            total = 0;
-            do
+            // the slot could be released and reused after the caller has looked it up
+            if(conn->fd == (-1) || (generation != ANY_GENERATION && conn->generation != generation))
             {
-                size_t sent = SSL_write(ssl, buffer + total, size - total);
-                if(sent <= 0)
-                {
-                    int errorCode = SSL_get_error(ssl, sent);
-                    if(errorCode == SSL_ERROR_WANT_WRITE)
-                    {
-                        again = true;
-                    }
-                    else
-                    {
-                        SetLastError(ERR_error_string(errorCode, nullptr));
-                        throw std::runtime_error(std::string("get SSL handler error: ") + GetLastError());
-                    }
-                }
-                else
-                {
-                    total += sent;
-                    if(total >= size)
-                    {
-                        again = false;
-                    }
-                    else
-                    {
-                        again = false;
-                    }
-                }
+                throw std::runtime_error("wrong socket");
             }
-            while(again);
-#endif
-        }
-        else
-        {
+            if(conn->closing)
+            {
+                throw std::runtime_error("the connection is closing");
+            }
+
+            // never wait for the socket, what it doesn't accept now is queued
+            // and sent when it becomes writable or when the socket is uncorked
             total = 0;
-            do
+            if(conn->outbound.empty() && conn->corked == 0)
             {
-                size_t sent = send(fd, buffer + total, size - total, MSG_NOSIGNAL);
-                if(sent == ERROR)
+                total = SendSome(conn, iov, count);
+            }
+            if(total < size)
+            {
+                bool wasEmpty = conn->outbound.empty();
+                size_t skip = total;
+                for(size_t i = 0;i < count;i ++)
                 {
-                    if(errno == EAGAIN)
-                    {
-                        again = true;
-                    }
-                    else
+                    if(skip >= iov[i].iov_len)
                     {
-                        throw std::runtime_error(std::string("socket write error: ") + strerror(errno));
+                        skip -= iov[i].iov_len;
+                        continue;
                     }
+                    Enqueue(conn, static_cast<const uint8_t *>(iov[i].iov_base) + skip, iov[i].iov_len - skip);
+                    skip = 0;
                 }
-                else
+                if(wasEmpty && conn->corked == 0 && WatchOutput(conn) == false)
                 {
-                    total += sent;
-                    if(total >= size)
-                    {
-                        again = false;
-                    }
-                    else
-                    {
-                        again = true;
-                    }
+                    throw std::runtime_error(GetSharedError());
+                }
+                total = size;
+                if(conn->congested == false && conn->outboundSize >= m_highWatermark)
+                {
+                    // no more requests are read while the responses pile up
+                    conn->congested = true;
+                    congested = true;
+                    HoldRead(conn, READ_HOLD_CONGESTED);
                 }
             }
-            while(again);
+        }
+        catch(const std::runtime_error &err)
+        {
+            SetSharedError(err.what());
+        }
+        catch(...)
+        {
+            SetSharedError("socket write error");
         }
     }
-    catch(const std::runtime_error &err)
+
+    if(congested && m_congestionCallback != nullptr)
     {
-        SetLastError(err.what());
+        m_congestionCallback(index, true);
     }
-    catch(...)
+
+    return total;
+}
+
+bool SocketPool::Cork(size_t index, uint32_t generation)
+{
+    Connection *conn = GetConnection(index);
+    if(conn == nullptr)
     {
-        SetLastError("socket write error");
+        return false;
     }
 
-    return total;
+    Lock lock(conn->mutex);
+    if(conn->fd == (-1) || conn->closing || (generation != ANY_GENERATION && conn->generation != generation))
+    {
+        return false;
+    }
+
+    conn->corked ++;
+    if(conn->corked == 1 && m_socketOptions.cork)
+    {
+        SetTcpCork(conn, true);
+    }
+    return true;
 }
 
-size_t SocketPool::Read(void *buffer, size_t size, size_t index)
+bool SocketPool::Uncork(size_t index, uint32_t generation)
 {
-    ClearError();
-    ssize_t read = (-1);
+    bool retval = false;
+    bool relieved = false;
 
-    try
+    Connection *conn = GetConnection(index);
+    if(conn == nullptr)
     {
-        int fd = m_fds[index].fd;
-        if(fd == (-1))
+        return false;
+    }
+
+    {
+        Lock lock(conn->mutex);
+        if(conn->fd == (-1) || (generation != ANY_GENERATION && conn->generation != generation))
         {
-            SetLastError("wrong socket");
-            return (-1);
+            return false;
         }
 
-        if(IsContains(m_options, Options::Ssl))
+        if(conn->corked == 0)
         {
-#ifdef WITH_OPENSSL
-            SSL *ssl = m_sslClient[index];
-            if(ssl == nullptr)
-            {
-                SetLastError(ERR_error_string(ERR_get_error(), nullptr));
-                throw std::runtime_error(std::string("get SSL handler error: ") + GetLastError());
-            }
+            return true;
+        }
 
-            read = SSL_read(ssl, buffer, size);
-            if (read <= 0)
-            {
-                int errorCode = SSL_get_error(ssl, read);
-                if (errorCode == SSL_ERROR_WANT_READ)
-                {
-                    read = 0;
-                }
-                else
+        // corks can be nested, what was written while the socket
+        // was corked goes out with as few calls as possible
+        conn->corked --;
+        if(conn->corked > 0)
+        {
+            return true;
+        }
+        retval = SendQueued(conn, relieved);
+        if(relieved)
+        {
+            ReleaseRead(conn, index, READ_HOLD_CONGESTED);
+        }
+        if(retval == true && conn->outbound.empty() == false)
+        {
+            retval = WatchOutput(conn);
+        }
+        if(m_socketOptions.cork)
+        {
+            // pushes out the last partial frame
+            SetTcpCork(conn, false);
+        }
+    }
+
+    if(relieved && m_congestionCallback != nullptr)
+    {
+        m_congestionCallback(index, false);
+    }
+
+    return retval;
+}
+
+bool SocketPool::PauseReading(size_t index, uint32_t generation)
+{
+    Connection *conn = GetConnection(index);
+    if(conn == nullptr)
+    {
+        return false;
+    }
+
+    Lock lock(conn->mutex);
+    if(conn->fd == (-1) || (generation != ANY_GENERATION && conn->generation != generation))
+    {
+        return false;
+    }
+
+    HoldRead(conn, READ_HOLD_PAUSED);
+    return true;
+}
+
+bool SocketPool::ResumeReading(size_t index, uint32_t generation)
+{
+    Connection *conn = GetConnection(index);
+    if(conn == nullptr)
+    {
+        return false;
+    }
+
+    Lock lock(conn->mutex);
+    if(conn->fd == (-1) || (generation != ANY_GENERATION && conn->generation != generation))
+    {
+        return false;
+    }
+
+    ReleaseRead(conn, index, READ_HOLD_PAUSED);
+    return true;
+}
+
+bool SocketPool::IsReadingPaused(size_t index) const
+{
+    Connection *conn = GetConnection(index);
+    return (conn != nullptr && conn->readHolds != 0);
+}
+
+// both must be called with the connection mutex locked
+void SocketPool::HoldRead(Connection *conn, int reason)
+{
+    conn->readHolds |= reason;
+}
+
+void SocketPool::ReleaseRead(Connection *conn, size_t index, int reason)
+{
+    int holds = (conn->readHolds.fetch_and(~reason) & ~reason);
+    if(holds == 0 && conn->readPending.exchange(false))
+    {
+        {
+            Lock lock(m_resumedMutex);
+            m_resumed.emplace_back(index, conn->generation);
+        }
+        Interrupt();
+    }
+    else if(holds == 0 && m_pollMethod == PollMethod::Poll)
+    {
+        // poll() has to watch the socket for POLLIN again
+        Interrupt();
+    }
+}
+
+bool SocketPool::Flush(size_t index)
+{
+    bool retval = true;
+    bool relieved = false;
+
+    Connection *conn = GetConnection(index);
+    if(conn == nullptr)
+    {
+        SetSharedError("wrong socket");
+        return false;
+    }
+
+#ifdef WITH_OPENSSL
+    if(conn->handshakeQueued)
+    {
+        conn->handshakeAgain = true;
+        return true;
+    }
+#endif
+
+    {
+        Lock lock(conn->mutex);
+
+        if(conn->fd == (-1))
+        {
+            SetSharedError("wrong socket");
+            return false;
+        }
+
+#ifdef WITH_OPENSSL
+        if(conn->handshaking)
+        {
+            // the handshake was waiting for the socket to take its data
+            try
+            {
+                if(conn->handshakeWantWrite == false || ContinueHandshake(conn, index) == false)
                 {
-                    SetLastError(ERR_error_string(errorCode, nullptr));
-                    throw std::runtime_error(std::string("SSL read error: ") + GetLastError());
+                    return true;
                 }
             }
+            catch(const std::runtime_error &err)
+            {
+                SetSharedError(err.what());
+                return false;
+            }
+        }
 #endif
+        if(conn->corked == 0)
+        {
+            retval = SendQueued(conn, relieved);
+            if(relieved)
+            {
+                ReleaseRead(conn, index, READ_HOLD_CONGESTED);
+            }
         }
-        else
+    }
+
+    if(relieved && m_congestionCallback != nullptr)
+    {
+        m_congestionCallback(index, false);
+    }
+
+    return retval;
+}
+
+// must be called with the connection mutex locked
+bool SocketPool::SendQueued(Connection *conn, bool &relieved)
+{
+    try
+    {
+        // small blocks are already merged by Enqueue(), so TLS,
+        // which would have to copy them again, sends one at a time
+        struct iovec iov[FLUSH_IOV_COUNT];
+        size_t maxCount = (IsContains(m_options, Options::Ssl) ? 1 : FLUSH_IOV_COUNT);
+        if(conn->ringIo)
+        {
+            TakeRingSent(conn);
+        }
+        while(conn->outbound.empty() == false)
         {
-            bool again = false;
-            do
+            // the sends in flight are completed first, the data
+            // that follows them goes out with the next chain
+            if(conn->ringIo && (conn->ringSends > 0 || conn->ringPollOut))
+            {
+                break;
+            }
+            if(conn->outbound.front().file != (-1))
             {
-                read = recv(fd, buffer, size, MSG_DONTWAIT);
-                if (read < 0)
+                Outbound &entry = conn->outbound.front();
+                size_t size = entry.fileSize;
+                size_t sent = SendFilePart(conn, entry);
+                conn->outboundSent += sent;
+                if(sent < size)
                 {
-                    if (errno == EWOULDBLOCK)
-                    {
-                        again = true;
-                    }
-                    else
+                    if(conn->ringIo && WatchRingOutput(conn) == false)
                     {
-                        throw std::runtime_error(std::string("socket read error: ") + strerror(errno));
+                        throw std::runtime_error(std::string("io_uring poll add error: ") + m_ring.GetLastError());
                     }
+                    break;
+                }
+                close(entry.file);
+                conn->outbound.pop_front();
+                continue;
+            }
+            if(conn->outbound.front().zeroCopy != nullptr)
+            {
+                Outbound &entry = conn->outbound.front();
+                size_t size = entry.zeroCopy->size() - conn->outboundOffset;
+                size_t sent = SendZeroCopy(conn, entry);
+                conn->outboundSize -= sent;
+                conn->outboundSent += sent;
+                if(sent < size)
+                {
+                    conn->outboundOffset += sent;
+                    break;
+                }
+                conn->outboundOffset = 0;
+                conn->outbound.pop_front();
+                continue;
+            }
+
+            size_t count = 0;
+            size_t size = 0;
+            for(auto it = conn->outbound.begin();it != conn->outbound.end() && it->IsData() && count < maxCount;++ it)
+            {
+                size_t offset = (count == 0 ? conn->outboundOffset : 0);
+                iov[count].iov_base = it->data.data() + offset;
+                iov[count].iov_len = it->data.size() - offset;
+                size += iov[count].iov_len;
+                count ++;
+            }
+
+            // a header followed by a file is held back to go out in the same packet
+            auto next = conn->outbound.begin() + count;
+            bool more = (next != conn->outbound.end() && next->IsData() == false);
+
+            if(conn->ringIo)
+            {
+                if(SubmitRingSends(conn, iov, count, more) == false)
+                {
+                    throw std::runtime_error(std::string("io_uring send error: ") + m_ring.GetLastError());
+                }
+                break;
+            }
+
+            size_t sent = SendSome(conn, iov, count, more);
+            conn->outboundSize -= sent;
+            conn->outboundSent += sent;
+            bool full = (sent < size);
+
+            sent += conn->outboundOffset;
+            while(conn->outbound.empty() == false && conn->outbound.front().IsData() && sent >= conn->outbound.front().data.size())
+            {
+                sent -= conn->outbound.front().data.size();
+                conn->outbound.pop_front();
+            }
+            conn->outboundOffset = sent;
+
+            if(full)
+            {
+                break;
+            }
+        }
+
+        if(conn->congested == true && conn->outboundSize <= m_lowWatermark)
+        {
+            conn->congested = false;
+            relieved = true;
+        }
+    }
+    catch(const std::runtime_error &err)
+    {
+        SetSharedError(err.what());
+        return false;
+    }
+    catch(...)
+    {
+        SetSharedError("socket write error");
+        return false;
+    }
+
+    return true;
+}
+
+// must be called with the connection mutex locked, what the linked
+// sends have taken leaves the queue and their error is reported
+void SocketPool::TakeRingSent(Connection *conn)
+{
+    if(conn->ringError != 0)
+    {
+        throw std::runtime_error(std::string("socket write error: ") + strerror(conn->ringError));
+    }
+
+    size_t sent = conn->ringSent;
+    conn->ringSent = 0;
+    conn->outboundSize -= sent;
+    conn->outboundSent += sent;
+    sent += conn->outboundOffset;
+    while(conn->outbound.empty() == false && conn->outbound.front().IsData() && sent >= conn->outbound.front().data.size())
+    {
+        sent -= conn->outbound.front().data.size();
+        conn->outbound.pop_front();
+        if(conn->ringEntries > 0)
+        {
+            conn->ringEntries --;
+        }
+    }
+    conn->outboundOffset = sent;
+    // the sends cancelled after a failed one are sent again by the next chain
+    if(conn->ringSends == 0)
+    {
+        conn->ringEntries = 0;
+    }
+}
+
+// must be called with the connection mutex locked, the blocks stay
+// in the queue and can't be changed until their sends are completed
+bool SocketPool::SubmitRingSends(Connection *conn, const struct iovec *iov, size_t count, bool more)
+{
+    size_t submitted = m_ring.SendAdd(conn->fd, iov, count, MSG_NOSIGNAL | (more ? MSG_MORE : 0),
+                                      RingData(RING_OP_SEND, conn->generation, conn->index));
+    if(submitted == 0)
+    {
+        return false;
+    }
+    conn->ringSends = submitted;
+    conn->ringEntries = submitted;
+
+    // the writers don't wait for the reactor to pass the chain to the kernel
+    return m_ring.Submit();
+}
+
+// must be called with the connection mutex locked, the queue goes on
+// when the socket that didn't take a file or a send is writable again
+bool SocketPool::WatchRingOutput(Connection *conn)
+{
+    if(conn->ringPollOut)
+    {
+        return true;
+    }
+    if(m_ring.PollAdd(conn->fd, POLLOUT, RingData(RING_OP_POLLOUT, conn->generation, conn->index), false) == false)
+    {
+        return false;
+    }
+    conn->ringPollOut = true;
+
+    return m_ring.Submit();
+}
+
+size_t SocketPool::SendFile(int file, off_t offset, size_t size, size_t index, uint32_t generation)
+{
+    size_t total = (-1);
+
+    Connection *conn = GetConnection(index);
+    if(conn == nullptr)
+    {
+        SetSharedError("wrong socket");
+        close(file);
+        return (-1);
+    }
+
+    {
+        Lock lock(conn->mutex);
+
+        try
+        {
+            if(conn->fd == (-1) || (generation != ANY_GENERATION && conn->generation != generation))
+            {
+                throw std::runtime_error("wrong socket");
+            }
+            if(conn->closing)
+            {
+                throw std::runtime_error("the connection is closing");
+            }
+
+            // the file is sent straight from the page cache, or read a record at a time
+            // if it has to be encrypted here, the part the socket doesn't take now is
+            // sent when it is writable, so the file is never kept in memory
+            Outbound entry(file, offset, size);
+            total = 0;
+            if(conn->outbound.empty() && conn->corked == 0)
+            {
+                total = SendFilePart(conn, entry);
+            }
+            if(entry.fileSize > 0)
+            {
+                bool wasEmpty = conn->outbound.empty();
+                conn->outbound.push_back(entry);
+                file = (-1);
+                if(wasEmpty && conn->corked == 0 && WatchOutput(conn) == false)
+                {
+                    throw std::runtime_error(GetSharedError());
                 }
             }
-            while(again);
+            total = size;
+        }
+        catch(const std::runtime_error &err)
+        {
+            SetSharedError(err.what());
+        }
+        catch(...)
+        {
+            SetSharedError("socket sendfile error");
+        }
+    }
+
+    if(file != (-1))
+    {
+        close(file);
+    }
+
+    return total;
+}
+
+bool SocketPool::IsSendFileSupported(size_t index, uint32_t generation) const
+{
+    if(IsContains(m_options, Options::Ssl) == false)
+    {
+        return true;
+    }
+
+#ifdef WITH_KTLS
+    // a TLS connection can take a file only if the kernel encrypts it
+    Connection *conn = GetConnection(index);
+    if(conn != nullptr)
+    {
+        Lock lock(conn->mutex);
+        return (conn->fd != (-1) && (generation == ANY_GENERATION || conn->generation == generation) && conn->ktlsSend);
+    }
+#else
+    (void)index;
+    (void)generation;
+#endif
+
+    return false;
+}
+
+size_t SocketPool::SendFilePart(Connection *conn, Outbound &entry)
+{
+    size_t total = 0;
+    while(entry.fileSize > 0)
+    {
+#ifdef WITH_KTLS
+        if(conn->ktlsSend)
+        {
+            // the kernel builds the records straight from the page cache
+            ERR_clear_error();
+            ossl_ssize_t sent = SSL_sendfile(conn->ssl, entry.file, entry.fileOffset, entry.fileSize, 0);
+            if(sent <= 0)
+            {
+                int errorCode = SSL_get_error(conn->ssl, sent);
+                if(errorCode == SSL_ERROR_WANT_WRITE || errorCode == SSL_ERROR_WANT_READ)
+                {
+                    break;
+                }
+                throw std::runtime_error(std::string("SSL sendfile error: ") + SslContext::GetErrorString());
+            }
+            entry.fileOffset += sent;
+            entry.fileSize -= sent;
+            total += sent;
+            continue;
+        }
+#endif
+#ifdef WITH_OPENSSL
+        if(IsContains(m_options, Options::Ssl))
+        {
+            // a retry after a partial write starts at the same offset,
+            // so OpenSSL gets the same data it has already taken
+            uint8_t buffer[OUTBOUND_BLOCK_SIZE];
+            ssize_t bytes = pread(entry.file, buffer, std::min(entry.fileSize, sizeof(buffer)), entry.fileOffset);
+            if(bytes == ERROR)
+            {
+                throw std::runtime_error(std::string("file read error: ") + strerror(errno));
+            }
+            if(bytes == 0)
+            {
+                throw std::runtime_error("socket sendfile error: the file is shorter than expected");
+            }
+            size_t sent = SendSome(conn, buffer, bytes);
+            entry.fileOffset += sent;
+            entry.fileSize -= sent;
+            total += sent;
+            if(sent < static_cast<size_t>(bytes))
+            {
+                break;
+            }
+            continue;
+        }
+#endif
+        ssize_t sent = sendfile(conn->fd, entry.file, &entry.fileOffset, entry.fileSize);
+        if(sent == ERROR)
+        {
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            throw std::runtime_error(std::string("socket sendfile error: ") + strerror(errno));
+        }
+        if(sent == 0)
+        {
+            throw std::runtime_error("socket sendfile error: the file is shorter than expected");
+        }
+        entry.fileSize -= sent;
+        total += sent;
+    }
+
+    return total;
+}
+
+size_t SocketPool::WriteZeroCopy(ByteArray &data, size_t index, uint32_t generation)
+{
+    size_t total = (-1);
+    bool congested = false;
+    bool relieved = false;
+
+    Connection *conn = GetConnection(index);
+    if(conn == nullptr)
+    {
+        SetSharedError("wrong socket");
+        return (-1);
+    }
+
+    {
+        Lock lock(conn->mutex);
+        if(conn->zeroCopy == false || conn->zeroCopyCopied || data.size() < m_zeroCopyThreshold)
+        {
+            lock.Unlock();
+            return Write(data.data(), data.size(), index, generation);
+        }
+
+        try
+        {
+            if(conn->fd == (-1) || (generation != ANY_GENERATION && conn->generation != generation))
+            {
+                throw std::runtime_error("wrong socket");
+            }
+            if(conn->closing)
+            {
+                throw std::runtime_error("the connection is closing");
+            }
+
+            // the data is taken over since it can't be changed or freed until
+            // the kernel is done with it, even after it has left the queue
+            size_t size = data.size();
+            bool wasEmpty = conn->outbound.empty();
+            conn->outbound.emplace_back(std::make_shared<ByteArray>(std::move(data)));
+            conn->outboundSize += size;
+            if(wasEmpty && conn->corked == 0)
+            {
+                if(SendQueued(conn, relieved) == false)
+                {
+                    throw std::runtime_error(GetSharedError());
+                }
+                if(relieved)
+                {
+                    ReleaseRead(conn, index, READ_HOLD_CONGESTED);
+                }
+                if(conn->outbound.empty() == false && WatchOutput(conn) == false)
+                {
+                    throw std::runtime_error(GetSharedError());
+                }
+            }
+            if(conn->congested == false && conn->outboundSize >= m_highWatermark)
+            {
+                conn->congested = true;
+                congested = true;
+                HoldRead(conn, READ_HOLD_CONGESTED);
+            }
+            total = size;
+        }
+        catch(const std::runtime_error &err)
+        {
+            SetSharedError(err.what());
+        }
+        catch(...)
+        {
+            SetSharedError("socket write error");
+        }
+    }
+
+    if(m_congestionCallback != nullptr && (congested || relieved))
+    {
+        m_congestionCallback(index, congested);
+    }
+
+    return total;
+}
+
+void SocketPool::SetZeroCopyThreshold(size_t threshold)
+{
+    m_zeroCopyThreshold = threshold;
+}
+
+size_t SocketPool::GetZeroCopyThreshold() const
+{
+    return m_zeroCopyThreshold;
+}
+
+// must be called with the connection mutex locked
+size_t SocketPool::SendZeroCopy(Connection *conn, Outbound &entry)
+{
+    const ByteArray &buffer = *entry.zeroCopy;
+    size_t offset = conn->outboundOffset;
+    size_t total = 0;
+    while(offset + total < buffer.size())
+    {
+        const uint8_t *ptr = buffer.data() + offset + total;
+        size_t size = buffer.size() - offset - total;
+#ifdef WITH_ZEROCOPY
+        if(conn->zeroCopyCopied == false)
+        {
+            ssize_t sent = send(conn->fd, ptr, size, MSG_NOSIGNAL | MSG_ZEROCOPY);
+            if(sent != ERROR)
+            {
+                // every successful call gets the next number from the kernel
+                conn->zeroCopyPending.push_back({ conn->zeroCopySeq ++, entry.zeroCopy });
+                total += sent;
+                continue;
+            }
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            if(errno != ENOBUFS)
+            {
+                throw std::runtime_error(std::string("socket write error: ") + strerror(errno));
+            }
+            // too many sends are not completed yet, this part is copied
+        }
+#endif
+        size_t sent = SendSome(conn, ptr, size);
+        total += sent;
+        if(sent < size)
+        {
+            break;
+        }
+    }
+
+    return total;
+}
+
+// reads the notifications from the error queue and releases the buffers
+// of the completed sends. Returns false if the kernel had to copy the data
+bool SocketPool::ReadZeroCopyCompletions(int fd, std::deque<ZeroCopySend> &pending)
+{
+    bool retval = true;
+#ifdef WITH_ZEROCOPY
+    while(true)
+    {
+        char control[128];
+        struct msghdr msg = {};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if(recvmsg(fd, &msg, MSG_ERRQUEUE) == ERROR)
+        {
+            break;
+        }
+
+        for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);cmsg != nullptr;cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if((cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR) &&
+                    (cmsg->cmsg_level != SOL_IPV6 || cmsg->cmsg_type != IPV6_RECVERR))
+            {
+                continue;
+            }
+            auto serr = reinterpret_cast<struct sock_extended_err *>(CMSG_DATA(cmsg));
+            if(serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno != 0)
+            {
+                continue;
+            }
+
+            // the calls from ee_info to ee_data are completed
+            uint32_t from = serr->ee_info;
+            uint32_t to = serr->ee_data;
+            pending.erase(std::remove_if(pending.begin(), pending.end(), [from, to](const ZeroCopySend &send)
+            {
+                return (send.seq >= from && send.seq <= to);
+            }), pending.end());
+            if((serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0)
+            {
+                retval = false;
+            }
+        }
+    }
+#else
+    (void)fd;
+    (void)pending;
+#endif
+    return retval;
+}
+
+// the error event of a socket that sends with MSG_ZEROCOPY usually means
+// only that some sends are completed, it isn't reported as an error then
+void SocketPool::ReapZeroCopy()
+{
+    for(size_t index: m_ready)
+    {
+        Connection *conn = GetConnection(index);
+        if((conn->revents & POLLERR) == 0 || conn->zeroCopy == false)
+        {
+            continue;
+        }
+
+        Lock lock(conn->mutex);
+        if(conn->fd == (-1))
+        {
+            continue;
+        }
+        if(ReadZeroCopyCompletions(conn->fd, conn->zeroCopyPending) == false)
+        {
+            // the kernel copies the data anyway, e.g. on the loopback
+            conn->zeroCopyCopied = true;
+        }
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if(getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &len) != ERROR && error == 0)
+        {
+            conn->revents &= ~POLLERR;
+        }
+    }
+
+    Lock lock(m_zeroCopyLingerMutex);
+    if(m_zeroCopyLinger.empty())
+    {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    for(auto it = m_zeroCopyLinger.begin();it != m_zeroCopyLinger.end();)
+    {
+        ReadZeroCopyCompletions(it->fd, it->pending);
+        if(it->pending.empty() || now >= it->deadline)
+        {
+            close(it->fd);
+            it = m_zeroCopyLinger.erase(it);
+        }
+        else
+        {
+            ++ it;
+        }
+    }
+}
+
+size_t SocketPool::SendSome(Connection *conn, const uint8_t *buffer, size_t size)
+{
+    size_t total = 0;
+
+    if(IsContains(m_options, Options::Ssl))
+    {
+#ifdef WITH_OPENSSL
+        SSL *ssl = conn->ssl;
+        ERR_clear_error();
+        while(total < size)
+        {
+            int sent = SSL_write(ssl, buffer + total, size - total);
+            if(sent <= 0)
+            {
+                int errorCode = SSL_get_error(ssl, sent);
+                if(errorCode == SSL_ERROR_WANT_WRITE || errorCode == SSL_ERROR_WANT_READ)
+                {
+                    break;
+                }
+                throw std::runtime_error(std::string("SSL write error: ") + SslContext::GetErrorString());
+            }
+            total += sent;
+        }
+#endif
+    }
+    else
+    {
+        while(total < size)
+        {
+            ssize_t sent = send(conn->fd, buffer + total, size - total, MSG_NOSIGNAL);
+            if(sent == ERROR)
+            {
+                if(errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    break;
+                }
+                throw std::runtime_error(std::string("socket write error: ") + strerror(errno));
+            }
+            total += sent;
+        }
+    }
+
+    return total;
+}
+
+size_t SocketPool::SendSome(Connection *conn, const struct iovec *iov, size_t count, bool more)
+{
+    if(count == 1 && more == false)
+    {
+        return SendSome(conn, static_cast<const uint8_t *>(iov[0].iov_base), iov[0].iov_len);
+    }
+
+    if(IsContains(m_options, Options::Ssl))
+    {
+        // TLS has no vectored write, the blocks are merged to go out in one record
+        ByteArray buffer;
+        for(size_t i = 0;i < count;i ++)
+        {
+            auto ptr = static_cast<const uint8_t *>(iov[i].iov_base);
+            buffer.insert(buffer.end(), ptr, ptr + iov[i].iov_len);
+        }
+        return SendSome(conn, buffer.data(), buffer.size());
+    }
+
+    std::vector<struct iovec> rest(iov, iov + std::min(count, static_cast<size_t>(IOV_MAX)));
+    size_t first = 0;
+    size_t total = 0;
+    while(first < rest.size())
+    {
+        struct msghdr msg = {};
+        msg.msg_iov = rest.data() + first;
+        msg.msg_iovlen = rest.size() - first;
+        ssize_t sent = sendmsg(conn->fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+        if(sent == ERROR)
+        {
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            throw std::runtime_error(std::string("socket write error: ") + strerror(errno));
+        }
+        total += sent;
+
+        size_t left = sent;
+        while(first < rest.size() && left >= rest[first].iov_len)
+        {
+            left -= rest[first].iov_len;
+            first ++;
+        }
+        if(first < rest.size())
+        {
+            rest[first].iov_base = static_cast<uint8_t *>(rest[first].iov_base) + left;
+            rest[first].iov_len -= left;
+        }
+    }
+
+    return total;
+}
+
+void SocketPool::Enqueue(Connection *conn, const uint8_t *buffer, size_t size)
+{
+    // small writes are merged to not to keep a lot of tiny blocks, but
+    // not into the one the ring is sending since it could be moved
+    if(conn->outbound.empty() == false && conn->outbound.back().IsData() &&
+            conn->outbound.back().data.size() + size <= OUTBOUND_BLOCK_SIZE &&
+            conn->outbound.size() > conn->ringEntries)
+    {
+        ByteArray &block = conn->outbound.back().data;
+        block.insert(block.end(), buffer, buffer + size);
+    }
+    else
+    {
+        conn->outbound.emplace_back(buffer, size);
+    }
+    conn->outboundSize += size;
+}
+
+void SocketPool::SetSharedError(const std::string &error, int errorCode)
+{
+    // the writers and the reactor run in parallel, so the error of the pool is guarded
+    Lock lock(m_errorMutex);
+    SetLastError(error, errorCode);
+}
+
+void SocketPool::ClearSharedError()
+{
+    Lock lock(m_errorMutex);
+    ClearError();
+}
+
+std::string SocketPool::GetSharedError()
+{
+    Lock lock(m_errorMutex);
+    return GetLastError();
+}
+
+// must be called with the connection mutex locked
+bool SocketPool::WatchOutput(Connection *conn)
+{
+    // epoll reports EPOLLOUT by itself, poll() has to be interrupted to
+    // start watching the socket for POLLOUT and the ring is given the queue
+    if(conn->ringIo)
+    {
+        bool relieved = false;
+        return SendQueued(conn, relieved);
+    }
+    if(m_pollMethod == PollMethod::Poll)
+    {
+        Interrupt();
+    }
+    return true;
+}
+
+void SocketPool::Interrupt()
+{
+    if(m_wakeup != (-1))
+    {
+        uint64_t value = 1;
+        if(write(m_wakeup, &value, sizeof(value)) == ERROR)
+        {
+            // the counter is already signaled
+        }
+    }
+}
+
+void SocketPool::ResetWakeup()
+{
+    uint64_t value;
+    if(read(m_wakeup, &value, sizeof(value)) == ERROR)
+    {
+        // nothing to reset
+    }
+}
+
+size_t SocketPool::Read(void *buffer, size_t size, size_t index)
+{
+    ssize_t read = (-1);
+
+    try
+    {
+        Connection *conn = GetConnection(index);
+        int fd = (conn == nullptr ? (-1) : conn->fd);
+        if(fd == (-1))
+        {
+            SetSharedError("wrong socket");
+            return (-1);
+        }
+
+        if(conn->ringIo)
+        {
+            // the data was already received by the ring
+            Lock lock(conn->mutex);
+            read = std::min(size, conn->ringInput.size());
+            memcpy(buffer, conn->ringInput.data(), read);
+            conn->ringInput.erase(conn->ringInput.begin(), conn->ringInput.begin() + read);
+            if(read == 0 && size > 0 && conn->readClosed)
+            {
+                throw std::runtime_error("connection closed by peer");
+            }
+        }
+        else if(IsContains(m_options, Options::Ssl))
+        {
+#ifdef WITH_OPENSSL
+            if(conn->handshakeQueued)
+            {
+                conn->handshakeAgain = true;
+                return 0;
+            }
+
+            Lock lock(conn->mutex);
+            SSL *ssl = conn->ssl;
+            if(ssl == nullptr)
+            {
+                throw std::runtime_error(std::string("get SSL handler error: ") + SslContext::GetErrorString());
+            }
+
+            if(conn->handshaking && ContinueHandshake(conn, index) == false)
+            {
+                return 0;
+            }
+
+            // SSL_get_error() looks at the error queue of the thread, which could
+            // keep an error of another connection handled by this thread before
+            ERR_clear_error();
+            read = SSL_read(ssl, buffer, size);
+            if (read <= 0)
+            {
+                int errorCode = SSL_get_error(ssl, read);
+                if (errorCode == SSL_ERROR_WANT_READ || errorCode == SSL_ERROR_WANT_WRITE)
+                {
+                    read = 0;
+                }
+                else
+                {
+                    conn->readClosed = (errorCode == SSL_ERROR_ZERO_RETURN);
+                    throw std::runtime_error(std::string("SSL read error: ") + SslContext::GetErrorString());
+                }
+            }
+#endif
+        }
+        else
+        {
+            read = recv(fd, buffer, size, MSG_DONTWAIT);
+            if(read < 0)
+            {
+                if(errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    read = 0; // nothing to read, wait for the next poll event
+                }
+                else
+                {
+                    throw std::runtime_error(std::string("socket read error: ") + strerror(errno));
+                }
+            }
+            else if(read == 0 && size > 0)
+            {
+                conn->readClosed = true;
+                throw std::runtime_error("connection closed by peer");
+            }
+        }
+    }
+    catch(const std::runtime_error &err)
+    {
+        SetSharedError(err.what());
+        read = ERROR;
+    }
+    catch(...)
+    {
+        SetSharedError("socket read error");
+        read = ERROR;
+    }
+
+    return read;
+}
+
+size_t SocketPool::Read(ByteArray &data, size_t index, bool &closed)
+{
+    closed = false;
+    Connection *conn = GetConnection(index);
+    if(conn == nullptr)
+    {
+        SetSharedError("wrong socket");
+        return (-1);
+    }
+
+    // the data stays in the socket and the peer is slowed down by TCP, the
+    // flag is checked again in case the hold was released in the meantime
+    if(conn->readHolds != 0)
+    {
+        conn->readPending = true;
+        if(conn->readHolds != 0 || conn->readPending.exchange(false) == false)
+        {
+            // the ring would go on receiving, it's stopped and armed again on resume
+            if(conn->ringIo && conn->ringRecvArmed)
+            {
+                m_ring.Cancel(RingData(RING_OP_RECV, conn->generation, index));
+            }
+            return 0;
+        }
+    }
+
+    if(conn->ringIo)
+    {
+        // the buffer the ring has received into is passed as is
+        Lock lock(conn->mutex);
+        size_t total = conn->ringInput.size();
+        if(data.empty())
+        {
+            data.swap(conn->ringInput);
+        }
+        else
+        {
+            data.insert(data.end(), conn->ringInput.begin(), conn->ringInput.end());
+            conn->ringInput.clear();
+        }
+        if(conn->readClosed)
+        {
+            HoldRead(conn, READ_HOLD_CLOSED);
+            closed = true;
+        }
+        else if(conn->ringRecvArmed == false)
+        {
+            if(m_ring.RecvAdd(conn->fd, RingData(RING_OP_RECV, conn->generation, index)) == false)
+            {
+                SetSharedError(std::string("io_uring recv error: ") + m_ring.GetLastError());
+                return (-1);
+            }
+            conn->ringRecvArmed = true;
+        }
+        return total;
+    }
+
+    // the socket is drained right into the buffer that goes to the caller.
+    // A read that fills the whole room means there is more to come, so the
+    // room grows, and the size that took the data for this event is
+    // remembered to start with it next time
+    size_t room = conn->readSize;
+    size_t total = 0;
+    data.reserve(data.size() + room);
+    while(true)
+    {
+        size_t offset = data.size();
+        data.resize(offset + room);
+        size_t read = Read(data.data() + offset, room, index);
+        if(read == static_cast<size_t>(ERROR))
+        {
+            data.resize(offset);
+            if(conn->readClosed == false)
+            {
+                return (-1);
+            }
+            // the peer only shut down its side and may still wait for the responses,
+            // what came before is returned and the socket isn't read anymore
+            Lock lock(conn->mutex);
+            HoldRead(conn, READ_HOLD_CLOSED);
+            closed = true;
+            break;
+        }
+        data.resize(offset + read);
+        if(read == 0)
+        {
+            break;
+        }
+
+        total += read;
+        if(read == room)
+        {
+            room = std::min(room * 2, static_cast<size_t>(MAX_READ_BUFFER_SIZE));
+        }
+    }
+
+    if(total >= conn->readSize)
+    {
+        conn->readSize = room;
+    }
+    else if(total < conn->readSize / 4)
+    {
+        // the connection sends less than it used to, give the memory back
+        conn->readSize = std::max(conn->readSize / 2, static_cast<size_t>(MIN_READ_BUFFER_SIZE));
+    }
+
+    return total;
+}
+
+void SocketPool::SetPollRead()
+{
+    Lock lock(m_tableMutex);
+    for(size_t i = 0;i < m_used;i ++)
+    {
+        GetConnection(i)->events = POLLIN;
+    }
+}
+
+void SocketPool::SetPollWrite()
+{
+    Lock lock(m_tableMutex);
+    for(size_t i = 0;i < m_used;i ++)
+    {
+        GetConnection(i)->events = POLLOUT;
+    }
+}
+
+bool SocketPool::Poll()
+{
+    m_ready.clear();
+
+    if(m_pollMethod == PollMethod::Epoll && m_epoll != (-1))
+    {
+        int count = epoll_wait(m_epoll, m_events, static_cast<int>(std::min(m_capacity, static_cast<size_t>(EPOLL_MAX_EVENTS))), POLL_TIMEOUT);
+        for(int i = 0;i < count;i ++)
+        {
+            if(m_events[i].data.u64 == WAKEUP_EVENT_DATA)
+            {
+                ResetWakeup();
+                continue;
+            }
+            size_t index = static_cast<uint32_t>(m_events[i].data.u64);
+            uint32_t generation = static_cast<uint32_t>(m_events[i].data.u64 >> 32);
+            Connection *conn = GetConnection(index);
+            // the event could belong to a connection closed in the meantime
+            if(conn != nullptr && conn->fd != (-1) && conn->generation == generation)
+            {
+                uint32_t ev = m_events[i].events;
+                short revents = 0;
+                if(ev & (EPOLLIN | EPOLLRDHUP))
+                {
+                    revents |= POLLIN;
+                }
+                if(ev & EPOLLOUT)
+                {
+                    revents |= POLLOUT;
+                }
+                if(ev & EPOLLERR)
+                {
+                    revents |= POLLERR;
+                }
+                if(ev & EPOLLHUP)
+                {
+                    revents |= POLLHUP;
+                }
+                conn->revents = revents;
+                m_ready.push_back(index);
+            }
+        }
+
+        CollectDeferred();
+        ReapZeroCopy();
+        return (m_ready.empty() == false);
+    }
+
+    if(m_pollMethod == PollMethod::IoUring && m_ring.IsInitialized())
+    {
+        return PollIoUring();
+    }
+
+    m_pollFds.clear();
+    m_pollIndexes.clear();
+    m_pollGenerations.clear();
+    {
+        Lock lock(m_tableMutex);
+        for(size_t i = 0;i < m_used;i ++)
+        {
+            Connection *conn = GetConnection(i);
+#ifdef WITH_OPENSSL
+            // not to wait for the pool thread, the socket is
+            // watched again when the handshake step is over
+            if(conn->handshakeQueued)
+            {
+                continue;
+            }
+#endif
+            Lock connLock(conn->mutex);
+            if(conn->fd != (-1))
+            {
+                struct pollfd fds = {};
+                fds.fd = conn->fd;
+                fds.events = conn->events;
+                if(conn->readHolds != 0)
+                {
+                    fds.events &= ~POLLIN;
+                }
+                if(conn->outbound.empty() == false && conn->corked == 0)
+                {
+                    fds.events |= POLLOUT;
+                }
+#ifdef WITH_OPENSSL
+                if(conn->handshakeWantWrite)
+                {
+                    fds.events |= POLLOUT;
+                }
+#endif
+                m_pollFds.push_back(fds);
+                m_pollIndexes.push_back(i);
+                m_pollGenerations.push_back(conn->generation);
+            }
+        }
+    }
+
+    // the wakeup descriptor is the last one and has no slot
+    size_t count = m_pollFds.size();
+    if(m_wakeup != (-1))
+    {
+        struct pollfd fds = {};
+        fds.fd = m_wakeup;
+        fds.events = POLLIN;
+        m_pollFds.push_back(fds);
+    }
+
+    auto retval = poll(m_pollFds.data(), m_pollFds.size(), POLL_TIMEOUT);
+    if(retval > 0)
+    {
+        if(m_wakeup != (-1) && m_pollFds[count].revents != 0)
+        {
+            ResetWakeup();
+        }
+        for(size_t i = 0;i < count;i ++)
+        {
+            if(m_pollFds[i].revents != 0)
+            {
+                // the connection could be closed by another thread while polling,
+                // its POLLNVAL must not be taken for the one that reuses the slot
+                Connection *conn = GetConnection(m_pollIndexes[i]);
+                if(conn->fd == m_pollFds[i].fd && conn->generation == m_pollGenerations[i])
+                {
+                    conn->revents = m_pollFds[i].revents;
+                    m_ready.push_back(m_pollIndexes[i]);
+                }
+            }
+        }
+    }
+
+    CollectDeferred();
+    ReapZeroCopy();
+    return (m_ready.empty() == false);
+}
+
+const std::vector<size_t> &SocketPool::GetReadyList() const
+{
+    return m_ready;
+}
+
+bool SocketPool::HasData(size_t index) const
+{
+    Connection *conn = GetConnection(index);
+    return (conn != nullptr && (conn->revents & POLLIN) == POLLIN);
+}
+
+bool SocketPool::IsWritable(size_t index) const
+{
+    Connection *conn = GetConnection(index);
+    return (conn != nullptr && (conn->revents & POLLOUT) == POLLOUT);
+}
+
+bool SocketPool::IsPollError(size_t index) const
+{
+    Connection *conn = GetConnection(index);
+    if(conn == nullptr)
+    {
+        return true;
+    }
+
+    auto ev = conn->revents;
+    if((ev & (POLLERR | POLLNVAL)) != 0)
+    {
+        return true;
+    }
+    // the peer hung up, but the remaining data should be read first
+    return ((ev & POLLHUP) == POLLHUP && (ev & POLLIN) == 0);
+}
+
+bool SocketPool::IsActive(size_t index) const
+{
+    Connection *conn = GetConnection(index);
+    return (conn != nullptr && conn->fd != (-1));
+}
+
+uint32_t SocketPool::GetGeneration(size_t index) const
+{
+    Connection *conn = GetConnection(index);
+    return (conn == nullptr ? 0 : conn->generation);
+}
+
+void SocketPool::SetPollMethod(PollMethod method)
+{
+    // io_uring can be disabled or too old in the running kernel
+    if(method == PollMethod::IoUring && IoUring::IsSupported() == false)
+    {
+        method = PollMethod::Epoll;
+    }
+    m_pollMethod = method;
+}
+
+SocketPool::PollMethod SocketPool::GetPollMethod() const
+{
+    return m_pollMethod;
+}
+
+void SocketPool::SetWriteWatermarks(size_t high, size_t low)
+{
+    m_highWatermark = high;
+    m_lowWatermark = (low > high ? high : low);
+}
+
+bool SocketPool::IsCongested(size_t index) const
+{
+    Connection *conn = GetConnection(index);
+    return (conn != nullptr && conn->congested);
+}
+
+bool SocketPool::GetWriteProgress(size_t index, uint32_t generation, bool &pending, uint64_t &sent) const
+{
+    Connection *conn = GetConnection(index);
+    if(conn == nullptr)
+    {
+        return false;
+    }
+
+    Lock lock(conn->mutex);
+    if(conn->fd == (-1) || conn->generation != generation)
+    {
+        return false;
+    }
+    pending = (conn->outbound.empty() == false);
+    sent = conn->outboundSent;
+
+    return true;
+}
+
+void SocketPool::SetCongestionCallback(const std::function<void(size_t, bool)> &callback)
+{
+    m_congestionCallback = callback;
+}
+
+bool SocketPool::CloseAfterSend(size_t index, uint32_t generation, int timeout)
+{
+    Connection *conn = GetConnection(index);
+    if(conn == nullptr)
+    {
+        return false;
+    }
+
+    {
+        Lock lock(conn->mutex);
+        if(conn->fd == (-1) || (generation != ANY_GENERATION && conn->generation != generation))
+        {
+            return false;
+        }
+        if(conn->closing)
+        {
+            return true;
+        }
+
+        // nothing is read or written anymore, what is already
+        // queued goes out even if the socket was corked
+        conn->closing = true;
+        HoldRead(conn, READ_HOLD_CLOSING);
+        if(conn->corked > 0)
+        {
+            conn->corked = 0;
+            if(m_socketOptions.cork)
+            {
+                SetTcpCork(conn, false);
+            }
+        }
+        bool relieved = false;
+        SendQueued(conn, relieved);
+        generation = conn->generation;
+    }
+
+    {
+        Lock lock(m_closingMutex);
+        m_closing.push_back({ index, generation, std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout) });
+    }
+    // the reactor closes the socket, at once if nothing is left to send
+    Interrupt();
+
+    return true;
+}
+
+const std::vector<size_t> &SocketPool::GetDrainedSockets()
+{
+    m_drained.clear();
+
+    Lock lock(m_closingMutex);
+    if(m_closing.empty())
+    {
+        return m_drained;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    for(auto it = m_closing.begin();it != m_closing.end();)
+    {
+        Connection *conn = GetConnection(it->index);
+        bool active;
+        bool drained;
+        {
+            Lock connLock(conn->mutex);
+            active = (conn->fd != (-1) && conn->generation == it->generation);
+            drained = conn->outbound.empty();
+        }
+        if(active && drained == false && it->deadline > now)
+        {
+            ++it;
+            continue;
+        }
+        if(active)
+        {
+            m_drained.push_back(it->index);
+        }
+        it = m_closing.erase(it);
+    }
+
+    return m_drained;
+}
+
+void SocketPool::SetPort(int port)
+{
+    m_port = port;
+}
+
+int SocketPool::GetPort() const
+{
+    return m_port;
+}
+
+void SocketPool::SetHost(const std::string &host)
+{
+    m_host = host;
+}
+
+std::string SocketPool::GetHost() const
+{
+    return m_host;
+}
+
+size_t SocketPool::GetCount() const
+{
+    return m_count;
+}
+
+size_t SocketPool::GetCapacity() const
+{
+    return m_capacity;
+}
+
+int SocketPool::GetConnectTimeout() const
+{
+    return m_connectTimeout;
+}
+
+void SocketPool::SetConnectTimeout(int timeout)
+{
+    m_connectTimeout = timeout;
+}
+
+const SocketPool::SocketOptions &SocketPool::GetSocketOptions() const
+{
+    return m_socketOptions;
+}
+
+void SocketPool::SetSocketOptions(const SocketOptions &options)
+{
+    m_socketOptions = options;
+}
+
+int SocketPool::GetHandshakeTimeout() const
+{
+    return m_handshakeTimeout;
+}
+
+void SocketPool::SetHandshakeTimeout(int timeout)
+{
+    m_handshakeTimeout = timeout;
+}
+
+SocketPool::HandshakeStats SocketPool::GetHandshakeStats() const
+{
+    Lock lock(m_statsMutex);
+    return m_handshakeStats;
+}
+
+const std::vector<size_t> &SocketPool::GetExpiredHandshakes()
+{
+    m_expired.clear();
+
+#ifdef WITH_OPENSSL
+    if(m_handshakes.empty())
+    {
+        return m_expired;
+    }
+
+    // all the handshakes have the same timeout, so the list is ordered
+    // by the deadline and only its head has to be looked at
+    auto now = std::chrono::steady_clock::now();
+    while(m_handshakes.empty() == false)
+    {
+        const PendingHandshake &pending = m_handshakes.front();
+        Connection *conn = GetConnection(pending.index);
+        bool active;
+        {
+            Lock lock(conn->mutex);
+            active = (conn->fd != (-1) && conn->generation == pending.generation && conn->handshaking);
+        }
+        if(active && pending.deadline > now)
+        {
+            break;
+        }
+        if(active)
+        {
+            m_expired.push_back(pending.index);
+            Lock lock(m_statsMutex);
+            m_handshakeStats.timedOut ++;
+        }
+        m_handshakes.pop_front();
+    }
+#endif
+
+    return m_expired;
+}
+
+int SocketPool::GetListenBacklog() const
+{
+    return m_listenBacklog;
+}
+
+void SocketPool::SetListenBacklog(int backlog)
+{
+    m_listenBacklog = (backlog <= 0 ? DEFAULT_LISTEN_BACKLOG : backlog);
+}
+
+std::string SocketPool::GetRemoteAddress(size_t index) const
+{
+    Connection *conn = GetConnection(index);
+    int fd = (conn == nullptr ? (-1) : conn->fd);
+    if(fd == (-1))
+    {
+        return "";
+    }
+
+    if(m_domain == Domain::Local)
+    {
+        // the peers of a local socket are usually unnamed
+        return "unix:" + m_host;
+    }
+
+    struct sockaddr_in client_sockaddr = {};
+    socklen_t len = sizeof(client_sockaddr);
+    std::string remote;
+    if (getpeername(fd, reinterpret_cast<struct sockaddr *>(&client_sockaddr), &len ) != ERROR)
+    {
+        return std::string(inet_ntoa(client_sockaddr.sin_addr)) + ":" + std::to_string(ntohs(client_sockaddr.sin_port));
+    }
+
+    return "";
+}
+
+std::string SocketPool::ToString() const
+{
+    return std::string("SocketPool: " +
+                       Service2String(m_service) + ", " +
+                       Domain2String(m_domain) + ", "  +
+                       Type2String(m_type) +
+                       std::string(((m_options & Options::Ssl) == Options::Ssl) ? ", Ssl" : "") +
+                       std::string(m_ringIo ? ", io_uring sockets" : ""));
+}
+
+#ifdef WITH_OPENSSL
+void SocketPool::SetSslCredentials(const std::string &cert, const std::string &key)
+{
+    m_cert = cert;
+    m_key = key;
+}
+
+void SocketPool::SetSslContext(const std::shared_ptr<SslContext> &context)
+{
+    m_sslContext = context;
+}
+
+std::shared_ptr<SslContext> SocketPool::GetSslContext() const
+{
+    return m_sslContext;
+}
+
+void SocketPool::SetHandshakePool(ThreadPool *pool)
+{
+    m_handshakePool = pool;
+}
+
+bool SocketPool::InitSSL()
+{
+    // the context could be shared with the other pools of the server
+    // and then it is created and loaded only once
+    if(m_sslContext == nullptr)
+    {
+        m_sslContext = std::make_shared<SslContext>(m_service == Service::Client ? SslContext::Service::Client : SslContext::Service::Server);
+    }
+
+    if(m_sslContext->Init(m_cert, m_key) == false)
+    {
+        SetSharedError(m_sslContext->GetLastError());
+        return false;
+    }
+
+    return true;
+}
+
+bool SocketPool::AcceptSsl(int fd, int index)
+{
+    ClearSharedError();
+
+    try
+    {
+        Connection *conn = GetConnection(index);
+        SSL *ssl = SSL_new(m_sslContext->Get());
+        if(ssl == nullptr)
+        {
+            throw std::runtime_error(std::string("SSL create error: ") + SslContext::GetErrorString());
+        }
+        SSL_set_fd(ssl, fd);
+        SSL_set_accept_state(ssl);
+
+        Lock lock(conn->mutex);
+        conn->ssl = ssl;
+        conn->handshaking = true;
+        conn->handshakeWantWrite = false;
+        conn->handshakeStart = std::chrono::steady_clock::now();
+        if(m_handshakeTimeout > 0)
+        {
+            m_handshakes.push_back({ static_cast<size_t>(index), conn->generation,
+                                     conn->handshakeStart + std::chrono::milliseconds(m_handshakeTimeout) });
+        }
+
+        // the client hello could be here already, otherwise
+        // the handshake goes on when the socket is readable
+        ContinueHandshake(conn, index);
+        return true;
+    }
+    catch(const std::runtime_error &err)
+    {
+        SetSharedError(err.what());
+    }
+    catch(...)
+    {
+        SetSharedError("SSL socket accept error");
+    }
+
+    return false;
+}
+
+// must be called with the connection mutex locked, returns
+// true when the handshake is over and throws if it fails
+bool SocketPool::Handshake(Connection *conn)
+{
+    ERR_clear_error();
+    int ret = SSL_do_handshake(conn->ssl);
+    if(ret == 1)
+    {
+        conn->handshaking = false;
+        conn->handshakeWantWrite = false;
+        uint64_t time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - conn->handshakeStart).count();
+#ifdef WITH_KTLS
+        conn->ktlsSend = (BIO_get_ktls_send(SSL_get_wbio(conn->ssl)) != 0);
+#endif
+        Lock lock(m_statsMutex);
+        if(conn->ktlsSend)
+        {
+            m_handshakeStats.ktls ++;
+        }
+        if(SSL_session_reused(conn->ssl))
+        {
+            m_handshakeStats.resumed ++;
+        }
+        else
+        {
+            m_handshakeStats.full ++;
+        }
+        m_handshakeStats.totalTime += time;
+        m_handshakeStats.maxTime = std::max(m_handshakeStats.maxTime, time);
+        return true;
+    }
+
+    int errorCode = SSL_get_error(conn->ssl, ret);
+    if(errorCode == SSL_ERROR_WANT_READ)
+    {
+        conn->handshakeWantWrite = false;
+        return false;
+    }
+    if(errorCode == SSL_ERROR_WANT_WRITE)
+    {
+        // poll() has to watch the socket for POLLOUT now
+        conn->handshakeWantWrite = true;
+        WatchOutput(conn);
+        return false;
+    }
+
+    {
+        Lock lock(m_statsMutex);
+        m_handshakeStats.failed ++;
+    }
+    throw std::runtime_error(std::string("SSL handshake error: ") + SslContext::GetErrorString());
+}
+
+// must be called with the connection mutex locked, the key exchange is passed to
+// the handshake pool if there is one so the reactor goes on with the other sockets
+bool SocketPool::ContinueHandshake(Connection *conn, size_t index)
+{
+    if(m_handshakePool == nullptr)
+    {
+        return Handshake(conn);
+    }
+
+    conn->handshakeQueued = true;
+    conn->handshakeAgain = false;
+    if(m_handshakePool->Post(std::bind(&SocketPool::HandshakeTask, this, index, conn->generation)) == false)
+    {
+        conn->handshakeQueued = false;
+        return Handshake(conn);
+    }
+
+    return false;
+}
+
+void SocketPool::HandshakeTask(size_t index, uint32_t generation)
+{
+    Connection *conn = GetConnection(index);
+    HandshakeResult result = { index, generation, HandshakeState::Pending };
+
+    {
+        Lock lock(conn->mutex);
+        if(conn->fd == (-1) || conn->generation != generation || conn->handshakeQueued == false)
+        {
+            return;
+        }
+
+        try
+        {
+            if(Handshake(conn))
+            {
+                result.state = HandshakeState::Done;
+            }
+        }
+        catch(const std::runtime_error &err)
+        {
+            SetSharedError(err.what());
+            result.state = HandshakeState::Failed;
+        }
+        conn->handshakeQueued = false;
+    }
+
+    {
+        Lock lock(m_handshakeResultsMutex);
+        m_handshakeResults.push_back(result);
+    }
+    Interrupt();
+}
+#endif
+
+// the connections whose handshake step was done by the pool threads and the ones
+// whose reading was resumed are passed to the reactor as if they were ready, since
+// the edge triggered poll reports nothing about the data that came meanwhile
+void SocketPool::CollectDeferred()
+{
+    std::vector<std::pair<size_t, uint32_t>> resumed;
+    {
+        Lock lock(m_resumedMutex);
+        resumed.swap(m_resumed);
+    }
+
+    for(auto &item: resumed)
+    {
+        Connection *conn = GetConnection(item.first);
+        if(conn->fd == (-1) || conn->generation != item.second)
+        {
+            continue;
+        }
+        if(std::find(m_ready.begin(), m_ready.end(), item.first) == m_ready.end())
+        {
+            conn->revents = POLLIN;
+            m_ready.push_back(item.first);
+        }
+        else
+        {
+            conn->revents |= POLLIN;
+        }
+    }
+
+#ifdef WITH_OPENSSL
+    if(m_handshakePool == nullptr)
+    {
+        return;
+    }
+
+    std::vector<HandshakeResult> results;
+    {
+        Lock lock(m_handshakeResultsMutex);
+        results.swap(m_handshakeResults);
+    }
+
+    for(auto &result: results)
+    {
+        Connection *conn = GetConnection(result.index);
+        if(conn->fd == (-1) || conn->generation != result.generation)
+        {
+            continue;
+        }
+
+        short revents = 0;
+        if(result.state == HandshakeState::Failed)
+        {
+            revents = POLLERR;
+        }
+        else if(result.state == HandshakeState::Done || conn->handshakeAgain.exchange(false))
+        {
+            revents = POLLIN;
+        }
+        if(revents == 0)
+        {
+            continue;
+        }
+
+        if(std::find(m_ready.begin(), m_ready.end(), result.index) == m_ready.end())
+        {
+            conn->revents = revents;
+            m_ready.push_back(result.index);
+        }
+        else
+        {
+            conn->revents |= revents;
         }
     }
-    catch(const std::runtime_error &err)
+#endif
+}
+
+bool SocketPool::ApplyListenOptions(int fd)
+{
+    const SocketOptions &opt = m_socketOptions;
+    // the buffers are set before listen() since the window
+    // scale of the accepted connections depends on them
+    if(opt.receiveBuffer > 0 && setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &opt.receiveBuffer, sizeof(opt.receiveBuffer)) == ERROR)
     {
-        SetLastError(err.what());
+        SetLastError(std::string("set receive buffer error: ") + strerror(errno), errno);
+        return false;
     }
-    catch(...)
+    if(opt.sendBuffer > 0 && setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &opt.sendBuffer, sizeof(opt.sendBuffer)) == ERROR)
     {
-        SetLastError("socket read error");
+        SetLastError(std::string("set send buffer error: ") + strerror(errno), errno);
+        return false;
     }
 
-    return read;
-}
+    if(m_domain != Domain::Inet)
+    {
+        return true;
+    }
 
-void SocketPool::SetPollRead()
-{
-    for(size_t i = 0;i < m_count;i ++)
+    if(opt.deferAccept > 0 && setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &opt.deferAccept, sizeof(opt.deferAccept)) == ERROR)
+    {
+        SetLastError(std::string("set deferred accept error: ") + strerror(errno), errno);
+        return false;
+    }
+    if(opt.fastOpen > 0 && setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &opt.fastOpen, sizeof(opt.fastOpen)) == ERROR)
     {
-        m_fds[i].events = POLLIN;
+        SetLastError(std::string("set fast open error: ") + strerror(errno), errno);
+        return false;
     }
+
+    return true;
 }
 
-void SocketPool::SetPollWrite()
+bool SocketPool::ApplyConnectionOptions(int fd)
 {
-    for(size_t i = 0;i < m_count;i ++)
+    const SocketOptions &opt = m_socketOptions;
+    if(m_domain != Domain::Inet)
     {
-        m_fds[i].events = POLLOUT;
+        return true;
     }
-}
 
-bool SocketPool::Poll()
-{
-    auto retval = poll(m_fds, m_count, POLL_TIMEOUT);
-    return (retval > 0);
-}
+    int on = 1;
+    if(opt.noDelay && setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) == ERROR)
+    {
+        SetSharedError(std::string("set no delay error: ") + strerror(errno), errno);
+        return false;
+    }
 
-bool SocketPool::HasData(size_t index) const
-{
-    return (m_fds[index].revents == POLLIN);
-}
+    if(opt.keepAlive)
+    {
+        if(setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on)) == ERROR ||
+                (opt.keepAliveIdle > 0 && setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &opt.keepAliveIdle, sizeof(opt.keepAliveIdle)) == ERROR) ||
+                (opt.keepAliveInterval > 0 && setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &opt.keepAliveInterval, sizeof(opt.keepAliveInterval)) == ERROR) ||
+                (opt.keepAliveCount > 0 && setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &opt.keepAliveCount, sizeof(opt.keepAliveCount)) == ERROR))
+        {
+            SetSharedError(std::string("set keepalive error: ") + strerror(errno), errno);
+            return false;
+        }
+    }
 
-bool SocketPool::IsPollError(size_t index) const
-{
-    auto ev = m_fds[index].revents;
-    return ev == POLLERR || ev == POLLHUP || ev == POLLNVAL;
+    return true;
 }
 
-void SocketPool::SetPort(int port)
+bool SocketPool::SetTcpCork(Connection *conn, bool cork)
 {
-    m_port = port;
-}
+    if(m_domain != Domain::Inet)
+    {
+        return true;
+    }
 
-int SocketPool::GetPort() const
-{
-    return m_port;
+    int value = (cork ? 1 : 0);
+    return (setsockopt(conn->fd, IPPROTO_TCP, TCP_CORK, &value, sizeof(value)) != ERROR);
 }
 
-void SocketPool::SetHost(const std::string &host)
+bool SocketPool::WatchSocket(size_t index)
 {
-    m_host = host;
-}
+    switch(m_pollMethod)
+    {
+        case PollMethod::Epoll:
+            return (InitEpoll() && EpollAdd(index));
+        case PollMethod::IoUring:
+            return (InitIoUring() && IoUringAdd(index));
+        default:
+            break;
+    }
 
-std::string SocketPool::GetHost() const
-{
-    return m_host;
+    // poll() collects the sockets on every call
+    return true;
 }
 
-size_t SocketPool::GetCount() const
+void SocketPool::UnwatchSocket(size_t index)
 {
-    return m_count;
+    switch(m_pollMethod)
+    {
+        case PollMethod::Epoll:
+            EpollDelete(index);
+            break;
+        case PollMethod::IoUring:
+            IoUringDelete(index);
+            break;
+        default:
+            break;
+    }
 }
 
-int SocketPool::GetConnectTimeout() const
+bool SocketPool::InitEpoll()
 {
-    return m_connectTimeout;
-}
+    if(m_epoll != (-1))
+    {
+        return true;
+    }
 
-void SocketPool::SetConnectTimeout(int timeout)
-{
-    m_connectTimeout = timeout;
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if(m_epoll == ERROR)
+    {
+        SetLastError(std::string("epoll create error: ") + strerror(errno), errno);
+        return false;
+    }
+
+    m_events = new struct epoll_event[std::min(m_capacity, static_cast<size_t>(EPOLL_MAX_EVENTS))] { };
+
+    // the wakeup descriptor interrupts the wait when a pool thread has a result
+    if(m_wakeup != (-1))
+    {
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = WAKEUP_EVENT_DATA;
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &event);
+    }
+    return true;
 }
 
-std::string SocketPool::GetRemoteAddress(size_t index) const
+bool SocketPool::EpollAdd(size_t index)
 {
-    int fd = m_fds[index].fd;
-    if(fd == (-1))
+    Connection *conn = GetConnection(index);
+    struct epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    if(index != MAIN_SOCKET_INDEX)
     {
-        return "";
+        event.events |= EPOLLOUT;
     }
+    event.data.u64 = (static_cast<uint64_t>(conn->generation) << 32) | static_cast<uint32_t>(index);
 
-    struct sockaddr_in client_sockaddr = {};
-    socklen_t len = sizeof(client_sockaddr);
-    std::string remote;
-    if (getpeername(fd, reinterpret_cast<struct sockaddr *>(&client_sockaddr), &len ) != ERROR)
+    if(epoll_ctl(m_epoll, EPOLL_CTL_ADD, conn->fd, &event) == ERROR)
     {
-        return std::string(inet_ntoa(client_sockaddr.sin_addr)) + ":" + std::to_string(ntohs(client_sockaddr.sin_port));
+        SetSharedError(std::string("epoll add error: ") + strerror(errno), errno);
+        return false;
     }
 
-    return "";
+    return true;
 }
 
-std::string SocketPool::ToString() const
+bool SocketPool::EpollDelete(size_t index)
 {
-    return std::string("SocketPool: " +
-                       Service2String(m_service) + ", " +
-                       Domain2String(m_domain) + ", "  +
-                       Type2String(m_type) +
-                       std::string(((m_options & Options::Ssl) == Options::Ssl) ? ", Ssl" : ""));
+    return (epoll_ctl(m_epoll, EPOLL_CTL_DEL, GetConnection(index)->fd, nullptr) != ERROR);
 }
 
-#ifdef WITH_OPENSSL
-void SocketPool::SetSslCredentials(const std::string &cert, const std::string &key)
+bool SocketPool::InitIoUring()
 {
-    m_cert = cert;
-    m_key = key;
+    if(m_ring.IsInitialized())
+    {
+        return true;
+    }
+
+    if(m_ring.Init(IO_URING_QUEUE_SIZE) == false)
+    {
+        SetLastError(std::string("io_uring init error: ") + m_ring.GetLastError(), m_ring.GetLastErrorCode());
+        return false;
+    }
+
+    if(m_wakeup != (-1))
+    {
+        m_ring.PollAdd(m_wakeup, POLLIN, WAKEUP_EVENT_DATA);
+    }
+
+    // the plain server sockets are read and written by the ring itself where the
+    // kernel can, TLS goes through OpenSSL and stays with the polled sockets
+    m_ringIo = (m_service == Service::Server && IsContains(m_options, Options::Ssl) == false &&
+                IoUring::IsCompletionSupported() && m_ring.InitBuffers());
+    return true;
 }
 
-bool SocketPool::InitSSL()
+bool SocketPool::IoUringAdd(size_t index)
 {
-    bool retval = false;
-    try
+    Connection *conn = GetConnection(index);
+    if(m_ringIo && index == MAIN_SOCKET_INDEX)
     {
-        OpenSSL_add_all_algorithms();
-        SSL_load_error_strings();
-
-        if(m_service == Service::Client)
+        // the multishot accept is armed once the socket is listening
+        conn->ringIo = true;
+        int listening = 0;
+        socklen_t len = sizeof(listening);
+        if(getsockopt(conn->fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) == ERROR || listening == 0)
         {
-            const SSL_METHOD *method = TLS_client_method();
-            m_ctx = SSL_CTX_new(method);
+            return true;
         }
-        else if(m_service == Service::Server)
+        if(m_ring.AcceptAdd(conn->fd, RingData(RING_OP_ACCEPT, conn->generation, index)) == false)
         {
-            const SSL_METHOD *method = TLS_server_method();
-            m_ctx = SSL_CTX_new(method);
+            SetSharedError(std::string("io_uring accept error: ") + m_ring.GetLastError(), m_ring.GetLastErrorCode());
+            return false;
         }
-
-        if(m_ctx == nullptr)
+        return true;
+    }
+    if(conn->ringIo)
+    {
+        // the multishot recv stays armed and receives the data as it comes
+        if(m_ring.RecvAdd(conn->fd, RingData(RING_OP_RECV, conn->generation, index)) == false)
         {
-            SetLastError(ERR_error_string(ERR_get_error(), nullptr));
-            retval = false;
+            SetSharedError(std::string("io_uring recv error: ") + m_ring.GetLastError(), m_ring.GetLastErrorCode());
+            return false;
         }
-        if(m_service == Service::Server)
-        {
-            if (SSL_CTX_use_certificate_file(m_ctx, m_cert.c_str(), SSL_FILETYPE_PEM) <= 0)
-            {
-                SetLastError(ERR_error_string(ERR_get_error(), nullptr));
-                throw std::runtime_error(GetLastError());
-            }
+        conn->ringRecvArmed = true;
+        return true;
+    }
 
-            if (SSL_CTX_use_PrivateKey_file(m_ctx, m_key.c_str(), SSL_FILETYPE_PEM) <= 0 )
-            {
-                SetLastError(ERR_error_string(ERR_get_error(), nullptr));
-                throw std::runtime_error(GetLastError());
-            }
-        }
+    // a multishot poll stays armed and reports every wakeup of
+    // the socket, the same way the edge triggered epoll does
+    uint32_t events = POLLIN | POLLRDHUP;
+    if(index != MAIN_SOCKET_INDEX)
+    {
+        events |= POLLOUT;
+    }
+    uint64_t data = (static_cast<uint64_t>(conn->generation) << 32) | static_cast<uint32_t>(index);
 
-        retval = true;
+    if(m_ring.PollAdd(conn->fd, events, data) == false)
+    {
+        SetSharedError(std::string("io_uring poll add error: ") + m_ring.GetLastError(), m_ring.GetLastErrorCode());
+        return false;
     }
-    catch(const std::runtime_error &err)
+
+    return true;
+}
+
+bool SocketPool::IoUringDelete(size_t index)
+{
+    Connection *conn = GetConnection(index);
+    if(conn->ringIo == false)
     {
-        SetLastError(err.what());
+        return m_ring.PollRemove(RingData(RING_OP_POLL, conn->generation, index));
     }
-    catch(...)
+
+    // the blocks the kernel is still sending are kept until their sends complete,
+    // the connection must be locked by the caller since the writers use them
+    if(conn->ringSends > 0)
     {
-        SetLastError("SSL init error");
+        RingLinger linger = { index, conn->generation, conn->ringSends, {} };
+        for(size_t i = 0;i < conn->ringEntries && conn->outbound.empty() == false;i ++)
+        {
+            linger.outbound.push_back(std::move(conn->outbound.front()));
+            conn->outbound.pop_front();
+        }
+        Lock lock(m_ringLingerMutex);
+        m_ringLinger.push_back(std::move(linger));
     }
 
-    return retval;
+    // all the requests of the socket are cancelled, it's closed once they are gone
+    return m_ring.CancelFd(conn->fd);
 }
 
-bool SocketPool::AcceptSsl(int fd, int index)
+bool SocketPool::PollIoUring()
 {
-    ClearError();
+    if(m_ring.Wait(POLL_TIMEOUT, m_completions) == ERROR)
+    {
+        return false;
+    }
 
-    bool isContinue = true;
-    bool isError = false;
+    // a socket can be reported several times in a batch, so the events
+    // are gathered first and the socket is added to the ready list once
+    for(auto &completion: m_completions)
+    {
+        if(completion.data == WAKEUP_EVENT_DATA)
+        {
+            ResetWakeup();
+            if((completion.flags & IORING_CQE_F_MORE) == 0)
+            {
+                m_ring.PollAdd(m_wakeup, POLLIN, WAKEUP_EVENT_DATA);
+            }
+            completion.data = IO_URING_IGNORE_DATA;
+            continue;
+        }
+        size_t index = static_cast<uint32_t>(completion.data);
+        uint32_t generation = static_cast<uint32_t>((completion.data >> 32) & RING_GENERATION_MASK);
+        Connection *conn = GetConnection(index);
+        if(conn != nullptr && ((conn->fd != (-1) && conn->generation == generation) ||
+                               (completion.data >> RING_OP_SHIFT) == RING_OP_ACCEPT))
+        {
+            conn->revents = 0;
+        }
+    }
 
-    try
+    for(size_t i = 0;i < m_completions.size();i ++)
     {
-        SSL *ssl = nullptr;
-        ssl = SSL_new(m_ctx);
-        SSL_set_fd(ssl, fd);
+        const IoUring::Completion &completion = m_completions[i];
+        if(completion.data == IO_URING_IGNORE_DATA)
+        {
+            continue;
+        }
+
+        int op = static_cast<int>(completion.data >> RING_OP_SHIFT);
+        size_t index = static_cast<uint32_t>(completion.data);
+        uint32_t generation = static_cast<uint32_t>((completion.data >> 32) & RING_GENERATION_MASK);
+        Connection *conn = GetConnection(index);
+        if(conn == nullptr)
+        {
+            continue;
+        }
+        int32_t result = completion.result;
+        bool more = ((completion.flags & IORING_CQE_F_MORE) != 0);
+        short revents = 0;
 
-        while(isContinue)
+        switch(op)
         {
-            int ret = SSL_accept(ssl);
-            if(ret <= 0)
+            case RING_OP_ACCEPT:
+            {
+                // a client is taken even if the listening socket was closed
+                // meanwhile, it's served like the ones accepted before
+                if(result >= 0)
+                {
+                    m_accepted.push_back(result);
+                    revents = POLLIN;
+                }
+                if(more == false && conn->fd != (-1) && conn->generation == generation &&
+                        result != -ECANCELED && result != -EINVAL && result != -EBADF)
+                {
+                    IoUringAdd(index);
+                }
+                break;
+            }
+            case RING_OP_RECV:
+            {
+                const uint8_t *buffer = nullptr;
+                uint16_t bufferId = 0;
+                if((completion.flags & IORING_CQE_F_BUFFER) != 0)
+                {
+                    bufferId = static_cast<uint16_t>(completion.flags >> IORING_CQE_BUFFER_SHIFT);
+                    buffer = m_ring.GetBuffer(bufferId);
+                }
+                {
+                    Lock lock(conn->mutex);
+                    if(conn->fd != (-1) && conn->generation == generation)
+                    {
+                        if(more == false)
+                        {
+                            conn->ringRecvArmed = false;
+                        }
+                        if(result > 0 && buffer != nullptr)
+                        {
+                            conn->ringInput.insert(conn->ringInput.end(), buffer, buffer + result);
+                            revents = POLLIN;
+                        }
+                        else if(result == 0)
+                        {
+                            conn->readClosed = true;
+                            revents = POLLIN;
+                        }
+                        else if(result == -ENOBUFS)
+                        {
+                            // the recv is armed again by the read once the buffers are back
+                            revents = POLLIN;
+                        }
+                        else if(result < 0 && result != -ECANCELED)
+                        {
+                            revents = POLLERR;
+                        }
+                    }
+                }
+                // the buffer is copied out, the kernel can take it again
+                if(buffer != nullptr)
+                {
+                    m_ring.ReturnBuffer(bufferId);
+                }
+                break;
+            }
+            case RING_OP_SEND:
             {
-                int errorCode = SSL_get_error(ssl, ret);
-                if (errorCode == SSL_ERROR_WANT_READ)
+                Lock lock(conn->mutex);
+                if(conn->fd != (-1) && conn->generation == generation)
                 {
-                    isContinue = true;
+                    // the progress is taken by Flush() the reactor calls for POLLOUT
+                    conn->ringSends --;
+                    if(result > 0)
+                    {
+                        conn->ringSent += result;
+                    }
+                    else if(result == -EAGAIN)
+                    {
+                        WatchRingOutput(conn);
+                    }
+                    else if(result < 0 && result != -ECANCELED && conn->ringError == 0)
+                    {
+                        conn->ringError = -result;
+                    }
+                    revents = POLLOUT;
                 }
                 else
                 {
-                    SetLastError(ERR_error_string(errorCode, nullptr));
-                    isContinue = false;
-                    SSL_shutdown(ssl);
-                    SSL_free(ssl);
-                    close(fd);
-                    isError = true;
+                    Lock lingerLock(m_ringLingerMutex);
+                    for(auto it = m_ringLinger.begin();it != m_ringLinger.end();++ it)
+                    {
+                        if(it->index == index && it->generation == generation)
+                        {
+                            if(-- it->pending == 0)
+                            {
+                                m_ringLinger.erase(it);
+                            }
+                            break;
+                        }
+                    }
                 }
+                break;
             }
-            else
+            case RING_OP_POLLOUT:
+            {
+                Lock lock(conn->mutex);
+                if(conn->fd != (-1) && conn->generation == generation)
+                {
+                    conn->ringPollOut = false;
+                    revents = ((result < 0 && result != -ECANCELED) ? POLLERR : POLLOUT);
+                }
+                break;
+            }
+            default:
             {
-                isError = false;
-                isContinue = false;
-                m_sslClient[index] = ssl;
+                // the removed polls and the connections closed in the meantime
+                if(conn->fd == (-1) || conn->generation != generation)
+                {
+                    break;
+                }
+                if(result < 0)
+                {
+                    revents = POLLERR;
+                    break;
+                }
+                if(result & (POLLIN | POLLRDHUP))
+                {
+                    revents |= POLLIN;
+                }
+                revents |= (result & (POLLOUT | POLLERR | POLLHUP));
+                // the kernel ends a multishot poll when it can't post
+                // a completion, the poll has to be armed again
+                if(more == false)
+                {
+                    IoUringAdd(index);
+                }
+                break;
             }
         }
+
+        if(revents != 0 && conn->revents == 0)
+        {
+            m_ready.push_back(index);
+        }
+        conn->revents |= revents;
     }
-    catch(const std::runtime_error &err)
+
+    CollectDeferred();
+    ReapZeroCopy();
+    return (m_ready.empty() == false);
+}
+
+SocketPool::Connection *SocketPool::GetConnection(size_t index) const
+{
+    if(index >= m_capacity)
     {
-        SetLastError(err.what());
+        return nullptr;
     }
-    catch(...)
+
+    Connection *chunk = m_chunks[index / CONNECTION_CHUNK_SIZE];
+    return (chunk == nullptr ? nullptr : &chunk[index % CONNECTION_CHUNK_SIZE]);
+}
+
+int SocketPool::Allocate()
+{
+    Lock lock(m_tableMutex);
+
+    size_t index;
+    if(m_free.empty() == false)
+    {
+        index = m_free.back();
+        m_free.pop_back();
+    }
+    else if(m_used < m_capacity)
+    {
+        index = m_used;
+        Connection *&chunk = m_chunks[index / CONNECTION_CHUNK_SIZE];
+        if(chunk == nullptr)
+        {
+            chunk = new Connection[CONNECTION_CHUNK_SIZE];
+        }
+        m_used ++;
+    }
+    else
     {
-        SetLastError("SSL socket accept error");
+        return ERROR;
     }
 
-    return (isError == false);
+    GetConnection(index)->index = index;
+    m_count ++;
+    return static_cast<int>(index);
 }
-#endif
 
-int SocketPool::FindEmpty()
+// must be called with the table mutex locked
+void SocketPool::Release(size_t index)
 {
-    for(int i = 1;i < m_count;i ++)
+    Connection *conn = GetConnection(index);
+    conn->fd = (-1);
+    conn->events = 0;
+    conn->revents = 0;
+    for(auto &entry: conn->outbound)
     {
-        if(m_fds[i].fd == (-1))
+        if(entry.file != (-1))
         {
-            return i;
+            close(entry.file);
         }
     }
-
-    return ERROR;
+    conn->outbound.clear();
+    conn->outboundOffset = 0;
+    conn->outboundSize = 0;
+    conn->outboundSent = 0;
+    conn->congested = false;
+    conn->corked = 0;
+    conn->closing = false;
+    conn->readSize = DEFAULT_READ_BUFFER_SIZE;
+    conn->readHolds = 0;
+    conn->readPending = false;
+    conn->readClosed = false;
+    conn->zeroCopy = false;
+    conn->zeroCopyCopied = false;
+    conn->zeroCopySeq = 0;
+    conn->zeroCopyPending.clear();
+    conn->ringIo = false;
+    conn->ringRecvArmed = false;
+    conn->ringInput.clear();
+    conn->ringSends = 0;
+    conn->ringEntries = 0;
+    conn->ringSent = 0;
+    conn->ringPollOut = false;
+    conn->ringError = 0;
+#ifdef WITH_OPENSSL
+    conn->handshaking = false;
+    conn->handshakeWantWrite = false;
+    conn->ktlsSend = false;
+    conn->handshakeQueued = false;
+    conn->handshakeAgain = false;
+#endif
+    conn->generation = (conn->generation + 1) & GENERATION_MASK;
+    if(index != MAIN_SOCKET_INDEX)
+    {
+        m_free.push_back(index);
+        m_count --;
+    }
 }
 
 void SocketPool::ParseAddress(const std::string &address)
@@ -950,3 +3362,20 @@ std::string SocketPool::Service2String(Service service)
 
     return "Undefined";
 }
+
+std::string SocketPool::PollMethod2String(PollMethod method)
+{
+    switch(method)
+    {
+        case PollMethod::Poll:
+            return "poll";
+        case PollMethod::Epoll:
+            return "epoll";
+        case PollMethod::IoUring:
+            return "io_uring";
+        default:
+            break;
+    }
+
+    return "Undefined";
+}
@@ -0,0 +1,263 @@
+#ifdef WITH_OPENSSL
+
+#include <openssl/err.h>
+#include <openssl/rand.h>
+#include <openssl/evp.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
+#include <cstring>
+#include <stdexcept>
+#include "SslContext.h"
+#include "Lock.h"
+
+#define SESSION_ID_CONTEXT "WebCpp"
+
+
+using namespace WebCpp;
+
+SslContext::SslContext(Service service):
+    m_service(service)
+{
+}
+
+SslContext::~SslContext()
+{
+    if(m_ctx != nullptr)
+    {
+        SSL_CTX_free(m_ctx);
+        m_ctx = nullptr;
+    }
+}
+
+bool SslContext::Init(const std::string &cert, const std::string &key)
+{
+    ClearError();
+
+    if(m_ctx != nullptr)
+    {
+        return true;
+    }
+
+    try
+    {
+        OpenSSL_add_all_algorithms();
+        SSL_load_error_strings();
+
+        m_ctx = SSL_CTX_new(m_service == Service::Server ? TLS_server_method() : TLS_client_method());
+        if(m_ctx == nullptr)
+        {
+            throw std::runtime_error(GetErrorString());
+        }
+        // the rest of a partially written record is queued and
+        // retried later from the outbound queue of the connection
+        SSL_CTX_set_mode(m_ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+#ifdef WITH_KTLS
+        // OpenSSL hands the keys to the kernel after the handshake if it
+        // can, otherwise the connection silently stays in the userspace
+        if(m_ktls)
+        {
+            SSL_CTX_set_options(m_ctx, SSL_OP_ENABLE_KTLS);
+        }
+#endif
+
+        if(m_service == Service::Server)
+        {
+            if (SSL_CTX_use_certificate_file(m_ctx, cert.c_str(), SSL_FILETYPE_PEM) <= 0)
+            {
+                throw std::runtime_error(GetErrorString());
+            }
+
+            if (SSL_CTX_use_PrivateKey_file(m_ctx, key.c_str(), SSL_FILETYPE_PEM) <= 0 )
+            {
+                throw std::runtime_error(GetErrorString());
+            }
+
+            // a returning client resumes its session either by the session ID
+            // found in the server cache or by a ticket it keeps itself
+            SSL_CTX_set_session_cache_mode(m_ctx, SSL_SESS_CACHE_SERVER);
+            SSL_CTX_set_session_id_context(m_ctx, reinterpret_cast<const unsigned char *>(SESSION_ID_CONTEXT), strlen(SESSION_ID_CONTEXT));
+            SSL_CTX_sess_set_cache_size(m_ctx, m_sessionCacheSize);
+            SSL_CTX_set_timeout(m_ctx, m_ticketKeyLifetime);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            if(CreateTicketKey(m_currentKey) == false)
+            {
+                throw std::runtime_error("SSL ticket key create error");
+            }
+            SSL_CTX_set_ex_data(m_ctx, ExIndex(), this);
+            SSL_CTX_set_tlsext_ticket_key_evp_cb(m_ctx, &SslContext::TicketKeyCallback);
+#endif
+        }
+
+        return true;
+    }
+    catch(const std::runtime_error &err)
+    {
+        SetLastError(err.what());
+    }
+    catch(...)
+    {
+        SetLastError("SSL init error");
+    }
+
+    if(m_ctx != nullptr)
+    {
+        SSL_CTX_free(m_ctx);
+        m_ctx = nullptr;
+    }
+
+    return false;
+}
+
+// ERR_error_string() without a buffer of its own isn't thread safe
+std::string SslContext::GetErrorString()
+{
+    char buffer[256];
+    ERR_error_string_n(ERR_get_error(), buffer, sizeof(buffer));
+    return buffer;
+}
+
+SSL_CTX *SslContext::Get() const
+{
+    return m_ctx;
+}
+
+void SslContext::SetSessionCacheSize(size_t size)
+{
+    m_sessionCacheSize = size;
+}
+
+size_t SslContext::GetSessionCacheSize() const
+{
+    return m_sessionCacheSize;
+}
+
+void SslContext::SetTicketKeyLifetime(int seconds)
+{
+    m_ticketKeyLifetime = (seconds <= 0 ? DEFAULT_SSL_TICKET_KEY_LIFETIME : seconds);
+}
+
+int SslContext::GetTicketKeyLifetime() const
+{
+    return m_ticketKeyLifetime;
+}
+
+void SslContext::SetKtls(bool enable)
+{
+    m_ktls = enable;
+}
+
+bool SslContext::IsKtls() const
+{
+    return m_ktls;
+}
+
+bool SslContext::CreateTicketKey(TicketKey &key)
+{
+    if(RAND_bytes(key.name, sizeof(key.name)) <= 0 ||
+            RAND_bytes(key.aesKey, sizeof(key.aesKey)) <= 0 ||
+            RAND_bytes(key.hmacKey, sizeof(key.hmacKey)) <= 0)
+    {
+        key.valid = false;
+        return false;
+    }
+
+    key.created = std::chrono::steady_clock::now();
+    key.valid = true;
+    return true;
+}
+
+bool SslContext::GetTicketKey(const unsigned char *name, TicketKey &key, bool &current)
+{
+    Lock lock(m_keyMutex);
+
+    if(name == nullptr)
+    {
+        // a new ticket, the key is replaced once it has lived its time
+        if(std::chrono::steady_clock::now() - m_currentKey.created >= std::chrono::seconds(m_ticketKeyLifetime))
+        {
+            TicketKey next;
+            if(CreateTicketKey(next))
+            {
+                m_previousKey = m_currentKey;
+                m_currentKey = next;
+            }
+        }
+        key = m_currentKey;
+        current = true;
+        return m_currentKey.valid;
+    }
+
+    if(m_currentKey.valid && memcmp(name, m_currentKey.name, sizeof(m_currentKey.name)) == 0)
+    {
+        key = m_currentKey;
+        current = true;
+        return true;
+    }
+    if(m_previousKey.valid && memcmp(name, m_previousKey.name, sizeof(m_previousKey.name)) == 0)
+    {
+        key = m_previousKey;
+        current = false;
+        return true;
+    }
+
+    return false;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+int SslContext::TicketKeyCallback(SSL *ssl, unsigned char *name, unsigned char *iv,
+                                  EVP_CIPHER_CTX *cipher, EVP_MAC_CTX *mac, int enc)
+{
+    SslContext *context = static_cast<SslContext *>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ExIndex()));
+    if(context == nullptr)
+    {
+        return (-1);
+    }
+
+    TicketKey key;
+    bool current = true;
+    if(enc == 1)
+    {
+        if(context->GetTicketKey(nullptr, key, current) == false ||
+                RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) <= 0)
+        {
+            return (-1);
+        }
+        memcpy(name, key.name, sizeof(key.name));
+    }
+    else if(context->GetTicketKey(name, key, current) == false)
+    {
+        // unknown or expired key, the client gets a full handshake
+        return 0;
+    }
+
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmacKey, sizeof(key.hmacKey)),
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char *>("SHA256"), 0),
+        OSSL_PARAM_construct_end()
+    };
+    if(EVP_MAC_CTX_set_params(mac, params) == 0)
+    {
+        return (-1);
+    }
+
+    int retval = (enc == 1) ?
+                EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aesKey, iv) :
+                EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aesKey, iv);
+    if(retval == 0)
+    {
+        return (-1);
+    }
+
+    // a ticket of the previous key is accepted and replaced with a new one
+    return current ? 1 : 2;
+}
+#endif
+
+int SslContext::ExIndex()
+{
+    static int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+#endif
@@ -0,0 +1,119 @@
+#include "ThreadPool.h"
+#include "Lock.h"
+
+using namespace WebCpp;
+
+ThreadPool::~ThreadPool()
+{
+    Stop();
+}
+
+void ThreadPool::SetName(const std::string &name)
+{
+    m_name = name;
+}
+
+void ThreadPool::SetAffinity(const std::vector<int> &cpus)
+{
+    m_cpus = cpus;
+}
+
+bool ThreadPool::Start(size_t count)
+{
+    ClearError();
+
+    if(m_running)
+    {
+        return true;
+    }
+
+    m_running = true;
+    for(size_t i = 0;i < count;i ++)
+    {
+        std::unique_ptr<ThreadWorker> thread(new ThreadWorker());
+        thread->SetFunction(std::bind(&ThreadPool::Worker, this, std::placeholders::_1));
+        if(m_name.empty() == false)
+        {
+            thread->SetName(m_name + std::to_string(i));
+        }
+        thread->SetAffinity(m_cpus);
+        if(thread->Start() == false)
+        {
+            SetLastError("failed to start a pool thread: " + thread->GetLastError());
+            Stop();
+            return false;
+        }
+        m_threads.push_back(std::move(thread));
+    }
+
+    return true;
+}
+
+void ThreadPool::Stop()
+{
+    {
+        Lock lock(m_mutex);
+        m_running = false;
+        m_tasks.clear();
+        m_signal.FireAll();
+    }
+
+    for(auto &thread: m_threads)
+    {
+        thread->StopNoWait();
+    }
+    for(auto &thread: m_threads)
+    {
+        thread->Wait();
+    }
+    m_threads.clear();
+}
+
+bool ThreadPool::Post(const Task &task)
+{
+    Lock lock(m_mutex);
+    if(m_running == false)
+    {
+        return false;
+    }
+
+    m_tasks.push_back(task);
+    m_signal.Fire();
+    return true;
+}
+
+size_t ThreadPool::GetCount() const
+{
+    return m_threads.size();
+}
+
+size_t ThreadPool::GetQueueSize()
+{
+    Lock lock(m_mutex);
+    return m_tasks.size();
+}
+
+void *ThreadPool::Worker(bool &)
+{
+    while(true)
+    {
+        Task task;
+        {
+            Lock lock(m_mutex);
+            while(m_running && m_tasks.empty())
+            {
+                m_signal.Wait(m_mutex);
+            }
+            if(m_running == false)
+            {
+                break;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        task();
+    }
+
+    return nullptr;
+}
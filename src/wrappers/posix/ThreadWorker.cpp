@@ -1,3 +1,5 @@
+#include <sched.h>
+#include <cstring>
 #include "ThreadWorker.h"
 
 using namespace WebCpp;
@@ -17,6 +19,17 @@ void ThreadWorker::SetFinishFunction(const std::function<ThreadFinishRoutine> &f
     m_funcFinish = func;
 }
 
+void ThreadWorker::SetName(const std::string &name)
+{
+    // 15 chars plus the terminating zero
+    m_name = name.substr(0, 15);
+}
+
+void ThreadWorker::SetAffinity(const std::vector<int> &cpus)
+{
+    m_cpus = cpus;
+}
+
 bool ThreadWorker::Start()
 {
     if(m_isRunning)
@@ -25,24 +38,44 @@ bool ThreadWorker::Start()
     }
 
     ClearError();
+    Wait();
     m_isRunning = true;
 
-    if(pthread_create(&m_thread, nullptr, ThreadWorker::StartThread, this) != 0)
+    // the thread starts on the CPUs it is pinned to, so whatever
+    // it allocates first is placed on the memory node of them
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if(m_cpus.empty() == false)
     {
-        SetLastError("failed to starting a thread");
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(int cpu: m_cpus)
+        {
+            if(cpu >= 0 && cpu < CPU_SETSIZE)
+            {
+                CPU_SET(cpu, &set);
+            }
+        }
+        pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+    }
+
+    int error = pthread_create(&m_thread, &attr, ThreadWorker::StartThread, this);
+    pthread_attr_destroy(&attr);
+    if(error != 0)
+    {
+        m_isRunning = false;
+        SetLastError(std::string("failed to starting a thread: ") + strerror(error), error);
         return false;
     }
+    m_joinable = true;
 
     return true;
 }
 
 void ThreadWorker::Stop()
 {
-    if(m_isRunning)
-    {
-        m_isRunning = false;
-        pthread_join(m_thread, nullptr);
-    }
+    m_isRunning = false;
+    Wait();
 }
 
 void ThreadWorker::StopNoWait()
@@ -50,10 +83,11 @@ void ThreadWorker::StopNoWait()
     m_isRunning = false;
 }
 
-void ThreadWorker::Wait() const
+void ThreadWorker::Wait()
 {
-    if(m_isRunning)
+    if(m_joinable)
     {
+        m_joinable = false;
         pthread_join(m_thread, nullptr);
     }
 }
@@ -62,6 +96,10 @@ void *ThreadWorker::StartThread(void *cls)
 {
     void *res = nullptr;
     ThreadWorker *instance = static_cast<ThreadWorker *>(cls);
+    if(instance->m_name.empty() == false)
+    {
+        pthread_setname_np(pthread_self(), instance->m_name.c_str());
+    }
     if(instance->m_func)
     {
         res = instance->m_func(instance->m_isRunning);
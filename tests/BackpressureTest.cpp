@@ -0,0 +1,95 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+
+/*
+ * BackpressureTest - checks that a client that doesn't read its responses
+ * makes the server hold back its requests instead of queueing everything,
+ * and that they are processed once the client reads again
+*/
+
+#include <atomic>
+#include "test_common.h"
+
+#define REQUEST_COUNT 16
+#define RESPONSE_SIZE 700000
+
+
+int main(int argc, char *argv[])
+{
+    auto args = TestArgs::Parse(argc, argv);
+    if(args.IsSupported() == false)
+    {
+        return TEST_SKIPPED;
+    }
+
+    std::atomic<int> handled(0);
+    std::atomic<int> congested(0);
+    std::atomic<bool> state(false);
+
+    WebCpp::HttpServer server;
+    CHECK(server.Init(args.GetConfig()), "init: " << server.GetLastError());
+    AddTestRoutes(server);
+    server.OnGet("/counted/{size:numeric}", [&handled](const WebCpp::Request &request, WebCpp::Response &response) -> bool
+    {
+        handled ++;
+        response.Write(Pattern(static_cast<size_t>(atol(request.GetArg("size").c_str()))));
+        return true;
+    });
+    server.SetCongestionCallback([&congested, &state](int, bool value)
+    {
+        congested += (value ? 1 : 0);
+        state = value;
+    });
+    CHECK(server.Run(), "run: " << server.GetLastError());
+
+    TestClient client;
+    CHECK(client.Connect(args.port, 4096), "connect");
+    std::string requests;
+    for(int i = 0;i < REQUEST_COUNT;i ++)
+    {
+        requests += Get("/counted/" + std::to_string(RESPONSE_SIZE));
+    }
+    CHECK(client.Send(requests), "send");
+
+    // the output over the high watermark stops the processing, the kernel
+    // buffers can take some of it first so the state can flip a few times
+    CHECK(WaitUntil([&congested]() { return congested > 0; }, DEFAULT_READ_TIMEOUT), "the connection is congested");
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    CHECK(state == true, "the connection stays congested while the client doesn't read");
+    CHECK(handled < REQUEST_COUNT, "the requests are held back, " << handled << " handled");
+
+    auto responses = ReadResponses(client, REQUEST_COUNT);
+    CHECK(responses.size() == REQUEST_COUNT, "all the responses, got " << responses.size());
+    std::string pattern = Pattern(RESPONSE_SIZE);
+    for(size_t i = 0;i < responses.size();i ++)
+    {
+        CHECK(responses[i].status == 200 && responses[i].body == pattern, "response " << i << " is complete");
+    }
+    CHECK(handled == REQUEST_COUNT, "every request is handled");
+    CHECK(state == false, "the connection is relieved");
+
+    server.Close();
+    return 0;
+}
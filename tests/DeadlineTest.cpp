@@ -0,0 +1,156 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+
+/*
+ * DeadlineTest - checks that a client too slow to send its request or to
+ * read its response is answered with 408 or dropped, and one that sends
+ * something else than a request with 400, without losing the responses
+ * it was already given
+*/
+
+#include "test_common.h"
+
+#define DEADLINE 1000
+
+
+static int TestHeader(int port)
+{
+    TestClient client;
+    CHECK(client.Connect(port), "connect");
+    CHECK(client.Send("GET / HTTP/1.1\r\nHost: "), "send");
+
+    auto start = std::chrono::steady_clock::now();
+    std::string data;
+    CHECK(client.ReadAll(data), "the connection is closed");
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    auto responses = ParseResponses(data);
+    CHECK(responses.size() == 1 && responses[0].status == 408, "the client is answered with 408");
+    CHECK(elapsed >= DEADLINE - 100, "not before the deadline, " << elapsed << " ms");
+    return 0;
+}
+
+static int TestBody(int port)
+{
+    TestClient client;
+    CHECK(client.Connect(port), "connect");
+    CHECK(client.Send("POST /size HTTP/1.1\r\nHost: " TEST_HOST "\r\nContent-Type: text/plain\r\nContent-Length: 100\r\n\r\nhello"), "send");
+
+    std::string data;
+    CHECK(client.ReadAll(data), "the connection is closed");
+    auto responses = ParseResponses(data);
+    CHECK(responses.size() == 1 && responses[0].status == 408, "the client is answered with 408");
+    return 0;
+}
+
+static int TestPipelined(int port)
+{
+    // the deadline of the next request passes while the client is
+    // still reading a response, the response is not cut
+    TestClient client;
+    CHECK(client.Connect(port, 4096), "connect");
+    CHECK(client.Send(Get("/big/600000") + "GET / HTTP/1.1\r\nHo"), "send");
+    std::this_thread::sleep_for(std::chrono::milliseconds(DEADLINE + 500));
+
+    std::string data;
+    CHECK(client.ReadAll(data), "the connection is closed");
+    auto responses = ParseResponses(data);
+    CHECK(responses.size() == 2, "two responses, got " << responses.size());
+    CHECK(responses[0].status == 200 && responses[0].body == Pattern(600000), "the response is complete");
+    CHECK(responses[1].status == 408, "the incomplete request is answered with 408");
+    return 0;
+}
+
+static int TestMalformed(int port)
+{
+    // a request line that comes in pieces is only incomplete
+    TestClient client;
+    CHECK(client.Connect(port), "connect");
+    CHECK(client.Send("GET / HT"), "send");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK(client.Send("TP/1.1\r\nHost: " TEST_HOST "\r\n\r\n"), "send");
+    auto responses = ReadResponses(client, 1);
+    CHECK(responses.size() == 1 && responses[0].status == 200, "the split request is answered");
+
+    // what can't be a request is answered with 400 right away, after the
+    // response to the request before it
+    auto start = std::chrono::steady_clock::now();
+    CHECK(client.Send(Get("/") + "BREW / HTTP/1.1\r\n\r\n"), "send");
+    std::string data;
+    CHECK(client.ReadAll(data), "the connection is closed");
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    responses = ParseResponses(data);
+    CHECK(responses.size() == 2, "two responses, got " << responses.size());
+    CHECK(responses[0].status == 200 && responses[1].status == 400, "the bad request is answered with 400");
+    CHECK(elapsed < DEADLINE, "not at the deadline, " << elapsed << " ms");
+    return 0;
+}
+
+static int TestWrite(int port, WebCpp::HttpServer &server)
+{
+    // the client takes nothing at all, it's dropped
+    TestClient client;
+    CHECK(client.Connect(port, 4096), "connect");
+    CHECK(client.Send(Get("/big/8000000")), "send");
+    CHECK(WaitUntil([&server]() { return server.GetEvictionStats().write > 0; }, DEADLINE * 4), "the client is dropped");
+
+    std::string data;
+    CHECK(client.Read(data, 8000000), "the connection is closed");
+    CHECK(data.size() < 8000000, "the response is cut");
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    auto args = TestArgs::Parse(argc, argv);
+    if(args.IsSupported() == false)
+    {
+        return TEST_SKIPPED;
+    }
+
+    WebCpp::HttpConfig config = args.GetConfig();
+    config.SetRequestHeaderTimeout(DEADLINE);
+    config.SetRequestBodyTimeout(DEADLINE);
+    config.SetWriteTimeout(DEADLINE);
+
+    WebCpp::HttpServer server;
+    CHECK(server.Init(config), "init: " << server.GetLastError());
+    AddTestRoutes(server);
+    CHECK(server.Run(), "run: " << server.GetLastError());
+
+    int result = TestHeader(args.port);
+    result = (result == 0 ? TestBody(args.port) : result);
+    result = (result == 0 ? TestPipelined(args.port) : result);
+    result = (result == 0 ? TestMalformed(args.port) : result);
+    result = (result == 0 ? TestWrite(args.port, server) : result);
+    if(result == 0)
+    {
+        auto stats = server.GetEvictionStats();
+        CHECK(stats.header == 2 && stats.body == 1 && stats.handler == 0 && stats.write == 1,
+              "the evictions are counted, " << stats.header << "/" << stats.body << "/" << stats.handler << "/" << stats.write);
+    }
+
+    server.Close();
+    return result;
+}
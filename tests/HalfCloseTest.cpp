@@ -0,0 +1,151 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+
+/*
+ * HalfCloseTest - checks that a client that shuts down its sending side
+ * still gets the answers to everything it has sent
+*/
+
+#include "test_common.h"
+
+
+static int TestSingle(int port)
+{
+    TestClient client;
+    CHECK(client.Connect(port), "connect");
+    CHECK(client.Send(Get("/")), "send");
+    CHECK(client.ShutdownWrite(), "shutdown");
+
+    std::string data;
+    CHECK(client.ReadAll(data), "the connection is closed after the answer");
+    auto responses = ParseResponses(data);
+    CHECK(responses.size() == 1, "one response");
+    CHECK(responses[0].status == 200 && responses[0].body == "hello", "the response is complete");
+    return 0;
+}
+
+static int TestPipelined(int port)
+{
+    TestClient client;
+    CHECK(client.Connect(port), "connect");
+    CHECK(client.Send(Get("/sleep/200") + Get("/big/700000") + Get("/big/700000") + Get("/big/700000")), "send");
+    CHECK(client.ShutdownWrite(), "shutdown");
+
+    std::string data;
+    CHECK(client.ReadAll(data), "the connection is closed after the answers");
+    auto responses = ParseResponses(data);
+    CHECK(responses.size() == 4, "four responses, got " << responses.size());
+    CHECK(responses[0].body == "slept", "the slow response");
+    std::string pattern = Pattern(700000);
+    for(size_t i = 1;i < responses.size();i ++)
+    {
+        CHECK(responses[i].status == 200 && responses[i].body == pattern, "large response " << i);
+    }
+    return 0;
+}
+
+static int TestPost(int port)
+{
+    TestClient client;
+    CHECK(client.Connect(port), "connect");
+    CHECK(client.Send("POST /size HTTP/1.1\r\nHost: " TEST_HOST "\r\nContent-Type: text/plain\r\nContent-Length: 5\r\n\r\nhello"), "send");
+    CHECK(client.ShutdownWrite(), "shutdown");
+
+    std::string data;
+    CHECK(client.ReadAll(data), "the connection is closed after the answer");
+    auto responses = ParseResponses(data);
+    CHECK(responses.size() == 1, "one response");
+    CHECK(responses[0].status == 200 && responses[0].body == "5", "the body was read");
+    return 0;
+}
+
+static int TestPartial(int port)
+{
+    TestClient client;
+    CHECK(client.Connect(port), "connect");
+    CHECK(client.Send(Get("/") + "GET /big/100 HTTP/1.1\r\nHo"), "send");
+    CHECK(client.ShutdownWrite(), "shutdown");
+
+    // the request that can't be completed anymore is dropped
+    std::string data;
+    CHECK(client.ReadAll(data), "the connection is closed");
+    auto responses = ParseResponses(data);
+    CHECK(responses.size() == 1 && responses[0].body == "hello", "only the complete request is answered");
+    return 0;
+}
+
+static int TestLarge(int port)
+{
+    // the client reads only after a while, so most of the answer is still
+    // queued on the server side when the connection is to be closed
+    TestClient client;
+    CHECK(client.Connect(port, 4096), "connect");
+    CHECK(client.Send(Get("/big/4194304")), "send");
+    CHECK(client.ShutdownWrite(), "shutdown");
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::string data;
+    CHECK(client.ReadAll(data), "the connection is closed after the answer");
+    auto responses = ParseResponses(data);
+    CHECK(responses.size() == 1, "one response");
+    CHECK(responses[0].status == 200 && responses[0].body == Pattern(4194304), "the queued part is sent before closing");
+    return 0;
+}
+
+static int TestIdle(int port)
+{
+    TestClient client;
+    CHECK(client.Connect(port), "connect");
+    CHECK(client.ShutdownWrite(), "shutdown");
+
+    std::string data;
+    CHECK(client.ReadAll(data), "the connection is closed");
+    CHECK(data.empty(), "nothing is sent");
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    auto args = TestArgs::Parse(argc, argv);
+    if(args.IsSupported() == false)
+    {
+        return TEST_SKIPPED;
+    }
+
+    WebCpp::HttpServer server;
+    CHECK(server.Init(args.GetConfig()), "init: " << server.GetLastError());
+    AddTestRoutes(server);
+    CHECK(server.Run(), "run: " << server.GetLastError());
+
+    int result = TestSingle(args.port);
+    result = (result == 0 ? TestPipelined(args.port) : result);
+    result = (result == 0 ? TestPost(args.port) : result);
+    result = (result == 0 ? TestPartial(args.port) : result);
+    result = (result == 0 ? TestLarge(args.port) : result);
+    result = (result == 0 ? TestIdle(args.port) : result);
+
+    server.Close();
+    return result;
+}
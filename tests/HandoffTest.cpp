@@ -0,0 +1,126 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+
+/*
+ * HandoffTest - replaces a running server with a new one in the same
+ * process: the new one takes the listening socket over, the old one
+ * answers the connections it has and quits
+*/
+
+#include <atomic>
+#include "test_common.h"
+
+#define DRAIN_TIMEOUT 3000
+
+
+static bool InitServer(WebCpp::HttpServer &server, const TestArgs &args, const std::string &handoff, const std::string &name)
+{
+    WebCpp::HttpConfig config = args.GetConfig();
+    config.SetHandoffSocket(handoff);
+    config.SetHandoffDrainTimeout(DRAIN_TIMEOUT);
+    // the held connection stays open however long the new server takes to start
+    config.SetKeepAliveTimeout(DRAIN_TIMEOUT);
+    if(server.Init(config) == false)
+    {
+        return false;
+    }
+
+    AddTestRoutes(server);
+    server.OnGet("/name", [name](const WebCpp::Request &, WebCpp::Response &response) -> bool
+    {
+        response.Write(name);
+        return true;
+    });
+    return server.Run();
+}
+
+static int TestHandoff(const TestArgs &args, const std::string &handoff,
+                       WebCpp::HttpServer &newServer, std::atomic<bool> &oldDone)
+{
+    // a keep-alive connection of the old server
+    TestClient held;
+    CHECK(held.Connect(args.port), "connect");
+    CHECK(held.Send(Get("/name")), "send");
+    auto responses = ReadResponses(held, 1);
+    CHECK(responses.size() == 1 && responses[0].body == "old", "the old server answers");
+
+    CHECK(InitServer(newServer, args, handoff, "new"), "new server: " << newServer.GetLastError());
+
+    // a client that comes while the old server lets the socket go is
+    // answered by one of them, it isn't refused
+    TestClient client;
+    CHECK(client.Connect(args.port), "connect");
+    CHECK(client.Send(Get("/")), "send");
+    responses = ReadResponses(client, 1);
+    CHECK(responses.size() == 1 && responses[0].body == "hello", "the client is answered during the handoff");
+
+    // the old server still answers the connection it has and closes it
+    CHECK(held.Send(Get("/name")), "send");
+    std::string data;
+    CHECK(held.ReadAll(data), "the old connection is closed");
+    responses = ParseResponses(data);
+    CHECK(responses.size() == 1 && responses[0].body == "old", "the old server answers its connection");
+    CHECK(responses[0].headers.find("Connection: close") != std::string::npos, "the client is told the connection is closed");
+
+    CHECK(WaitUntil([&oldDone]() { return oldDone == true; }, DRAIN_TIMEOUT + 1000), "the old server quits once its connections are done");
+
+    // and the new one serves alone
+    client.Close();
+    CHECK(client.Connect(args.port), "connect");
+    CHECK(client.Send(Get("/name")), "send");
+    responses = ReadResponses(client, 1);
+    CHECK(responses.size() == 1 && responses[0].body == "new", "the new server answers alone");
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    auto args = TestArgs::Parse(argc, argv);
+    if(args.IsSupported() == false)
+    {
+        return TEST_SKIPPED;
+    }
+
+    std::string handoff = "/tmp/webcpp_test_handoff_" + std::to_string(args.port) + ".sock";
+    unlink(handoff.c_str());
+
+    WebCpp::HttpServer oldServer;
+    CHECK(InitServer(oldServer, args, handoff, "old"), "old server: " << oldServer.GetLastError());
+    std::atomic<bool> oldDone(false);
+    std::thread waiter([&oldServer, &oldDone]()
+    {
+        oldServer.WaitFor();
+        oldDone = true;
+    });
+
+    WebCpp::HttpServer newServer;
+    int result = TestHandoff(args, handoff, newServer, oldDone);
+
+    oldServer.Close();
+    waiter.join();
+    newServer.Close();
+    unlink(handoff.c_str());
+    return result;
+}
@@ -0,0 +1,109 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+/*
+ * KeepAliveTest - the keep-alive timeout is the time a connection is idle:
+ * a client that sends its request slowly isn't dropped, a lot of idle
+ * connections are closed together and a slow reader keeps its connection
+*/
+
+#include "test_common.h"
+
+#define KEEPALIVE_TIMEOUT 500
+#define CLIENT_COUNT 200
+
+
+static int TestSlowRequest(int port)
+{
+    TestClient client;
+    CHECK(client.Connect(port), "connect");
+    // the request takes longer than the timeout, but the client is never idle that long
+    std::string request = Get("/");
+    for(size_t i = 0;i < request.size();i += 4)
+    {
+        CHECK(client.Send(request.substr(i, 4)), "send");
+        std::this_thread::sleep_for(std::chrono::milliseconds(KEEPALIVE_TIMEOUT / 10));
+    }
+    auto responses = ReadResponses(client, 1);
+    CHECK(responses.size() == 1 && responses[0].body == "hello", "the slow request is answered");
+    return 0;
+}
+
+static int TestIdle(int port)
+{
+    std::vector<std::unique_ptr<TestClient>> clients;
+    for(int i = 0;i < CLIENT_COUNT;i ++)
+    {
+        clients.emplace_back(new TestClient());
+        CHECK(clients.back()->Connect(port), "connect " << i);
+    }
+
+    // all of them expire at about the same time and are closed together
+    auto start = std::chrono::steady_clock::now();
+    for(auto &client: clients)
+    {
+        std::string data;
+        CHECK(client->ReadAll(data, KEEPALIVE_TIMEOUT * 4) && client->IsClosed(), "the idle connection is closed");
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    CHECK(elapsed < KEEPALIVE_TIMEOUT * 4, "the idle connections are closed in " << elapsed << " ms");
+    return 0;
+}
+
+static int TestSlowReader(int port)
+{
+    TestClient client;
+    CHECK(client.Connect(port, 4096), "connect");
+    CHECK(client.Send(Get("/big/3000000")), "send");
+
+    // the response stays queued longer than the timeout
+    std::this_thread::sleep_for(std::chrono::milliseconds(KEEPALIVE_TIMEOUT * 2));
+    auto responses = ReadResponses(client, 1);
+    CHECK(responses.size() == 1 && responses[0].body == Pattern(3000000), "the slow reader gets the whole response");
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    auto args = TestArgs::Parse(argc, argv);
+    if(args.IsSupported() == false)
+    {
+        return TEST_SKIPPED;
+    }
+
+    WebCpp::HttpConfig config = args.GetConfig();
+    config.SetKeepAliveTimeout(KEEPALIVE_TIMEOUT);
+
+    WebCpp::HttpServer server;
+    CHECK(server.Init(config), "init: " << server.GetLastError());
+    AddTestRoutes(server);
+    CHECK(server.Run(), "run: " << server.GetLastError());
+
+    int result = TestSlowRequest(args.port);
+    result = (result == 0 ? TestIdle(args.port) : result);
+    result = (result == 0 ? TestSlowReader(args.port) : result);
+
+    server.Close();
+    return result;
+}
@@ -0,0 +1,131 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+
+/*
+ * PipelineTest - sends many requests on a connection at once and checks
+ * that the responses come complete and in order, also when they are
+ * large enough to fill the socket and the client is slow to read them
+*/
+
+#include "test_common.h"
+
+#define LARGE_SIZE 700000
+#define LARGE_COUNT 4
+#define MIXED_COUNT 60
+
+
+static int TestLarge(int port)
+{
+    TestClient client;
+    CHECK(client.Connect(port, 16384), "connect");
+    std::string requests;
+    for(int i = 0;i < LARGE_COUNT;i ++)
+    {
+        requests += Get("/big/" + std::to_string(LARGE_SIZE));
+    }
+    CHECK(client.Send(requests), "send");
+
+    // the responses pile up while the client doesn't read,
+    // the server holds the next requests back meanwhile
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    auto responses = ReadResponses(client, LARGE_COUNT);
+    CHECK(responses.size() == LARGE_COUNT, "all the responses, got " << responses.size());
+    std::string pattern = Pattern(LARGE_SIZE);
+    for(size_t i = 0;i < responses.size();i ++)
+    {
+        CHECK(responses[i].status == 200 && responses[i].body == pattern, "response " << i << " is complete");
+    }
+    return 0;
+}
+
+static int TestMixed(int port)
+{
+    // the small responses go out together with the large ones, in order
+    TestClient client;
+    CHECK(client.Connect(port), "connect");
+    std::string requests;
+    std::vector<size_t> sizes;
+    for(int i = 0;i < MIXED_COUNT;i ++)
+    {
+        size_t size = (i % 3 == 0 ? 300000 + i : 10 + i);
+        sizes.push_back(size);
+        requests += Get("/big/" + std::to_string(size));
+    }
+    CHECK(client.Send(requests), "send");
+
+    auto responses = ReadResponses(client, MIXED_COUNT);
+    CHECK(responses.size() == MIXED_COUNT, "all the responses, got " << responses.size());
+    for(size_t i = 0;i < responses.size();i ++)
+    {
+        CHECK(responses[i].status == 200 && responses[i].body == Pattern(sizes[i]), "response " << i << " is in its place");
+    }
+    return 0;
+}
+
+static int TestServing(int port)
+{
+    // the server isn't stuck after all that
+    TestClient client;
+    CHECK(client.Connect(port), "connect");
+    CHECK(client.Send(Get("/")), "send");
+    auto responses = ReadResponses(client, 1);
+    CHECK(responses.size() == 1 && responses[0].body == "hello", "the server answers");
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    auto args = TestArgs::Parse(argc, argv);
+    if(args.IsSupported() == false)
+    {
+        return TEST_SKIPPED;
+    }
+
+    // the socket option is set too, both ways of corking the responses are run
+    int result = 0;
+    for(bool cork: { false, true })
+    {
+        WebCpp::HttpConfig config = args.GetConfig();
+        config.SetTcpCork(cork);
+
+        WebCpp::HttpServer server;
+        CHECK(server.Init(config), "init: " << server.GetLastError());
+        AddTestRoutes(server);
+        CHECK(server.Run(), "run: " << server.GetLastError());
+
+        result = TestLarge(args.port);
+        result = (result == 0 ? TestMixed(args.port) : result);
+        result = (result == 0 ? TestServing(args.port) : result);
+
+        server.Close();
+        if(result != 0)
+        {
+            std::cout << "TCP_CORK " << (cork ? "on" : "off") << std::endl;
+            break;
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,163 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+
+/*
+ * SheddingTest - checks that the requests the server can't take in time
+ * are answered with 503 at once, and that the server keeps working
+*/
+
+#include "test_common.h"
+
+#define QUEUE_TIME 300
+#define HANDLER_TIME 800
+
+
+static int CheckShed(TestClient &client)
+{
+    std::string data;
+    CHECK(client.ReadAll(data), "the connection is closed");
+    auto responses = ParseResponses(data);
+    CHECK(responses.size() == 1 && responses[0].status == 503, "the request is answered with 503");
+    CHECK(responses[0].headers.find("Retry-After: ") != std::string::npos, "the client is told when to retry");
+    return 0;
+}
+
+static int CheckServed(TestClient &client, const std::string &body)
+{
+    auto responses = ReadResponses(client, 1);
+    CHECK(responses.size() == 1 && responses[0].status == 200 && responses[0].body == body, "the request is served ");
+    return 0;
+}
+
+static int TestQueueTime(int port)
+{
+    // the thread the handlers run on is busy for longer than a request may wait
+    TestClient busy;
+    CHECK(busy.Connect(port), "connect");
+    CHECK(busy.Send(Get("/sleep/" + std::to_string(HANDLER_TIME))), "send");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    TestClient client;
+    CHECK(client.Connect(port), "connect");
+    CHECK(client.Send(Get("/")), "send");
+    CHECK(CheckShed(client) == 0, "the late request is shed");
+    CHECK(CheckServed(busy, "slept") == 0, "the busy request is served");
+
+    // a pipelined request waits for the previous one of its connection,
+    // the responses queued before the 503 still reach the client
+    TestClient pipelined;
+    CHECK(pipelined.Connect(port), "connect");
+    CHECK(pipelined.Send(Get("/sleep/" + std::to_string(HANDLER_TIME)) + Get("/")), "send");
+    std::string data;
+    CHECK(pipelined.ReadAll(data), "the connection is closed");
+    auto responses = ParseResponses(data);
+    CHECK(responses.size() == 2, "two responses, got " << responses.size());
+    CHECK(responses[0].status == 200 && responses[0].body == "slept", "the first request is served");
+    CHECK(responses[1].status == 503, "the request that waited too long is shed");
+
+    TestClient next;
+    CHECK(next.Connect(port), "connect");
+    CHECK(next.Send(Get("/")), "send");
+    CHECK(CheckServed(next, "hello") == 0, "the server keeps working");
+    return 0;
+}
+
+static int TestQueueLimit(int port)
+{
+    // the one request the server may queue is taken
+    TestClient busy;
+    CHECK(busy.Connect(port), "connect");
+    CHECK(busy.Send(Get("/sleep/" + std::to_string(HANDLER_TIME))), "send");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto start = std::chrono::steady_clock::now();
+    TestClient client;
+    CHECK(client.Connect(port), "connect");
+    CHECK(client.Send(Get("/")), "send");
+    CHECK(CheckShed(client) == 0, "the request over the limit is shed");
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    CHECK(elapsed < HANDLER_TIME / 2, "the client doesn't wait for the busy handler, " << elapsed << " ms");
+    CHECK(CheckServed(busy, "slept") == 0, "the busy request is served");
+
+    // the request is counted till the handler is done, a bit after the response is out
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    TestClient next;
+    CHECK(next.Connect(port), "connect");
+    CHECK(next.Send(Get("/")), "send");
+    CHECK(CheckServed(next, "hello") == 0, "the server keeps working");
+    return 0;
+}
+
+static int RunServer(WebCpp::HttpConfig &config, int port, bool queueTime)
+{
+    WebCpp::HttpServer server;
+    CHECK(server.Init(config), "init: " << server.GetLastError());
+    AddTestRoutes(server);
+    CHECK(server.Run(), "run: " << server.GetLastError());
+
+    int result = (queueTime ? TestQueueTime(port) : TestQueueLimit(port));
+    auto stats = server.GetShedStats();
+    server.Close();
+
+    CHECK(result == 0, "");
+    if(queueTime)
+    {
+        CHECK(stats.queueTime == 2 && stats.queueLimit == 0, "the shed requests are counted, " << stats.queueTime << "/" << stats.queueLimit);
+    }
+    else
+    {
+        CHECK(stats.queueLimit == 1 && stats.queueTime == 0, "the shed requests are counted, " << stats.queueLimit << "/" << stats.queueTime);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    auto args = TestArgs::Parse(argc, argv);
+    if(args.IsSupported() == false)
+    {
+        return TEST_SKIPPED;
+    }
+
+    // the handlers run on the request thread, then on the only worker
+    int result = 0;
+    for(size_t workers = 0; workers <= 1 && result == 0; workers ++)
+    {
+        WebCpp::HttpConfig config = args.GetConfig();
+        config.SetRequestWorkers(workers);
+        config.SetMaxQueueTime(QUEUE_TIME);
+        result = RunServer(config, args.port, true);
+
+        if(result == 0)
+        {
+            config = args.GetConfig();
+            config.SetRequestWorkers(workers);
+            config.SetMaxQueuedRequests(1);
+            result = RunServer(config, args.port, false);
+        }
+    }
+
+    return result;
+}
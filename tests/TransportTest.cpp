@@ -0,0 +1,163 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+
+/*
+ * TransportTest - runs the traffic that goes through the socket pool:
+ * many clients at once, a reader slower than the server, files and
+ * clients that go away in the middle of a response
+*/
+
+#include <atomic>
+#include <fstream>
+#include <stdlib.h>
+#include "test_common.h"
+
+#define CLIENT_COUNT 16
+#define CLIENT_REQUESTS 20
+#define FILE_SIZE (3 * 1024 * 1024)
+
+
+static int TestConcurrent(int port)
+{
+    std::atomic<int> failed(0);
+    std::vector<std::thread> threads;
+    for(int i = 0;i < CLIENT_COUNT;i ++)
+    {
+        threads.push_back(std::thread([port, i, &failed]()
+        {
+            TestClient client;
+            if(client.Connect(port) == false)
+            {
+                failed ++;
+                return;
+            }
+            // every client asks for its own size, so answers can't get mixed up
+            std::string path = "/big/" + std::to_string(1000 + i * 997);
+            std::string pattern = Pattern(1000 + i * 997);
+            for(int j = 0;j < CLIENT_REQUESTS;j ++)
+            {
+                client.Send(Get(path));
+                auto responses = ReadResponses(client, 1);
+                if(responses.size() != 1 || responses[0].body != pattern)
+                {
+                    failed ++;
+                    return;
+                }
+            }
+        }));
+    }
+    for(auto &thread: threads)
+    {
+        thread.join();
+    }
+
+    CHECK(failed == 0, failed << " clients failed");
+    return 0;
+}
+
+static int TestSlowReader(int port)
+{
+    TestClient client;
+    CHECK(client.Connect(port, 16384), "connect");
+    CHECK(client.Send(Get("/big/2000000")), "send");
+
+    // the server has to wait for the socket to drain several times
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    auto responses = ReadResponses(client, 1);
+    CHECK(responses.size() == 1, "one response");
+    CHECK(responses[0].body == Pattern(2000000), "the response is complete");
+    return 0;
+}
+
+static int TestFile(int port, const std::string &content)
+{
+    TestClient client;
+    CHECK(client.Connect(port, 4096), "connect");
+    CHECK(client.Send(Get("/file/test.bin") + Get("/")), "send");
+
+    auto responses = ReadResponses(client, 2);
+    CHECK(responses.size() == 2, "two responses, got " << responses.size());
+    CHECK(responses[0].status == 200 && responses[0].body == content, "the file is complete");
+    CHECK(responses[1].body == "hello", "the next request is answered");
+    return 0;
+}
+
+static int TestAborted(int port)
+{
+    for(int i = 0;i < 8;i ++)
+    {
+        TestClient client;
+        CHECK(client.Connect(port), "connect");
+        CHECK(client.Send(Get("/big/2000000") + Get("/file/test.bin")), "send");
+        std::string data;
+        client.Read(data, 10000);
+        client.Abort();
+    }
+
+    // the server is still there for everybody else
+    TestClient client;
+    CHECK(client.Connect(port), "connect");
+    CHECK(client.Send(Get("/")), "send");
+    auto responses = ReadResponses(client, 1);
+    CHECK(responses.size() == 1 && responses[0].body == "hello", "the server still answers");
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    auto args = TestArgs::Parse(argc, argv);
+    if(args.IsSupported() == false)
+    {
+        return TEST_SKIPPED;
+    }
+
+    char root[] = "/tmp/webcpp_test_XXXXXX";
+    CHECK(mkdtemp(root) != nullptr, "temporary directory");
+    std::string content = Pattern(FILE_SIZE);
+    std::string file = std::string(root) + "/test.bin";
+    std::ofstream(file, std::ios::binary) << content;
+
+    WebCpp::HttpConfig config = args.GetConfig();
+    config.SetRoot(root);
+
+    WebCpp::HttpServer server;
+    CHECK(server.Init(config), "init: " << server.GetLastError());
+    AddTestRoutes(server);
+    server.OnGet("/file/{name}", [](const WebCpp::Request &request, WebCpp::Response &response) -> bool
+    {
+        return response.AddFile(request.GetArg("name"));
+    });
+    CHECK(server.Run(), "run: " << server.GetLastError());
+
+    int result = TestConcurrent(args.port);
+    result = (result == 0 ? TestSlowReader(args.port) : result);
+    result = (result == 0 ? TestFile(args.port, content) : result);
+    result = (result == 0 ? TestAborted(args.port) : result);
+
+    server.Close();
+    unlink(file.c_str());
+    rmdir(root);
+    return result;
+}
@@ -0,0 +1,103 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+/*
+ * UnixSocketTest - serves HTTP on a Unix domain socket: the clients of
+ * every reactor are answered, the file gets the permissions, a stale file
+ * is taken over while one that is in use is not, and it's removed on close
+*/
+
+#include <sys/stat.h>
+#include "test_common.h"
+
+#define CLIENT_COUNT 8
+
+
+// the file a server that was killed leaves behind
+static bool MakeStaleSocket(const std::string &path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd == (-1))
+    {
+        return false;
+    }
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    bool retval = (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0);
+    close(fd);
+    return retval;
+}
+
+int main(int argc, char *argv[])
+{
+    auto args = TestArgs::Parse(argc, argv);
+    if(args.IsSupported() == false)
+    {
+        return TEST_SKIPPED;
+    }
+
+    std::string path = "/tmp/webcpp-test-" + std::to_string(args.port) + ".sock";
+    unlink(path.c_str());
+    CHECK(MakeStaleSocket(path), "stale socket");
+
+    auto config = args.GetConfig();
+    config.SetHttpUnixSocket(path);
+    config.SetReactorCount(2);
+
+    WebCpp::HttpServer server;
+    CHECK(server.Init(config), "init: " << server.GetLastError());
+    AddTestRoutes(server);
+    CHECK(server.Run(), "run: " << server.GetLastError());
+
+    struct stat st;
+    CHECK(stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode), "the socket file is created");
+    CHECK((st.st_mode & 0777) == DEFAULT_UNIX_SOCKET_PERMISSIONS, "the socket file permissions");
+
+    // the clients are spread over the reactors that share the listening socket
+    for(int i = 0;i < CLIENT_COUNT;i ++)
+    {
+        TestClient client;
+        CHECK(client.ConnectUnix(path), "connect " << i);
+        CHECK(client.Send(Get("/") + Get("/big/100000")), "send " << i);
+        auto responses = ReadResponses(client, 2);
+        CHECK(responses.size() == 2, "client " << i << " got " << responses.size() << " responses");
+        CHECK(responses[0].status == 200 && responses[0].body == "hello", "client " << i << " short response");
+        CHECK(responses[1].body == Pattern(100000), "client " << i << " large response");
+    }
+
+    WebCpp::HttpServer other;
+    CHECK(other.Init(config), "init the other server: " << other.GetLastError());
+    CHECK(other.Run() == false, "the path that is in use isn't taken over");
+    CHECK(stat(path.c_str(), &st) == 0, "the socket file is left to the server that uses it");
+    TestClient client;
+    CHECK(client.ConnectUnix(path), "connect after the other server failed");
+    CHECK(client.Send(Get("/", true)), "send after the other server failed");
+    auto responses = ReadResponses(client, 1);
+    CHECK(responses.size() == 1 && responses[0].body == "hello", "the first server still answers");
+
+    server.Close();
+    CHECK(stat(path.c_str(), &st) != 0, "the socket file is removed on close");
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+
+/*
+ * WorkersTest - checks that the handlers of different connections run
+ * side by side on the request workers, while the responses of a
+ * connection still go out in the order of its requests
+*/
+
+#include "test_common.h"
+
+#define WORKERS 2
+#define HANDLER_TIME 600
+#define PIPELINED_COUNT 10
+
+
+static int TestParallel(int port)
+{
+    // both slow requests are handled at once
+    auto start = std::chrono::steady_clock::now();
+    TestClient first, second;
+    CHECK(first.Connect(port) && second.Connect(port), "connect");
+    CHECK(first.Send(Get("/sleep/" + std::to_string(HANDLER_TIME))), "send");
+    CHECK(second.Send(Get("/sleep/" + std::to_string(HANDLER_TIME))), "send");
+
+    auto responses = ReadResponses(first, 1);
+    CHECK(responses.size() == 1 && responses[0].body == "slept", "the first request is served");
+    responses = ReadResponses(second, 1);
+    CHECK(responses.size() == 1 && responses[0].body == "slept", "the second request is served");
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    CHECK(elapsed < HANDLER_TIME * 3 / 2, "the requests are handled in parallel, " << elapsed << " ms");
+    return 0;
+}
+
+static int TestOrder(int port)
+{
+    // a slow request is followed by quick ones on the same connection,
+    // they wait for it even though a worker is free
+    TestClient client;
+    CHECK(client.Connect(port), "connect");
+    std::string requests = Get("/sleep/" + std::to_string(HANDLER_TIME / 2));
+    std::vector<size_t> sizes;
+    for(int i = 0;i < PIPELINED_COUNT;i ++)
+    {
+        sizes.push_back(10 + i);
+        requests += Get("/big/" + std::to_string(sizes.back()));
+    }
+    CHECK(client.Send(requests), "send");
+
+    auto responses = ReadResponses(client, PIPELINED_COUNT + 1);
+    CHECK(responses.size() == PIPELINED_COUNT + 1, "all the responses, got " << responses.size());
+    CHECK(responses[0].status == 200 && responses[0].body == "slept", "the slow request is answered first");
+    for(size_t i = 0;i < sizes.size();i ++)
+    {
+        CHECK(responses[i + 1].status == 200 && responses[i + 1].body == Pattern(sizes[i]), "response " << i + 1 << " is in its place");
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    auto args = TestArgs::Parse(argc, argv);
+    if(args.IsSupported() == false)
+    {
+        return TEST_SKIPPED;
+    }
+
+    WebCpp::HttpConfig config = args.GetConfig();
+    config.SetRequestWorkers(WORKERS);
+
+    WebCpp::HttpServer server;
+    CHECK(server.Init(config), "init: " << server.GetLastError());
+    AddTestRoutes(server);
+    CHECK(server.Run(), "run: " << server.GetLastError());
+
+    int result = TestParallel(args.port);
+    result = (result == 0 ? TestOrder(args.port) : result);
+
+    server.Close();
+    return result;
+}
@@ -0,0 +1,97 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+/*
+ * ZeroCopyTest - the large bodies go with MSG_ZEROCOPY, or are copied
+ * where the kernel doesn't do it: they must arrive intact and in order
+ * with the small ones between them, also to a slow reader, and the
+ * clients that go away before the kernel is done don't break the server
+*/
+
+#include "test_common.h"
+
+#define ZEROCOPY_THRESHOLD (64 * 1024)
+#define LARGE_SIZE 1500000
+
+
+static int TestMixed(int port)
+{
+    TestClient client;
+    CHECK(client.Connect(port, 16384), "connect");
+    CHECK(client.Send(Get("/big/" + std::to_string(LARGE_SIZE)) + Get("/") +
+                      Get("/big/" + std::to_string(ZEROCOPY_THRESHOLD)) + Get("/big/100")), "send");
+
+    // the queue goes over the watermark while the client doesn't read
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    auto responses = ReadResponses(client, 4);
+    CHECK(responses.size() == 4, "four responses, got " << responses.size());
+    CHECK(responses[0].body == Pattern(LARGE_SIZE), "the large body is complete");
+    CHECK(responses[1].body == "hello", "the small body goes after it");
+    CHECK(responses[2].body == Pattern(ZEROCOPY_THRESHOLD), "the body of the threshold size is complete");
+    CHECK(responses[3].body == Pattern(100), "the last body is complete");
+    return 0;
+}
+
+static int TestAborted(int port)
+{
+    for(int i = 0;i < 8;i ++)
+    {
+        TestClient client;
+        CHECK(client.Connect(port), "connect");
+        CHECK(client.Send(Get("/big/" + std::to_string(LARGE_SIZE)) + Get("/big/" + std::to_string(LARGE_SIZE))), "send");
+        std::string data;
+        client.Read(data, 10000);
+        client.Abort();
+    }
+
+    TestClient client;
+    CHECK(client.Connect(port), "connect");
+    CHECK(client.Send(Get("/big/" + std::to_string(LARGE_SIZE))), "send");
+    auto responses = ReadResponses(client, 1);
+    CHECK(responses.size() == 1 && responses[0].body == Pattern(LARGE_SIZE), "the server still answers");
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    auto args = TestArgs::Parse(argc, argv);
+    if(args.IsSupported() == false)
+    {
+        return TEST_SKIPPED;
+    }
+
+    WebCpp::HttpConfig config = args.GetConfig();
+    config.SetZeroCopyThreshold(ZEROCOPY_THRESHOLD);
+
+    WebCpp::HttpServer server;
+    CHECK(server.Init(config), "init: " << server.GetLastError());
+    AddTestRoutes(server);
+    CHECK(server.Run(), "run: " << server.GetLastError());
+
+    int result = TestMixed(args.port);
+    result = (result == 0 ? TestAborted(args.port) : result);
+
+    server.Close();
+    return result;
+}
@@ -0,0 +1,345 @@
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <poll.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <iostream>
+#include <algorithm>
+#include "HttpServer.h"
+#include "IoUring.h"
+
+#define TEST_HOST "127.0.0.1"
+#define DEFAULT_TEST_PORT 18100
+#define DEFAULT_READ_TIMEOUT 5000
+// the return code ctest takes as a skipped test
+#define TEST_SKIPPED 77
+
+// fails the test with the line it was checked at
+#define CHECK(condition, message) \
+    if(!(condition)) \
+    { \
+        std::cout << "FAILED: " << message << " (" << __FILE__ << ":" << __LINE__ << ")" << std::endl; \
+        return 1; \
+    }
+
+
+/* the command line of a test is the poll method and the port to listen on */
+class TestArgs
+{
+public:
+    static TestArgs Parse(int argc, char **argv)
+    {
+        TestArgs args;
+        if(argc > 1)
+        {
+            args.method = argv[1];
+        }
+        if(argc > 2)
+        {
+            args.port = atoi(argv[2]);
+        }
+        return args;
+    }
+
+    WebCpp::SocketPool::PollMethod GetPollMethod() const
+    {
+        if(method == "poll")
+        {
+            return WebCpp::SocketPool::PollMethod::Poll;
+        }
+        if(method == "io_uring")
+        {
+            return WebCpp::SocketPool::PollMethod::IoUring;
+        }
+        return WebCpp::SocketPool::PollMethod::Epoll;
+    }
+
+    // the kernel could have io_uring disabled, the test is skipped then
+    bool IsSupported() const
+    {
+        return (method != "io_uring" || WebCpp::IoUring::IsSupported());
+    }
+
+    WebCpp::HttpConfig GetConfig() const
+    {
+        WebCpp::HttpConfig config;
+        config.SetHttpServerPort(port);
+        config.SetPollMethod(GetPollMethod());
+        return config;
+    }
+
+    std::string method = "epoll";
+    int port = DEFAULT_TEST_PORT;
+};
+
+
+/* a parsed response, the body is counted by Content-Length */
+struct TestResponse
+{
+    int status = 0;
+    std::string headers;
+    std::string body;
+};
+
+
+/* a blocking client socket that checks what the server sends, byte by byte */
+class TestClient
+{
+public:
+    TestClient() = default;
+    TestClient(const TestClient& other) = delete;
+    TestClient& operator=(const TestClient& other) = delete;
+
+    ~TestClient()
+    {
+        Close();
+    }
+
+    // a small receive buffer makes the server queue what the client doesn't read
+    bool Connect(int port, int receiveBuffer = 0)
+    {
+        Close();
+        m_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(m_fd == (-1))
+        {
+            return false;
+        }
+        if(receiveBuffer > 0)
+        {
+            setsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+        }
+
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = inet_addr(TEST_HOST);
+        return (connect(m_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0);
+    }
+
+    bool ConnectUnix(const std::string &path)
+    {
+        Close();
+        m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(m_fd == (-1))
+        {
+            return false;
+        }
+
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        return (connect(m_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0);
+    }
+
+    bool Send(const std::string &data)
+    {
+        size_t total = 0;
+        while(total < data.size())
+        {
+            ssize_t sent = send(m_fd, data.data() + total, data.size() - total, MSG_NOSIGNAL);
+            if(sent <= 0)
+            {
+                return false;
+            }
+            total += sent;
+        }
+        return true;
+    }
+
+    bool ShutdownWrite()
+    {
+        return (shutdown(m_fd, SHUT_WR) == 0);
+    }
+
+    // reads till the server closes the connection or nothing comes for the timeout,
+    // the returned flag tells if the connection was closed
+    bool ReadAll(std::string &data, int timeout = DEFAULT_READ_TIMEOUT)
+    {
+        return Read(data, static_cast<size_t>(-1), timeout);
+    }
+
+    // reads till there are at least size bytes
+    bool Read(std::string &data, size_t size, int timeout = DEFAULT_READ_TIMEOUT)
+    {
+        char buffer[64 * 1024];
+        while(data.size() < size)
+        {
+            struct pollfd fds = {};
+            fds.fd = m_fd;
+            fds.events = POLLIN;
+            if(poll(&fds, 1, timeout) <= 0)
+            {
+                return false;
+            }
+            ssize_t read = recv(m_fd, buffer, sizeof(buffer), 0);
+            if(read <= 0)
+            {
+                m_closed = true;
+                return true;
+            }
+            data.append(buffer, read);
+        }
+        return false;
+    }
+
+    // the peer closed the connection, the last Read() or ReadAll() has seen it
+    bool IsClosed() const
+    {
+        return m_closed;
+    }
+
+    // closes with a reset, the way a client that went away does
+    void Abort()
+    {
+        if(m_fd != (-1))
+        {
+            struct linger lin = { 1, 0 };
+            setsockopt(m_fd, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+        }
+        Close();
+    }
+
+    void Close()
+    {
+        if(m_fd != (-1))
+        {
+            close(m_fd);
+            m_fd = (-1);
+        }
+        m_closed = false;
+    }
+
+private:
+    int m_fd = (-1);
+    bool m_closed = false;
+};
+
+
+/* splits the data into the responses, a response that isn't complete is left out */
+inline std::vector<TestResponse> ParseResponses(const std::string &data)
+{
+    std::vector<TestResponse> responses;
+    size_t pos = 0;
+    while(pos < data.size())
+    {
+        size_t end = data.find("\r\n\r\n", pos);
+        if(end == std::string::npos || data.compare(pos, 5, "HTTP/") != 0)
+        {
+            break;
+        }
+
+        TestResponse response;
+        response.headers = data.substr(pos, end - pos);
+        size_t space = response.headers.find(' ');
+        response.status = (space == std::string::npos ? 0 : atoi(response.headers.c_str() + space + 1));
+
+        size_t length = 0;
+        std::string lower = response.headers;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        size_t header = lower.find("content-length:");
+        if(header != std::string::npos)
+        {
+            length = static_cast<size_t>(atol(lower.c_str() + header + 15));
+        }
+
+        pos = end + 4;
+        if(data.size() - pos < length)
+        {
+            break;
+        }
+        response.body = data.substr(pos, length);
+        pos += length;
+        responses.push_back(response);
+    }
+
+    return responses;
+}
+
+// reads till there are count complete responses, the connection is closed
+// or nothing comes for the timeout
+inline std::vector<TestResponse> ReadResponses(TestClient &client, size_t count, int timeout = DEFAULT_READ_TIMEOUT)
+{
+    std::string data;
+    std::vector<TestResponse> responses;
+    while(responses.size() < count)
+    {
+        size_t size = data.size();
+        if(client.Read(data, size + 1, timeout) == true || data.size() == size)
+        {
+            return ParseResponses(data);
+        }
+        responses = ParseResponses(data);
+    }
+    return responses;
+}
+
+inline std::string Get(const std::string &path, bool close = false)
+{
+    return "GET " + path + " HTTP/1.1\r\nHost: " TEST_HOST "\r\n" + (close ? "Connection: close\r\n" : "") + "\r\n";
+}
+
+// the body of a large response, it's checked byte by byte on the client side
+inline std::string Pattern(size_t size)
+{
+    std::string data(size, 0);
+    for(size_t i = 0;i < size;i ++)
+    {
+        data[i] = static_cast<char>('a' + i % 26);
+    }
+    return data;
+}
+
+inline bool WaitUntil(const std::function<bool()> &condition, int timeout)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    while(condition() == false)
+    {
+        if(std::chrono::steady_clock::now() >= deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+// the routes the tests share: a short answer, a large generated body,
+// a slow handler and a post that answers with the body size
+inline void AddTestRoutes(WebCpp::HttpServer &server)
+{
+    server.OnGet("/", [](const WebCpp::Request &, WebCpp::Response &response) -> bool
+    {
+        response.Write("hello");
+        return true;
+    });
+    server.OnGet("/big/{size:numeric}", [](const WebCpp::Request &request, WebCpp::Response &response) -> bool
+    {
+        std::string data = Pattern(static_cast<size_t>(atol(request.GetArg("size").c_str())));
+        ByteArray body(data.begin(), data.end());
+        response.Write(body);
+        return true;
+    });
+    server.OnGet("/sleep/{ms:numeric}", [](const WebCpp::Request &request, WebCpp::Response &response) -> bool
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(atoi(request.GetArg("ms").c_str())));
+        response.Write("slept");
+        return true;
+    });
+    server.OnPost("/size", [](const WebCpp::Request &request, WebCpp::Response &response) -> bool
+    {
+        response.Write(request.GetHeader().GetHeader("Content-Length"));
+        return true;
+    });
+}
+
+#endif // TEST_COMMON_H